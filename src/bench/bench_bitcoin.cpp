@@ -6,6 +6,7 @@
 
 #include "crypto/sha256.h"
 #include "key.h"
+#include "script/sigcache.h"
 #include "validation.h"
 #include "util.h"
 #include "random.h"
@@ -17,6 +18,7 @@ main(int argc, char** argv)
     RandomInit();
     ECC_Start();
     SetupEnvironment();
+    InitSignatureCache();
     fPrintToDebugLog = false; // don't want to write to debug.log file
 
     benchmark::BenchRunner::RunAll();
@@ -5,6 +5,7 @@
 #include "bench.h"
 #include "coins.h"
 #include "policy/policy.h"
+#include "random.h"
 #include "wallet/crypter.h"
 
 #include <vector>
@@ -85,3 +86,55 @@ static void CCoinsCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCoinsCaching);
+
+// Microbenchmark for adding coins to a cache and spending them again, the way
+// blocks do during initial block download. Every entry that is added and
+// erased is a separate allocation of a small map node.
+static void CCoinsCacheChurn(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 2000; i++) {
+        outpoints.emplace_back(rng.rand256(), 0);
+    }
+    CTxOut txout(50 * CENT, CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0) << OP_EQUALVERIFY << OP_CHECKSIG);
+
+    CCoinsView coinsDummy;
+    CCoinsViewCache coins(&coinsDummy);
+    while (state.KeepRunning()) {
+        for (const COutPoint& outpoint : outpoints) {
+            coins.AddCoin(outpoint, Coin(txout, 1, false), false);
+        }
+        for (const COutPoint& outpoint : outpoints) {
+            coins.SpendCoin(outpoint);
+        }
+    }
+}
+
+BENCHMARK(CCoinsCacheChurn);
+
+// Microbenchmark for looking up coins in a large cache, in random order like
+// the inputs of a block, so most lookups miss the CPU caches.
+static void CCoinsCacheLookup(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    std::vector<COutPoint> outpoints;
+    CTxOut txout(50 * CENT, CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0) << OP_EQUALVERIFY << OP_CHECKSIG);
+
+    CCoinsView coinsDummy;
+    CCoinsViewCache coins(&coinsDummy);
+    for (int i = 0; i < 200000; i++) {
+        outpoints.emplace_back(rng.rand256(), 0);
+        coins.AddCoin(outpoints.back(), Coin(txout, 1, false), false);
+    }
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        for (int j = 0; j < 1000; j++) {
+            const Coin& coin = coins.AccessCoin(outpoints[rng.randrange(outpoints.size())]);
+            i += coin.nHeight;
+        }
+    }
+    assert(i > 0);
+}
+
+BENCHMARK(CCoinsCacheLookup);
@@ -5,6 +5,7 @@
 #include "bench.h"
 
 #include "chainparams.h"
+#include "lzcompress.h"
 #include "validation.h"
 #include "streams.h"
 #include "consensus/validation.h"
@@ -52,5 +53,35 @@ static void DeserializeAndCheckBlockTest(benchmark::State& state)
     }
 }
 
+// Storing blocks compressed (-blockcompression) costs a compression when the
+// block is written, and a decompression before every deserialization when it
+// is read back, to be weighed against the bytes saved on disk.
+
+static void CompressBlockTest(benchmark::State& state)
+{
+    std::vector<unsigned char> compressed;
+    while (state.KeepRunning()) {
+        compressed.clear();
+        LZCompress(block_bench::block413567, sizeof(block_bench::block413567), compressed);
+    }
+}
+
+static void DecompressAndDeserializeBlockTest(benchmark::State& state)
+{
+    std::vector<unsigned char> compressed;
+    LZCompress(block_bench::block413567, sizeof(block_bench::block413567), compressed);
+    assert(compressed.size() < sizeof(block_bench::block413567));
+
+    while (state.KeepRunning()) {
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream.resize(sizeof(block_bench::block413567));
+        assert(LZDecompress(compressed.data(), compressed.size(), (unsigned char*)stream.data(), stream.size()));
+        CBlock block;
+        stream >> block;
+    }
+}
+
 BENCHMARK(DeserializeBlockTest);
 BENCHMARK(DeserializeAndCheckBlockTest);
+BENCHMARK(CompressBlockTest);
+BENCHMARK(DecompressAndDeserializeBlockTest);
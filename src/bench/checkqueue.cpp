@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "bench.h"
+#include "hash.h"
 #include "util.h"
 #include "validation.h"
 #include "checkqueue.h"
@@ -99,5 +100,46 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.interrupt_all();
     tg.join_all();
 }
+
+// This Benchmark tests the CheckQueue with checks of very different cost, like
+// the scripts of a block, where one in ten checks does most of the work. The
+// expensive checks are added together, so the workers that get them have to
+// be relieved by the others.
+static void CCheckQueueSpeedUnevenJob(benchmark::State& state)
+{
+    struct UnevenJob {
+        unsigned int nRounds;
+        UnevenJob() : nRounds(0) {}
+        explicit UnevenJob(unsigned int nRoundsIn) : nRounds(nRoundsIn) {}
+        bool operator()()
+        {
+            uint256 hash;
+            for (unsigned int i = 0; i < nRounds; i++) {
+                hash = Hash(hash.begin(), hash.end());
+            }
+            return true;
+        }
+        void swap(UnevenJob& x){std::swap(nRounds, x.nRounds);};
+    };
+    CCheckQueue<UnevenJob> queue {QUEUE_BATCH_SIZE};
+    boost::thread_group tg;
+    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
+       tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        CCheckQueueControl<UnevenJob> control(&queue);
+        std::vector<std::vector<UnevenJob>> vBatches(BATCHES);
+        for (size_t i = 0; i < BATCHES; ++i) {
+            vBatches[i].reserve(BATCH_SIZE);
+            for (size_t x = 0; x < BATCH_SIZE; ++x)
+                vBatches[i].emplace_back(i % 10 == 0 ? 100 : 1);
+            control.Add(vBatches[i]);
+        }
+        control.Wait();
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
 BENCHMARK(CCheckQueueSpeed);
 BENCHMARK(CCheckQueueSpeedPrevectorJob);
+BENCHMARK(CCheckQueueSpeedUnevenJob);
@@ -14,6 +14,7 @@
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
 #include "crypto/sha512.h"
+#include "crypto/muhash.h"
 
 /* Number of bytes to hash per iteration */
 static const uint64_t BUFFER_SIZE = 1000*1000;
@@ -26,6 +27,44 @@ static void RIPEMD160(benchmark::State& state)
         CRIPEMD160().Write(in.data(), in.size()).Finalize(hash);
 }
 
+static void RIPEMD160_32b(benchmark::State& state)
+{
+    std::vector<uint8_t> in(32 * 64, 0);
+    std::vector<uint8_t> out(CRIPEMD160::OUTPUT_SIZE * 64);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 64; i++) {
+            CRIPEMD160().Write(&in[32 * i], 32).Finalize(&out[CRIPEMD160::OUTPUT_SIZE * i]);
+        }
+    }
+}
+
+static void RIPEMD160_32b_multilane(benchmark::State& state)
+{
+    std::vector<uint8_t> in(32 * 64, 0);
+    std::vector<uint8_t> out(CRIPEMD160::OUTPUT_SIZE * 64);
+    while (state.KeepRunning()) {
+        RIPEMD160_32(out.data(), in.data(), 64);
+    }
+}
+
+static void HASH160_33b(benchmark::State& state)
+{
+    std::vector<std::vector<uint8_t>> in(64, std::vector<uint8_t>(33, 0));
+    while (state.KeepRunning()) {
+        for (const auto& obj : in) {
+            Hash160(obj);
+        }
+    }
+}
+
+static void HASH160_33b_batch(benchmark::State& state)
+{
+    std::vector<std::vector<uint8_t>> in(64, std::vector<uint8_t>(33, 0));
+    while (state.KeepRunning()) {
+        Hash160Batch(in);
+    }
+}
+
 static void SHA1(benchmark::State& state)
 {
     uint8_t hash[CSHA1::OUTPUT_SIZE];
@@ -70,6 +109,31 @@ static void SipHash_32b(benchmark::State& state)
     }
 }
 
+static void MuHash(benchmark::State& state)
+{
+    // About the size of a serialized coin with its outpoint.
+    std::vector<uint8_t> in(80, 0);
+    MuHash3072 acc;
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) {
+            in[0] = i;
+            acc.Insert(in.data(), in.size());
+        }
+    }
+}
+
+static void MuHashFinalize(benchmark::State& state)
+{
+    std::vector<uint8_t> in(80, 0);
+    MuHash3072 acc;
+    acc.Insert(in.data(), in.size());
+    acc.Remove(in.data(), 32);
+    uint8_t hash[32];
+    while (state.KeepRunning()) {
+        acc.Finalize(hash);
+    }
+}
+
 static void FastRandom_32bit(benchmark::State& state)
 {
     FastRandomContext rng(true);
@@ -98,6 +162,12 @@ BENCHMARK(SHA256);
 BENCHMARK(SHA512);
 
 BENCHMARK(SHA256_32b);
+BENCHMARK(RIPEMD160_32b);
+BENCHMARK(RIPEMD160_32b_multilane);
+BENCHMARK(HASH160_33b);
+BENCHMARK(HASH160_33b_batch);
 BENCHMARK(SipHash_32b);
+BENCHMARK(MuHash);
+BENCHMARK(MuHashFinalize);
 BENCHMARK(FastRandom_32bit);
 BENCHMARK(FastRandom_1bit);
@@ -0,0 +1,147 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "dbwrapper.h"
+#include "fs.h"
+#include "random.h"
+#include "streams.h"
+#include "uint256.h"
+
+#include <string>
+#include <vector>
+
+static const std::vector<unsigned char> obfuscateKey = {0x1f, 0x2e, 0x3d, 0x4c, 0x5b, 0x6a, 0x79, 0x88};
+
+// A typical chainstate value: a coin is a few dozen bytes.
+static void DBWrapperXorCoin(benchmark::State& state)
+{
+    CDataStream ss(std::vector<unsigned char>(45, 0xa5), SER_DISK, 0);
+    while (state.KeepRunning()) {
+        ss.Xor(obfuscateKey);
+    }
+}
+
+static void DBWrapperXorLarge(benchmark::State& state)
+{
+    CDataStream ss(std::vector<unsigned char>(1 << 20, 0xa5), SER_DISK, 0);
+    while (state.KeepRunning()) {
+        ss.Xor(obfuscateKey);
+    }
+}
+
+// Write and read back a batch of coin sized values in an obfuscated
+// in-memory database, as the coins view does.
+static void DBWrapperObfuscatedWriteRead(benchmark::State& state)
+{
+    CDBWrapper dbw(fs::temp_directory_path() / fs::unique_path(), 8 << 20, true, false, true);
+    const std::vector<unsigned char> value(45, 0xa5);
+    std::vector<unsigned char> read;
+    while (state.KeepRunning()) {
+        CDBBatch batch(dbw);
+        for (uint32_t i = 0; i < 1000; i++)
+            batch.Write(i, value);
+        dbw.WriteBatch(batch);
+        for (uint32_t i = 0; i < 1000; i++) {
+            bool fRead = dbw.Read(i, read);
+            assert(fRead && read == value);
+        }
+    }
+}
+
+// Look up coin sized values by random keys.
+static void DBWrapperRead(benchmark::State& state)
+{
+    CDBWrapper dbw(fs::temp_directory_path() / fs::unique_path(), 8 << 20, true, false, true);
+    FastRandomContext rng(true);
+    std::vector<uint256> keys;
+    CDBBatch batch(dbw);
+    for (int i = 0; i < 100000; i++) {
+        keys.push_back(rng.rand256());
+        batch.Write(keys.back(), std::vector<unsigned char>(45, i & 0xff));
+    }
+    dbw.WriteBatch(batch);
+    std::vector<uint256> lookups;
+    for (int i = 0; i < 1000; i++)
+        lookups.push_back(keys[rng.randrange(keys.size())]);
+    std::vector<unsigned char> value;
+    while (state.KeepRunning()) {
+        for (const uint256& key : lookups) {
+            bool fRead = dbw.Read(key, value);
+            assert(fRead);
+        }
+    }
+}
+
+// Replay the same UTXO-like workload against an on-disk database with a
+// given profile, one block per iteration: look up and spend existing coins,
+// half of them among the most recent tenth, and create new ones, written
+// in one batch as the coins view flushes them.
+static void DBWrapperReplay(benchmark::State& state, const std::string& strProfile)
+{
+    CDBOptions dbOptions;
+    std::string strError;
+    bool fParsed = ParseDBOptions(strProfile, dbOptions, strError);
+    assert(fParsed);
+    const fs::path path = fs::temp_directory_path() / fs::unique_path();
+    {
+        CDBWrapper dbw(path, 4 << 20, false, true, true, dbOptions);
+        FastRandomContext rng(true);
+        std::vector<uint256> vCoins;
+        std::vector<bool> vSpent;
+        const std::vector<unsigned char> value(45, 0xa5);
+        auto AddCoin = [&](CDBBatch& batch) {
+            vCoins.push_back(rng.rand256());
+            vSpent.push_back(false);
+            batch.Write(std::make_pair('C', vCoins.back()), value);
+        };
+
+        CDBBatch batch(dbw);
+        for (int i = 0; i < 200000; i++) {
+            AddCoin(batch);
+            if (batch.SizeEstimate() > (1 << 20)) {
+                dbw.WriteBatch(batch);
+                batch.Clear();
+            }
+        }
+        dbw.WriteBatch(batch);
+
+        std::vector<unsigned char> read;
+        while (state.KeepRunning()) {
+            CDBBatch block(dbw);
+            for (int i = 0; i < 1000; i++) {
+                size_t nIndex;
+                do {
+                    const size_t nRange = rng.randbool() ? vCoins.size() / 10 : vCoins.size();
+                    nIndex = vCoins.size() - 1 - rng.randrange(nRange);
+                } while (vSpent[nIndex]);
+                bool fRead = dbw.Read(std::make_pair('C', vCoins[nIndex]), read);
+                assert(fRead);
+                block.Erase(std::make_pair('C', vCoins[nIndex]));
+                vSpent[nIndex] = true;
+            }
+            for (int i = 0; i < 1200; i++)
+                AddCoin(block);
+            dbw.WriteBatch(block);
+        }
+    }
+    fs::remove_all(path);
+}
+
+static void DBWrapperReplayDefault(benchmark::State& state)
+{
+    DBWrapperReplay(state, "default");
+}
+
+static void DBWrapperReplayLowMem(benchmark::State& state)
+{
+    DBWrapperReplay(state, "lowmem");
+}
+
+BENCHMARK(DBWrapperXorCoin);
+BENCHMARK(DBWrapperXorLarge);
+BENCHMARK(DBWrapperObfuscatedWriteRead);
+BENCHMARK(DBWrapperRead);
+BENCHMARK(DBWrapperReplayDefault);
+BENCHMARK(DBWrapperReplayLowMem);
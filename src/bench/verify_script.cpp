@@ -10,6 +10,7 @@
 #include "script/script.h"
 #include "script/sign.h"
 #include "streams.h"
+#include "validation.h"
 
 #include <array>
 
@@ -105,4 +106,43 @@ static void VerifyScriptBench(benchmark::State& state)
     }
 }
 
+// Same P2WPKH spend, verified through CScriptCheck as during block
+// connection, so signatures go through the signature cache.
+static void VerifyScriptCheckBench(benchmark::State& state)
+{
+    const int flags = SCRIPT_VERIFY_WITNESS | SCRIPT_VERIFY_P2SH;
+    const int witnessversion = 0;
+
+    CKey key;
+    static const std::array<unsigned char, 32> vchKey = {
+        {
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1
+        }
+    };
+    key.Set(vchKey.begin(), vchKey.end(), false);
+    CPubKey pubkey = key.GetPubKey();
+    uint160 pubkeyHash;
+    CHash160().Write(pubkey.begin(), pubkey.size()).Finalize(pubkeyHash.begin());
+
+    CScript scriptPubKey = CScript() << witnessversion << ToByteVector(pubkeyHash);
+    CScript witScriptPubkey = CScript() << OP_DUP << OP_HASH160 << ToByteVector(pubkeyHash) << OP_EQUALVERIFY << OP_CHECKSIG;
+    CTransaction txCredit = BuildCreditingTransaction(scriptPubKey);
+    CMutableTransaction txSpend = BuildSpendingTransaction(CScript(), txCredit);
+    CScriptWitness& witness = txSpend.vin[0].scriptWitness;
+    witness.stack.emplace_back();
+    key.Sign(SignatureHash(witScriptPubkey, txSpend, 0, SIGHASH_ALL, txCredit.vout[0].nValue, SIGVERSION_WITNESS_V0), witness.stack.back(), 0);
+    witness.stack.back().push_back(static_cast<unsigned char>(SIGHASH_ALL));
+    witness.stack.push_back(ToByteVector(pubkey));
+    const CTransaction tx(txSpend);
+    PrecomputedTransactionData txdata(tx);
+
+    while (state.KeepRunning()) {
+        CScriptCheck check(txCredit.vout[0].scriptPubKey, txCredit.vout[0].nValue, tx, 0, flags, false, &txdata);
+        bool success = check();
+        assert(check.GetScriptError() == SCRIPT_ERR_OK);
+        assert(success);
+    }
+}
+
 BENCHMARK(VerifyScriptBench);
+BENCHMARK(VerifyScriptCheckBench);
@@ -0,0 +1,86 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+
+#include "util.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CBlockFileMap::Mapping::~Mapping()
+{
+#ifndef WIN32
+    munmap(const_cast<unsigned char*>(pdata), nSize);
+#endif
+}
+
+CBlockFileMap::CBlockFileMap(PathFunction pathFunctionIn, size_t nMaxFilesIn) : pathFunction(pathFunctionIn), nMaxFiles(nMaxFilesIn)
+{
+}
+
+#ifndef WIN32
+static std::shared_ptr<const CBlockFileMap::Mapping> MapFile(const fs::path& path, size_t nMinSize)
+{
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (size_t)st.st_size < nMinSize) {
+        close(fd);
+        return nullptr;
+    }
+    size_t nSize = st.st_size;
+    void* map = mmap(nullptr, nSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        LogPrintf("%s: mmap of %s failed: %s\n", __func__, path.string(), strerror(errno));
+        return nullptr;
+    }
+    return std::make_shared<const CBlockFileMap::Mapping>((const unsigned char*)map, nSize);
+}
+#endif
+
+std::shared_ptr<const CBlockFileMap::Mapping> CBlockFileMap::Get(int nFile, size_t nMinSize)
+{
+#ifdef WIN32
+    return nullptr;
+#else
+    LOCK(cs);
+    for (auto it = lruMappings.begin(); it != lruMappings.end(); ++it) {
+        if (it->first != nFile)
+            continue;
+        if (it->second->size() >= nMinSize) {
+            lruMappings.splice(lruMappings.begin(), lruMappings, it);
+            return it->second;
+        }
+        // The file has grown since it was mapped.
+        lruMappings.erase(it);
+        break;
+    }
+    std::shared_ptr<const Mapping> mapping = MapFile(pathFunction(nFile), nMinSize);
+    if (!mapping)
+        return nullptr;
+    lruMappings.emplace_front(nFile, mapping);
+    if (lruMappings.size() > nMaxFiles)
+        lruMappings.pop_back();
+    return mapping;
+#endif
+}
+
+void CBlockFileMap::Unmap(int nFile)
+{
+    LOCK(cs);
+    lruMappings.remove_if([nFile](const std::pair<int, std::shared_ptr<const Mapping>>& entry) { return entry.first == nFile; });
+}
+
+void CBlockFileMap::Clear()
+{
+    LOCK(cs);
+    lruMappings.clear();
+}
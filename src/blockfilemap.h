@@ -0,0 +1,72 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILEMAP_H
+#define BITCOIN_BLOCKFILEMAP_H
+
+#include "fs.h"
+#include "sync.h"
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <stddef.h>
+
+/** Maximum number of block files kept mapped at once */
+static const size_t MAX_MAPPED_BLOCK_FILES = sizeof(void*) >= 8 ? 8 : 2;
+
+/**
+ * Read-only memory maps of block files, so stored blocks can be served as
+ * the bytes on disk, without reading them through a FILE or deserializing
+ * them. The most recently used files stay mapped. Files only ever grow while
+ * they are mapped, except when they are deleted by pruning, which must call
+ * Unmap. Mapping is not available on Windows; Get then returns nullptr.
+ */
+class CBlockFileMap
+{
+public:
+    //! A mapping of the start of a file. Stays valid while it is referenced,
+    //! even after the map has let go of it.
+    class Mapping
+    {
+    private:
+        const unsigned char* pdata;
+        size_t nSize;
+
+    public:
+        Mapping(const unsigned char* pdataIn, size_t nSizeIn) : pdata(pdataIn), nSize(nSizeIn) {}
+        ~Mapping();
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+
+        const unsigned char* data() const { return pdata; }
+        size_t size() const { return nSize; }
+    };
+
+    typedef std::function<fs::path(int)> PathFunction;
+
+    CBlockFileMap(PathFunction pathFunctionIn, size_t nMaxFilesIn = MAX_MAPPED_BLOCK_FILES);
+
+    /**
+     * Return a mapping of file nFile of at least nMinSize bytes. A cached
+     * mapping is reused if it is large enough, otherwise the whole file is
+     * mapped again. Returns nullptr if the file is shorter or can't be mapped.
+     */
+    std::shared_ptr<const Mapping> Get(int nFile, size_t nMinSize);
+
+    //! Forget the mapping of nFile, for instance before deleting it.
+    void Unmap(int nFile);
+
+    //! Forget all mappings.
+    void Clear();
+
+private:
+    CCriticalSection cs;
+    const PathFunction pathFunction;
+    const size_t nMaxFiles;
+    //! Mapped files, most recently used first.
+    std::list<std::pair<int, std::shared_ptr<const Mapping>>> lruMappings;
+};
+
+#endif // BITCOIN_BLOCKFILEMAP_H
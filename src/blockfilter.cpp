@@ -0,0 +1,268 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "coins.h"
+#include "crypto/common.h"
+#include "hash.h"
+#include "random.h"
+#include "script/script.h"
+#include "streams.h"
+#include "undo.h"
+#include "version.h"
+
+#include <algorithm>
+#include <limits>
+
+/** Serialization type and version of the filter encoding, which uses neither */
+static const int GCS_SER_TYPE = SER_NETWORK;
+static const int GCS_SER_VERSION = 0;
+
+ByteVectorHash::ByteVectorHash() :
+    k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max()))
+{
+}
+
+size_t ByteVectorHash::operator()(const std::vector<unsigned char>& input) const
+{
+    return CSipHasher(k0, k1).Write(input.data(), input.size()).Finalize();
+}
+
+/** Map x uniformly to [0, n), the high 64 bits of x * n. */
+static inline uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return (static_cast<unsigned __int128>(x) * static_cast<unsigned __int128>(n)) >> 64;
+#else
+    // The same product from 32-bit halves.
+    const uint64_t xHi = x >> 32, xLo = x & 0xffffffff;
+    const uint64_t nHi = n >> 32, nLo = n & 0xffffffff;
+    const uint64_t hiHi = xHi * nHi;
+    const uint64_t hiLo = xHi * nLo;
+    const uint64_t loHi = xLo * nHi;
+    const uint64_t loLo = xLo * nLo;
+    const uint64_t mid = (loLo >> 32) + (hiLo & 0xffffffff) + (loHi & 0xffffffff);
+    return hiHi + (hiLo >> 32) + (loHi >> 32) + (mid >> 32);
+#endif
+}
+
+template <typename OStream>
+static void GolombRiceEncode(BitStreamWriter<OStream>& bitwriter, uint8_t nP, uint64_t x)
+{
+    // The quotient in unary, as that many 1 bits and a 0.
+    uint64_t q = x >> nP;
+    while (q > 0) {
+        const int nBits = q <= 64 ? static_cast<int>(q) : 64;
+        bitwriter.Write(~0ULL, nBits);
+        q -= nBits;
+    }
+    bitwriter.Write(0, 1);
+
+    // The remainder in binary, in nP bits.
+    bitwriter.Write(x, nP);
+}
+
+template <typename IStream>
+static uint64_t GolombRiceDecode(BitStreamReader<IStream>& bitreader, uint8_t nP)
+{
+    uint64_t q = 0;
+    while (bitreader.Read(1) == 1)
+        ++q;
+    const uint64_t r = bitreader.Read(nP);
+    return (q << nP) + r;
+}
+
+uint64_t GCSFilter::HashToRange(const Element& element) const
+{
+    const uint64_t hash = CSipHasher(params.nSipHashK0, params.nSipHashK1)
+        .Write(element.data(), element.size())
+        .Finalize();
+    return MapIntoRange(hash, nF);
+}
+
+std::vector<uint64_t> GCSFilter::BuildHashedSet(const ElementSet& elements) const
+{
+    std::vector<uint64_t> vHashes;
+    vHashes.reserve(elements.size());
+    for (const Element& element : elements)
+        vHashes.push_back(HashToRange(element));
+    std::sort(vHashes.begin(), vHashes.end());
+    return vHashes;
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn) :
+    params(paramsIn), nN(0), nF(0), vchEncoded(1, 0)
+{
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn, std::vector<unsigned char> vchEncodedIn) :
+    params(paramsIn), vchEncoded(std::move(vchEncodedIn))
+{
+    CBufferReader stream(GCS_SER_TYPE, GCS_SER_VERSION, (const char*)vchEncoded.data(), (const char*)vchEncoded.data() + vchEncoded.size());
+    const uint64_t nElements = ReadCompactSize(stream);
+    nN = static_cast<uint32_t>(nElements);
+    if (nN != nElements)
+        throw std::ios_base::failure("N must be below 2^32");
+    nF = static_cast<uint64_t>(nN) * static_cast<uint64_t>(params.nM);
+
+    // Decode all elements, so that a filter that does not hold exactly N of
+    // them is rejected here rather than giving wrong matches.
+    BitStreamReader<CBufferReader> bitreader(stream);
+    for (uint64_t i = 0; i < nN; ++i)
+        GolombRiceDecode(bitreader, params.nP);
+    if (!stream.empty())
+        throw std::ios_base::failure("encoded filter contains excess data");
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn, const ElementSet& elements) :
+    params(paramsIn)
+{
+    const size_t nElements = elements.size();
+    nN = static_cast<uint32_t>(nElements);
+    if (nN != nElements)
+        throw std::invalid_argument("N must be below 2^32");
+    nF = static_cast<uint64_t>(nN) * static_cast<uint64_t>(params.nM);
+
+    CVectorWriter stream(GCS_SER_TYPE, GCS_SER_VERSION, vchEncoded, 0);
+    WriteCompactSize(stream, nN);
+    if (elements.empty())
+        return;
+
+    BitStreamWriter<CVectorWriter> bitwriter(stream);
+    uint64_t nLast = 0;
+    for (uint64_t nValue : BuildHashedSet(elements)) {
+        GolombRiceEncode(bitwriter, params.nP, nValue - nLast);
+        nLast = nValue;
+    }
+    bitwriter.Flush();
+}
+
+bool GCSFilter::MatchInternal(const uint64_t* pElementHashes, size_t nSize) const
+{
+    CBufferReader stream(GCS_SER_TYPE, GCS_SER_VERSION, (const char*)vchEncoded.data(), (const char*)vchEncoded.data() + vchEncoded.size());
+    ReadCompactSize(stream);
+    BitStreamReader<CBufferReader> bitreader(stream);
+
+    // Walk the sorted filter values and the sorted element hashes together.
+    uint64_t nValue = 0;
+    size_t nIndex = 0;
+    for (uint32_t i = 0; i < nN; ++i) {
+        nValue += GolombRiceDecode(bitreader, params.nP);
+        while (true) {
+            if (nIndex == nSize)
+                return false;
+            if (pElementHashes[nIndex] == nValue)
+                return true;
+            if (pElementHashes[nIndex] > nValue)
+                break;
+            nIndex++;
+        }
+    }
+    return false;
+}
+
+bool GCSFilter::Match(const Element& element) const
+{
+    const uint64_t nQuery = HashToRange(element);
+    return MatchInternal(&nQuery, 1);
+}
+
+bool GCSFilter::MatchAny(const ElementSet& elements) const
+{
+    const std::vector<uint64_t> vQueries = BuildHashedSet(elements);
+    return MatchInternal(vQueries.data(), vQueries.size());
+}
+
+static const std::string strBasicFilterName = "basic";
+static const std::string strUnknownFilterName = "";
+
+const std::string& BlockFilterTypeName(BlockFilterType filterType)
+{
+    switch (filterType) {
+    case BlockFilterType::BASIC: return strBasicFilterName;
+    case BlockFilterType::INVALID: return strUnknownFilterName;
+    }
+    return strUnknownFilterName;
+}
+
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filterType)
+{
+    if (name == strBasicFilterName) {
+        filterType = BlockFilterType::BASIC;
+        return true;
+    }
+    return false;
+}
+
+static GCSFilter::ElementSet BasicFilterElements(const CBlock& block, const CBlockUndo& blockUndo)
+{
+    GCSFilter::ElementSet elements;
+
+    for (const CTransactionRef& tx : block.vtx) {
+        for (const CTxOut& txout : tx->vout) {
+            const CScript& script = txout.scriptPubKey;
+            if (script.empty() || script[0] == OP_RETURN)
+                continue;
+            elements.emplace(script.begin(), script.end());
+        }
+    }
+
+    for (const CTxUndo& txUndo : blockUndo.vtxundo) {
+        for (const Coin& prevout : txUndo.vprevout) {
+            const CScript& script = prevout.out.scriptPubKey;
+            if (script.empty())
+                continue;
+            elements.emplace(script.begin(), script.end());
+        }
+    }
+
+    return elements;
+}
+
+BlockFilter::BlockFilter(BlockFilterType filterTypeIn, const uint256& hashBlockIn, std::vector<unsigned char> vchFilter) :
+    filterType(filterTypeIn), hashBlock(hashBlockIn)
+{
+    GCSFilter::Params params;
+    if (!BuildParams(params))
+        throw std::invalid_argument("unknown filter type");
+    filter = GCSFilter(params, std::move(vchFilter));
+}
+
+BlockFilter::BlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockUndo) :
+    filterType(filterTypeIn), hashBlock(block.GetHash())
+{
+    GCSFilter::Params params;
+    if (!BuildParams(params))
+        throw std::invalid_argument("unknown filter type");
+    filter = GCSFilter(params, BasicFilterElements(block, blockUndo));
+}
+
+bool BlockFilter::BuildParams(GCSFilter::Params& params) const
+{
+    switch (filterType) {
+    case BlockFilterType::BASIC:
+        // The SipHash key is the first 16 bytes of the block hash.
+        params.nSipHashK0 = ReadLE64(hashBlock.begin());
+        params.nSipHashK1 = ReadLE64(hashBlock.begin() + 8);
+        params.nP = BASIC_FILTER_P;
+        params.nM = BASIC_FILTER_M;
+        return true;
+    case BlockFilterType::INVALID:
+        return false;
+    }
+    return false;
+}
+
+uint256 BlockFilter::GetHash() const
+{
+    const std::vector<unsigned char>& vchData = GetEncodedFilter();
+    return Hash(vchData.begin(), vchData.end());
+}
+
+uint256 BlockFilter::ComputeHeader(const uint256& prevHeader) const
+{
+    const uint256 hashFilter = GetHash();
+    return Hash(hashFilter.begin(), hashFilter.end(), prevHeader.begin(), prevHeader.end());
+}
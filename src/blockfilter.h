@@ -0,0 +1,150 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include "primitives/block.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+class CBlockUndo;
+
+/** Hashes a byte vector with a key that is random per process */
+class ByteVectorHash
+{
+private:
+    uint64_t k0, k1;
+
+public:
+    ByteVectorHash();
+    size_t operator()(const std::vector<unsigned char>& input) const;
+};
+
+/**
+ * Golomb-coded set: a compact probabilistic filter of a set of byte
+ * strings, as defined in BIP 158. Each element is hashed to a number below
+ * N * M, and the sorted numbers are stored as Golomb-Rice coded differences
+ * with P bits for the remainder. A false positive occurs at a rate of about
+ * 1 / M.
+ */
+class GCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::unordered_set<Element, ByteVectorHash> ElementSet;
+
+    struct Params
+    {
+        uint64_t nSipHashK0;
+        uint64_t nSipHashK1;
+        uint8_t nP; //!< Golomb-Rice coding parameter
+        uint32_t nM; //!< Inverse false positive rate
+
+        Params(uint64_t nSipHashK0In = 0, uint64_t nSipHashK1In = 0, uint8_t nPIn = 0, uint32_t nMIn = 1)
+            : nSipHashK0(nSipHashK0In), nSipHashK1(nSipHashK1In), nP(nPIn), nM(nMIn) {}
+    };
+
+private:
+    Params params;
+    uint32_t nN; //!< Number of elements in the filter
+    uint64_t nF; //!< Range of element hashes, F = N * M
+    std::vector<unsigned char> vchEncoded;
+
+    uint64_t HashToRange(const Element& element) const;
+    std::vector<uint64_t> BuildHashedSet(const ElementSet& elements) const;
+    //! Whether any of the sorted element hashes is in the filter
+    bool MatchInternal(const uint64_t* pElementHashes, size_t nSize) const;
+
+public:
+    //! Construct an empty filter.
+    explicit GCSFilter(const Params& paramsIn = Params());
+    //! Reconstruct a filter from its encoding. Throws if it is not valid.
+    GCSFilter(const Params& paramsIn, std::vector<unsigned char> vchEncodedIn);
+    //! Build a filter of a set of elements.
+    GCSFilter(const Params& paramsIn, const ElementSet& elements);
+
+    uint32_t GetN() const { return nN; }
+    const Params& GetParams() const { return params; }
+    const std::vector<unsigned char>& GetEncoded() const { return vchEncoded; }
+
+    //! Whether the element may be in the set, a false positive occurs with probability 1/M.
+    bool Match(const Element& element) const;
+    //! Whether any of the elements may be in the set. Faster than calling Match on each of them.
+    bool MatchAny(const ElementSet& elements) const;
+};
+
+static const uint8_t BASIC_FILTER_P = 19;
+static const uint32_t BASIC_FILTER_M = 784931;
+
+enum class BlockFilterType : uint8_t
+{
+    BASIC = 0,
+    INVALID = 255,
+};
+
+//! Name of a filter type, as in RPCs, or an empty string for an unknown one.
+const std::string& BlockFilterTypeName(BlockFilterType filterType);
+//! Look up a filter type by name. Returns false if there is none of that name.
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filterType);
+
+/**
+ * A compact filter of the scripts a block involves, as defined in BIP 158.
+ * The basic filter holds the output scripts of the block, except OP_RETURN
+ * ones, and the scripts of the outputs it spends.
+ */
+class BlockFilter
+{
+private:
+    BlockFilterType filterType;
+    uint256 hashBlock;
+    GCSFilter filter;
+
+    bool BuildParams(GCSFilter::Params& params) const;
+
+public:
+    BlockFilter() : filterType(BlockFilterType::INVALID) {}
+
+    //! Reconstruct a filter from its encoding. Throws if it is not valid.
+    BlockFilter(BlockFilterType filterTypeIn, const uint256& hashBlockIn, std::vector<unsigned char> vchFilter);
+    //! Build the filter of a block, with the undo data of the block for the outputs it spends.
+    BlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockUndo);
+
+    BlockFilterType GetFilterType() const { return filterType; }
+    const uint256& GetBlockHash() const { return hashBlock; }
+    const GCSFilter& GetFilter() const { return filter; }
+    const std::vector<unsigned char>& GetEncodedFilter() const { return filter.GetEncoded(); }
+
+    //! Hash of the encoded filter
+    uint256 GetHash() const;
+    //! Filter header of the block, which commits to the filters of the chain up to it
+    uint256 ComputeHeader(const uint256& prevHeader) const;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << static_cast<uint8_t>(filterType) << hashBlock << filter.GetEncoded();
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        std::vector<unsigned char> vchEncoded;
+        uint8_t nFilterType;
+        s >> nFilterType >> hashBlock >> vchEncoded;
+        filterType = static_cast<BlockFilterType>(nFilterType);
+
+        GCSFilter::Params params;
+        if (!BuildParams(params))
+            throw std::ios_base::failure("unknown filter type");
+        filter = GCSFilter(params, std::move(vchEncoded));
+    }
+};
+
+#endif // BITCOIN_BLOCKFILTER_H
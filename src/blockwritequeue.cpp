@@ -0,0 +1,136 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockwritequeue.h"
+
+#include "util.h"
+
+CBlockWriteQueue::CBlockWriteQueue(OpenFunction openFunctionIn, size_t nMaxPendingBytesIn) :
+    openFunction(openFunctionIn), nMaxPendingBytes(nMaxPendingBytesIn), fRunning(false), fStop(false), fFailed(false),
+    nPendingBytes(0), nQueued(0), nDone(0)
+{
+}
+
+CBlockWriteQueue::~CBlockWriteQueue()
+{
+    Stop();
+}
+
+void CBlockWriteQueue::Start()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (fRunning)
+        return;
+    fRunning = true;
+    thread = std::thread(&CBlockWriteQueue::Loop, this);
+}
+
+void CBlockWriteQueue::Stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!fRunning)
+            return;
+        fStop = true;
+    }
+    condWork.notify_all();
+    thread.join();
+    std::unique_lock<std::mutex> lock(mutex);
+    fRunning = false;
+    fStop = false;
+}
+
+bool CBlockWriteQueue::Run(const Job& job) const
+{
+    const char* strType = job.fUndo ? "undo" : "block";
+    FILE* file = openFunction(job.pos, job.fUndo);
+    if (!file)
+        return error("%s: failed to open %s file %d", __func__, strType, job.pos.nFile);
+    bool fOk = true;
+    if (job.fCommit) {
+        if (job.fTruncate)
+            TruncateFile(file, job.nTruncateSize);
+        FileCommit(file);
+    } else {
+        fOk = fwrite(job.data.data(), 1, job.data.size(), file) == job.data.size();
+    }
+    if (fclose(file) != 0)
+        fOk = false;
+    if (!fOk)
+        return error("%s: failed to write %s file %d at %u", __func__, strType, job.pos.nFile, job.pos.nPos);
+    return true;
+}
+
+void CBlockWriteQueue::Loop()
+{
+    RenameThread("bitcoin-blkwrite");
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        while (queue.empty() && !fStop)
+            condWork.wait(lock);
+        if (queue.empty())
+            return;
+        // Adding to the deque does not move the job being written.
+        const Job& job = queue.front();
+        lock.unlock();
+        const bool fOk = Run(job);
+        lock.lock();
+        if (!fOk)
+            fFailed = true;
+        nDone++;
+        auto it = mapLastJob.find(std::make_pair(job.pos.nFile, job.fUndo));
+        if (it != mapLastJob.end() && it->second == nDone)
+            mapLastJob.erase(it);
+        nPendingBytes -= job.data.size();
+        queue.pop_front();
+        condDone.notify_all();
+    }
+}
+
+bool CBlockWriteQueue::Add(Job&& job)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!fRunning) {
+        if (!Run(job))
+            fFailed = true;
+        return !fFailed;
+    }
+    while (nPendingBytes > nMaxPendingBytes && !queue.empty())
+        condDone.wait(lock);
+    nPendingBytes += job.data.size();
+    mapLastJob[std::make_pair(job.pos.nFile, job.fUndo)] = ++nQueued;
+    queue.push_back(std::move(job));
+    condWork.notify_one();
+    return !fFailed;
+}
+
+bool CBlockWriteQueue::Write(const CDiskBlockPos& pos, bool fUndo, std::vector<unsigned char>&& data)
+{
+    return Add(Job{pos, fUndo, std::move(data), false, false, 0});
+}
+
+bool CBlockWriteQueue::Commit(int nFile, bool fUndo, bool fTruncate, unsigned int nTruncateSize)
+{
+    return Add(Job{CDiskBlockPos(nFile, 0), fUndo, std::vector<unsigned char>(), true, fTruncate, nTruncateSize});
+}
+
+void CBlockWriteQueue::WaitForFile(int nFile, bool fUndo)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = mapLastJob.find(std::make_pair(nFile, fUndo));
+    if (it == mapLastJob.end())
+        return;
+    const uint64_t nJob = it->second;
+    while (nDone < nJob)
+        condDone.wait(lock);
+}
+
+bool CBlockWriteQueue::Wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    const uint64_t nJob = nQueued;
+    while (nDone < nJob)
+        condDone.wait(lock);
+    return !fFailed;
+}
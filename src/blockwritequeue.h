@@ -0,0 +1,106 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKWRITEQUEUE_H
+#define BITCOIN_BLOCKWRITEQUEUE_H
+
+#include "chain.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/** Maximum number of bytes of block and undo data waiting to be written */
+static const size_t MAX_PENDING_BLOCK_WRITE_BYTES = 32 << 20;
+
+/**
+ * Write-behind queue for block and undo files. Data is handed over already
+ * serialized, at the position FindBlockPos or FindUndoPos gave it, and a
+ * background thread writes it in the order it was queued, so validation does
+ * not wait for the disk. Flushing files to disk goes through the same queue.
+ *
+ * Reading a file requires WaitForFile first. Before a database may refer to
+ * queued data, Wait must return, which guarantees everything queued so far
+ * is written and flushed. Without a running thread, data is written right
+ * away, by the thread queueing it.
+ *
+ * This uses std threads rather than boost ones so that none of the waits are
+ * interruption points: the data must reach the disk even during shutdown.
+ */
+class CBlockWriteQueue
+{
+public:
+    //! Open block or undo file pos.nFile for writing, positioned at pos.nPos.
+    typedef std::function<FILE*(const CDiskBlockPos& pos, bool fUndo)> OpenFunction;
+
+    explicit CBlockWriteQueue(OpenFunction openFunctionIn, size_t nMaxPendingBytesIn = MAX_PENDING_BLOCK_WRITE_BYTES);
+    ~CBlockWriteQueue();
+
+    //! Start the writer thread.
+    void Start();
+    //! Write out everything queued, then stop the writer thread.
+    void Stop();
+
+    /**
+     * Queue data to be written at pos, taking it over. Blocks while too much
+     * data is pending. Returns false if an earlier write has failed.
+     */
+    bool Write(const CDiskBlockPos& pos, bool fUndo, std::vector<unsigned char>&& data);
+
+    /**
+     * Queue flushing file nFile to disk, after truncating it to nTruncateSize
+     * if fTruncate. Returns false if an earlier write has failed.
+     */
+    bool Commit(int nFile, bool fUndo, bool fTruncate = false, unsigned int nTruncateSize = 0);
+
+    //! Wait until all data queued for file nFile has been written.
+    void WaitForFile(int nFile, bool fUndo);
+
+    //! Wait until everything queued has been done. Returns false if anything failed.
+    bool Wait();
+
+private:
+    struct Job {
+        CDiskBlockPos pos;
+        bool fUndo;
+        std::vector<unsigned char> data;
+        bool fCommit;
+        bool fTruncate;
+        unsigned int nTruncateSize;
+    };
+
+    const OpenFunction openFunction;
+    const size_t nMaxPendingBytes;
+
+    std::mutex mutex;
+    std::condition_variable condWork;
+    std::condition_variable condDone;
+    std::thread thread;
+    bool fRunning;
+    bool fStop;
+    //! Whether any write or flush failed.
+    bool fFailed;
+    //! Jobs not done yet, oldest first. The writer keeps the oldest queued while running it.
+    std::deque<Job> queue;
+    size_t nPendingBytes;
+    //! Numbers of jobs ever queued and done.
+    uint64_t nQueued;
+    uint64_t nDone;
+    //! Number of the last job queued for each block (false) or undo (true) file not written yet.
+    std::map<std::pair<int, bool>, uint64_t> mapLastJob;
+
+    bool Add(Job&& job);
+    bool Run(const Job& job) const;
+    void Loop();
+};
+
+#endif // BITCOIN_BLOCKWRITEQUEUE_H
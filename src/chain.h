@@ -161,6 +161,8 @@ enum BlockStatus: uint32_t {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
+
+    BLOCK_ASSUMED_VALID     =   256, //!< below a loaded UTXO snapshot: valid without its data ever having been seen
 };
 
 /** The block chain is a tree shaped structure starting with the
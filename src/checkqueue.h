@@ -8,6 +8,11 @@
 #include "sync.h"
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -16,7 +21,7 @@
 template <typename T>
 class CCheckQueueControl;
 
-/** 
+/**
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
   * operator(), returning a bool.
@@ -25,104 +30,166 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every worker, and the master, has its own deque of checks with its own
+  * lock, so there is no lock shared by all of them. Added checks are spread
+  * over the deques of the workers. A worker takes checks from the back of
+  * its own deque, and when that is empty steals half of another deque from
+  * the front. Workers without work spin briefly before going to sleep.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
-    boost::mutex mutex;
+    //! A deque of checks and the lock protecting it.
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<T> checks;
+    };
 
-    //! Worker threads block on this when out of work
-    boost::condition_variable condWorker;
+    //! Number of deques. Deque 0 belongs to the master; if there are more
+    //! worker threads than deques, some share one.
+    static const int MAX_QUEUES = 17;
 
-    //! Master thread blocks on this when out of work
-    boost::condition_variable condMaster;
+    //! Times an idle worker looks for new work before going to sleep.
+    static const int SPIN_ROUNDS = 64;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    std::vector<std::unique_ptr<WorkerQueue>> vQueues;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
+    //! The number of worker threads that have started, excluding the master.
+    std::atomic<int> nWorkers;
 
-    //! The total number of workers (including the master).
-    int nTotal;
-
-    //! The temporary evaluation result.
-    bool fAllOk;
+    //! The number of checks in the deques.
+    std::atomic<unsigned int> nQueued;
 
     /**
      * Number of verifications that haven't completed yet.
-     * This includes elements that are no longer queued, but still in the
-     * worker's own batches.
+     * This includes elements that are no longer queued, but still in a
+     * worker's own batch.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
+
+    //! The temporary evaluation result.
+    std::atomic<bool> fAllOk;
+
+    //! The deque the next Add starts filling, to spread small batches.
+    unsigned int nNextQueue;
+
+    //! Mutex and condition for idle workers and the master to sleep on.
+    boost::mutex mutex;
+    boost::condition_variable cond;
 
-    //! Whether we're shutting down.
-    bool fQuit;
+    //! The number of threads sleeping on cond.
+    std::atomic<int> nSleeping;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    int NumActiveQueues() const
+    {
+        return std::min(nWorkers.load(), MAX_QUEUES - 1) + 1;
+    }
+
+    //! Wake up all sleeping threads, if there are any.
+    void WakeSleepers()
+    {
+        if (nSleeping.load() > 0) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            cond.notify_all();
+        }
+    }
+
+    //! Move a batch of checks from the back of the given deque to vChecks.
+    bool TakeOwn(int nQueue, std::vector<T>& vChecks)
+    {
+        WorkerQueue& queue = *vQueues[nQueue];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.checks.empty())
+            return false;
+        // Leave most of a large deque for others to steal from.
+        unsigned int nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.checks.size() / 2));
+        vChecks.resize(nNow);
+        for (unsigned int i = 0; i < nNow; i++) {
+            vChecks[i].swap(queue.checks.back());
+            queue.checks.pop_back();
+        }
+        nQueued -= nNow;
+        return true;
+    }
+
+    //! Move half of another deque, from its front, to vChecks.
+    bool Steal(int nQueue, std::vector<T>& vChecks)
+    {
+        const int nActive = NumActiveQueues();
+        for (int i = 1; i < nActive; i++) {
+            WorkerQueue& queue = *vQueues[(nQueue + i) % nActive];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.checks.empty())
+                continue;
+            unsigned int nNow = std::max(1U, std::min(nBatchSize, (unsigned int)(queue.checks.size() + 1) / 2));
+            vChecks.resize(nNow);
+            for (unsigned int j = 0; j < nNow; j++) {
+                vChecks[j].swap(queue.checks.front());
+                queue.checks.pop_front();
+            }
+            nQueued -= nNow;
+            return true;
+        }
+        return false;
+    }
+
     /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false)
+    bool Loop(int nQueue, bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
+        int nSpins = 0;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
-                    nIdle++;
+            if (fMaster && nTodo.load() == 0) {
+                bool fRet = fAllOk.load();
+                // reset the status for new work later
+                fAllOk = true;
+                // return the current status
+                return fRet;
+            }
+            if (TakeOwn(nQueue, vChecks) || Steal(nQueue, vChecks)) {
+                nSpins = 0;
+                // execute work
+                bool fOk = fAllOk.load(std::memory_order_relaxed);
+                for (T& check : vChecks)
+                    if (fOk)
+                        fOk = check();
+                // Destroy the checks before reporting them done, so the
+                // master does not return while they are still alive.
+                unsigned int nNow = vChecks.size();
+                vChecks.clear();
+                if (!fOk)
+                    fAllOk = false;
+                if (nTodo.fetch_sub(nNow) == nNow && !fMaster)
+                    // We processed the last element; inform the master it can exit and return the result
+                    WakeSleepers();
+                continue;
+            }
+            if (nSpins < SPIN_ROUNDS) {
+                nSpins++;
+                std::this_thread::yield();
+                continue;
+            }
+            nSpins = 0;
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nSleeping++;
+            // Check again after announcing we are going to sleep, so that
+            // a concurrent Add or completion either sees nSleeping or is
+            // seen here.
+            while (nQueued.load() == 0 && !(fMaster && nTodo.load() == 0)) {
+                try {
                     cond.wait(lock); // wait
-                    nIdle--;
+                } catch (...) {
+                    nSleeping--;
+                    throw;
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
             }
-            // execute work
-            for (T& check : vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
+            nSleeping--;
         } while (true);
     }
 
@@ -131,33 +198,49 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    CCheckQueue(unsigned int nBatchSizeIn) : nWorkers(0), nQueued(0), nTodo(0), fAllOk(true), nNextQueue(0), nSleeping(0), nBatchSize(nBatchSizeIn)
+    {
+        for (int i = 0; i < MAX_QUEUES; i++)
+            vQueues.emplace_back(new WorkerQueue());
+    }
 
     //! Worker thread
     void Thread()
     {
-        Loop();
+        int nQueue = nWorkers++ % (MAX_QUEUES - 1) + 1;
+        Loop(nQueue);
     }
 
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
-        return Loop(true);
+        return Loop(0, true);
     }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty())
+            return;
+        // Count the checks before any worker can take or finish them.
         nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
+        nQueued += vChecks.size();
+        // Give every deque a contiguous share, starting where the previous
+        // Add stopped.
+        const unsigned int nActive = NumActiveQueues();
+        const unsigned int nShares = std::min(nActive, (unsigned int)vChecks.size());
+        size_t nPos = 0;
+        for (unsigned int i = 0; i < nShares; i++) {
+            size_t nEnd = vChecks.size() * (i + 1) / nShares;
+            WorkerQueue& queue = *vQueues[nNextQueue];
+            nNextQueue = (nNextQueue + 1) % nActive;
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            for (; nPos < nEnd; nPos++) {
+                queue.checks.push_back(T());
+                vChecks[nPos].swap(queue.checks.back());
+            }
+        }
+        WakeSleepers();
     }
 
     ~CCheckQueue()
@@ -166,7 +249,7 @@ public:
 
 };
 
-/** 
+/**
  * RAII-style controller object for a CCheckQueue that guarantees the passed
  * queue is finished before continuing.
  */
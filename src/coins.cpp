@@ -6,7 +6,10 @@
 
 #include "consensus/consensus.h"
 #include "memusage.h"
+#include "prevector.h"
 #include "random.h"
+#include "streams.h"
+#include "version.h"
 
 #include <assert.h>
 
@@ -14,6 +17,8 @@ bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return f
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint256>(); }
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
+bool CCoinsView::GetSetHash(CCoinsSetHash &setHash) const { return false; }
+void CCoinsView::ApplySetHashDelta(const CCoinsSetHash &delta) { }
 CCoinsViewCursor *CCoinsView::Cursor() const { return 0; }
 
 bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
@@ -29,21 +34,99 @@ uint256 CCoinsViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 std::vector<uint256> CCoinsViewBacked::GetHeadBlocks() const { return base->GetHeadBlocks(); }
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
 bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWrite(mapCoins, hashBlock); }
+bool CCoinsViewBacked::GetSetHash(CCoinsSetHash &setHash) const { return base->GetSetHash(setHash); }
+void CCoinsViewBacked::ApplySetHashDelta(const CCoinsSetHash &delta) { base->ApplySetHashDelta(delta); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
+size_t CCoinsViewBacked::PendingMemoryUsage() const { return base->PendingMemoryUsage(); }
+
+/**
+ * Serializes the bytes a coin adds to the rolling hash. They fit in place
+ * unless the script is unusually large.
+ */
+class SetHashElementWriter
+{
+public:
+    prevector<128, unsigned char> vch;
+
+    int GetType() const { return SER_GETHASH; }
+    int GetVersion() const { return PROTOCOL_VERSION; }
+
+    void write(const char* pch, size_t nSize)
+    {
+        vch.insert(vch.end(), (const unsigned char*)pch, (const unsigned char*)pch + nSize);
+    }
+
+    template <typename T>
+    SetHashElementWriter& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return *this;
+    }
+
+    SetHashElementWriter(const COutPoint& outpoint, const Coin& coin)
+    {
+        *this << outpoint;
+        *this << (uint32_t)(coin.nHeight * 2 + coin.fCoinBase);
+        *this << coin.out;
+    }
+};
+
+/** The same rough size per output as gettxoutsetinfo always reported. */
+static int64_t BogoSize(const Coin& coin)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + coin.out.scriptPubKey.size() /* scriptPubKey */;
+}
+
+void CCoinsSetHash::AddCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    SetHashElementWriter ss(outpoint, coin);
+    muhash.Insert(ss.vch.data(), ss.vch.size());
+    nTxOuts++;
+    nBogoSize += BogoSize(coin);
+    nTotalAmount += coin.out.nValue;
+}
+
+void CCoinsSetHash::RemoveCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    SetHashElementWriter ss(outpoint, coin);
+    muhash.Remove(ss.vch.data(), ss.vch.size());
+    nTxOuts--;
+    nBogoSize -= BogoSize(coin);
+    nTotalAmount -= coin.out.nValue;
+}
+
+CCoinsSetHash& CCoinsSetHash::operator+=(const CCoinsSetHash& delta)
+{
+    muhash *= delta.muhash;
+    nTxOuts += delta.nTxOuts;
+    nBogoSize += delta.nBogoSize;
+    nTotalAmount += delta.nTotalAmount;
+    return *this;
+}
+
+uint256 CCoinsSetHash::GetHash() const
+{
+    uint256 hash;
+    muhash.Finalize(hash.begin());
+    return hash;
+}
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn, bool fTrackSetHashIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0), fTrackSetHash(fTrackSetHashIn) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
-    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
+    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage + base->PendingMemoryUsage();
 }
 
 CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const {
     CCoinsMap::iterator it = cacheCoins.find(outpoint);
-    if (it != cacheCoins.end())
+    if (it != cacheCoins.end()) {
+        it->second.recent = true;
         return it;
+    }
     Coin tmp;
     if (!base->GetCoin(outpoint, tmp))
         return cacheCoins.end();
@@ -76,6 +159,19 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
     if (!inserted) {
         cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
     }
+    if (fTrackSetHash) {
+        if (!inserted) {
+            if (!it->second.coin.IsSpent())
+                setHashDelta.RemoveCoin(outpoint, it->second.coin);
+        } else if (possible_overwrite) {
+            // The coin may replace one the base has, which the rolling hash
+            // has to lose.
+            Coin coinOld;
+            if (base->GetCoin(outpoint, coinOld) && !coinOld.IsSpent())
+                setHashDelta.RemoveCoin(outpoint, coinOld);
+        }
+        setHashDelta.AddCoin(outpoint, coin);
+    }
     if (!possible_overwrite) {
         if (!it->second.coin.IsSpent()) {
             throw std::logic_error("Adding new coin that replaces non-pruned entry");
@@ -84,6 +180,7 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
     }
     it->second.coin = std::move(coin);
     it->second.flags |= CCoinsCacheEntry::DIRTY | (fresh ? CCoinsCacheEntry::FRESH : 0);
+    it->second.recent = true;
     cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
 }
 
@@ -102,6 +199,8 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin* moveout) {
     CCoinsMap::iterator it = FetchCoin(outpoint);
     if (it == cacheCoins.end()) return false;
     cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+    if (fTrackSetHash && !it->second.coin.IsSpent())
+        setHashDelta.RemoveCoin(outpoint, it->second.coin);
     if (moveout) {
         *moveout = std::move(it->second.coin);
     }
@@ -135,6 +234,16 @@ bool CCoinsViewCache::HaveCoinInCache(const COutPoint &outpoint) const {
     return (it != cacheCoins.end() && !it->second.coin.IsSpent());
 }
 
+void CCoinsViewCache::AddPrefetchedCoin(const COutPoint &outpoint, Coin&& coin) {
+    assert(!coin.IsSpent());
+    CCoinsMap::iterator it;
+    bool inserted;
+    std::tie(it, inserted) = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin)));
+    if (inserted) {
+        cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+    }
+}
+
 uint256 CCoinsViewCache::GetBestBlock() const {
     if (hashBlock.IsNull())
         hashBlock = base->GetBestBlock();
@@ -145,10 +254,35 @@ void CCoinsViewCache::SetBestBlock(const uint256 &hashBlockIn) {
     hashBlock = hashBlockIn;
 }
 
+bool CCoinsViewCache::GetSetHash(CCoinsSetHash &setHash) const {
+    if (!fTrackSetHash || !base->GetSetHash(setHash))
+        return false;
+    setHash += setHashDelta;
+    return true;
+}
+
+void CCoinsViewCache::ApplySetHashDelta(const CCoinsSetHash &delta) {
+    setHashDelta += delta;
+}
+
 bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn) {
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) { // Ignore non-dirty entries (optimization).
             CCoinsMap::iterator itUs = cacheCoins.find(it->first);
+            if (fTrackSetHash) {
+                // The child changes the coin from what this cache has, or
+                // unless the child created it, what the base has.
+                if (itUs != cacheCoins.end()) {
+                    if (!itUs->second.coin.IsSpent())
+                        setHashDelta.RemoveCoin(it->first, itUs->second.coin);
+                } else if (!(it->second.flags & CCoinsCacheEntry::FRESH)) {
+                    Coin coinOld;
+                    if (base->GetCoin(it->first, coinOld) && !coinOld.IsSpent())
+                        setHashDelta.RemoveCoin(it->first, coinOld);
+                }
+                if (!it->second.coin.IsSpent())
+                    setHashDelta.AddCoin(it->first, it->second.coin);
+            }
             if (itUs == cacheCoins.end()) {
                 // The parent cache does not have an entry, while the child does
                 // We can ignore it if it's both FRESH and pruned in the child
@@ -202,12 +336,82 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
 }
 
 bool CCoinsViewCache::Flush() {
+    if (fTrackSetHash) {
+        base->ApplySetHashDelta(setHashDelta);
+        setHashDelta = CCoinsSetHash();
+    }
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
     cachedCoinsUsage = 0;
     return fOk;
 }
 
+/** Memory usage of the cache if its entries were reallocated. Unlike
+ *  DynamicMemoryUsage(), this goes down whenever an entry is erased. */
+static size_t CompactedUsage(const CCoinsMap& map, size_t coinsUsage)
+{
+    size_t chunks = (map.size() + CCoinsMap::ENTRIES_PER_CHUNK - 1) / CCoinsMap::ENTRIES_PER_CHUNK;
+    return memusage::MallocUsage(CCoinsMap::ChunkBytes()) * chunks + memusage::MallocUsage(CCoinsMap::BucketBytes() * map.bucket_count()) + coinsUsage;
+}
+
+bool CCoinsViewCache::Sync(size_t nMaxUsage) {
+    CCoinsMap mapDirty;
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end();) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            CCoinsCacheEntry& entry = mapDirty[it->first];
+            entry.flags = it->second.flags;
+            if (it->second.coin.IsSpent()) {
+                // Nothing left worth caching once the base knows it is spent.
+                cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+                entry.coin = std::move(it->second.coin);
+                cacheCoins.erase(it++);
+                continue;
+            }
+            entry.coin = it->second.coin;
+            // The base has the entry now, so it is neither modified nor fresh.
+            it->second.flags = 0;
+        }
+        ++it;
+    }
+    if (fTrackSetHash) {
+        base->ApplySetHashDelta(setHashDelta);
+        setHashDelta = CCoinsSetHash();
+    }
+    bool fOk = base->BatchWrite(mapDirty, hashBlock);
+
+    // The copies the base is still writing take memory too, until it is done.
+    size_t nPendingUsage = base->PendingMemoryUsage();
+    nMaxUsage = nMaxUsage > nPendingUsage ? nMaxUsage - nPendingUsage : 0;
+
+    // Second chance eviction: the first pass only evicts entries that were
+    // not used since the last sync, and clears that mark on the others.
+    for (int pass = 0; pass < 2; pass++) {
+        for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end();) {
+            if (it->second.flags == 0 && (pass > 0 || !it->second.recent) && CompactedUsage(cacheCoins, cachedCoinsUsage) > nMaxUsage) {
+                cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+                cacheCoins.erase(it++);
+            } else {
+                it->second.recent = false;
+                ++it;
+            }
+        }
+        if (CompactedUsage(cacheCoins, cachedCoinsUsage) <= nMaxUsage)
+            break;
+    }
+    if (memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage > nMaxUsage)
+        ReallocateCache();
+    return fOk;
+}
+
+void CCoinsViewCache::ReallocateCache()
+{
+    CCoinsMap compacted(cacheCoins.size(), cacheCoins.hash_function(), cacheCoins.key_eq());
+    for (CCoinsMap::value_type& entry : cacheCoins) {
+        compacted.emplace(entry.first, std::move(entry.second));
+    }
+    cacheCoins = std::move(compacted);
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
@@ -9,6 +9,8 @@
 #include "primitives/transaction.h"
 #include "compressor.h"
 #include "core_memusage.h"
+#include "crypto/muhash.h"
+#include "flatmap.h"
 #include "hash.h"
 #include "memusage.h"
 #include "serialize.h"
@@ -85,7 +87,7 @@ class SaltedOutpointHasher
 {
 private:
     /** Salt */
-    const uint64_t k0, k1;
+    uint64_t k0, k1;
 
 public:
     SaltedOutpointHasher();
@@ -115,11 +117,50 @@ struct CCoinsCacheEntry
          */
     };
 
-    CCoinsCacheEntry() : flags(0) {}
-    explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
+    bool recent; // Whether this entry was used since the cache was last synced.
+
+    CCoinsCacheEntry() : flags(0), recent(true) {}
+    explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0), recent(true) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * Coins are looked up in a flat table rather than in a node based map, and
+ * stored in it inline. Scripts of up to 28 bytes, which covers the common
+ * output types, are stored inline too by CScript.
+ */
+typedef flatmap<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+
+/**
+ * Rolling hash and totals of a set of unspent outputs, or of a change to
+ * one. They are updated as coins are added and spent, so that they need not
+ * be recomputed from the whole set.
+ */
+class CCoinsSetHash
+{
+public:
+    MuHash3072 muhash;
+    int64_t nTxOuts;
+    int64_t nBogoSize;
+    CAmount nTotalAmount;
+
+    CCoinsSetHash() : nTxOuts(0), nBogoSize(0), nTotalAmount(0) {}
+
+    void AddCoin(const COutPoint& outpoint, const Coin& coin);
+    void RemoveCoin(const COutPoint& outpoint, const Coin& coin);
+    //! Apply a change to the set.
+    CCoinsSetHash& operator+=(const CCoinsSetHash& delta);
+    uint256 GetHash() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(muhash);
+        READWRITE(nTxOuts);
+        READWRITE(nBogoSize);
+        READWRITE(nTotalAmount);
+    }
+};
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -167,6 +208,12 @@ public:
     //! The passed mapCoins can be modified.
     virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
 
+    //! Retrieve the rolling hash of the whole state, if it is known.
+    virtual bool GetSetHash(CCoinsSetHash &setHash) const;
+
+    //! Apply the change to the rolling hash of the coins the next BatchWrite passes.
+    virtual void ApplySetHashDelta(const CCoinsSetHash &delta);
+
     //! Get a cursor to iterate over the whole state
     virtual CCoinsViewCursor *Cursor() const;
 
@@ -175,6 +222,9 @@ public:
 
     //! Estimate database size (0 if not implemented)
     virtual size_t EstimateSize() const { return 0; }
+
+    //! Memory used by coins passed to BatchWrite that are not written yet (0 if not implemented)
+    virtual size_t PendingMemoryUsage() const { return 0; }
 };
 
 
@@ -192,8 +242,11 @@ public:
     std::vector<uint256> GetHeadBlocks() const override;
     void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool GetSetHash(CCoinsSetHash &setHash) const override;
+    void ApplySetHashDelta(const CCoinsSetHash &delta) override;
     CCoinsViewCursor *Cursor() const override;
     size_t EstimateSize() const override;
+    size_t PendingMemoryUsage() const override;
 };
 
 
@@ -211,8 +264,18 @@ protected:
     /* Cached dynamic memory usage for the inner Coin objects. */
     mutable size_t cachedCoinsUsage;
 
+    /**
+     * Whether this cache keeps setHashDelta, the change to the rolling hash
+     * of the base, passed on by Flush and Sync. Only the cache that writes
+     * to the database does: it works out the changes of the caches on top
+     * of it from the entries they write to it, so that those do not pay for
+     * hashing every coin they touch, and cannot report a rolling hash.
+     */
+    const bool fTrackSetHash;
+    CCoinsSetHash setHashDelta;
+
 public:
-    CCoinsViewCache(CCoinsView *baseIn);
+    CCoinsViewCache(CCoinsView *baseIn, bool fTrackSetHashIn = false);
 
     // Standard CCoinsView methods
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
@@ -220,6 +283,8 @@ public:
     uint256 GetBestBlock() const override;
     void SetBestBlock(const uint256 &hashBlock);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool GetSetHash(CCoinsSetHash &setHash) const override;
+    void ApplySetHashDelta(const CCoinsSetHash &delta) override;
     CCoinsViewCursor* Cursor() const override {
         throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
     }
@@ -231,6 +296,14 @@ public:
      */
     bool HaveCoinInCache(const COutPoint &outpoint) const;
 
+    /**
+     * Add an unspent coin that was looked up in the base view ahead of time,
+     * e.g. by another thread, as if it had been accessed. If the cache
+     * already has an entry for the outpoint, which may be newer than the
+     * base view, that entry is kept.
+     */
+    void AddPrefetchedCoin(const COutPoint &outpoint, Coin&& coin);
+
     /**
      * Return a reference to Coin in the cache, or a pruned one if not found. This is
      * more efficient than GetCoin.
@@ -245,7 +318,7 @@ public:
 
     /**
      * Add a coin. Set potential_overwrite to true if a non-pruned version may
-     * already exist.
+     * already exist. Like SpendCoin, this updates the rolling hash.
      */
     void AddCoin(const COutPoint& outpoint, Coin&& coin, bool potential_overwrite);
 
@@ -263,6 +336,16 @@ public:
      */
     bool Flush();
 
+    /**
+     * Push the modifications applied to this cache to its base, but keep
+     * the entries cached, now unmodified. Then evict unmodified entries that
+     * were not used since the previous call until the dynamic memory usage,
+     * which counts the coins the base is still writing, is at most
+     * nMaxUsage, and only if that is not enough, recently used ones too. Spent entries are always dropped.
+     * If false is returned, the state of this cache (and its backing view) will be undefined.
+     */
+    bool Sync(size_t nMaxUsage);
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is
      * not modified.
@@ -272,7 +355,7 @@ public:
     //! Calculate the size of the cache (in number of transaction outputs)
     unsigned int GetCacheSize() const;
 
-    //! Calculate the size of the cache (in bytes)
+    //! Calculate the size of the cache (in bytes), with the coins the base is still writing
     size_t DynamicMemoryUsage() const;
 
     /** 
@@ -291,12 +374,35 @@ public:
 private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
 
+    /**
+     * Move the cache entries to a new map, releasing the memory of the old
+     * one. Erasing entries only puts their memory up for reuse by the cache.
+     */
+    void ReallocateCache();
+
     /**
      * By making the copy constructor private, we prevent accidentally using it when one intends to create a cache on top of a base cache.
      */
     CCoinsViewCache(const CCoinsViewCache &);
 };
 
+/**
+ * The coins spent by a transaction as found in a view, indexed like the
+ * transaction's inputs. Lets code that is also given the spent coins as a
+ * vector, like the undo data of a block, look them up the same way.
+ */
+class CTxSpentCoins
+{
+private:
+    const CCoinsViewCache& view;
+    const CTransaction& tx;
+
+public:
+    CTxSpentCoins(const CCoinsViewCache& viewIn, const CTransaction& txIn) : view(viewIn), tx(txIn) {}
+
+    const Coin& operator[](size_t nIn) const { return view.AccessCoin(tx.vin[nIn].prevout); }
+};
+
 //! Utility function to add all of a transaction's outputs to a cache.
 // When check is false, this assumes that overwrites are only possible for coinbase transactions.
 // When check is true, the underlying view may be queried to determine whether an addition is
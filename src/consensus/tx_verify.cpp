@@ -118,7 +118,8 @@ unsigned int GetLegacySigOpCount(const CTransaction& tx)
     return nSigOps;
 }
 
-unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& inputs)
+template <typename SpentCoins>
+static unsigned int P2SHSigOpCount(const CTransaction& tx, const SpentCoins& coins)
 {
     if (tx.IsCoinBase())
         return 0;
@@ -126,7 +127,7 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& in
     unsigned int nSigOps = 0;
     for (unsigned int i = 0; i < tx.vin.size(); i++)
     {
-        const Coin& coin = inputs.AccessCoin(tx.vin[i].prevout);
+        const Coin& coin = coins[i];
         assert(!coin.IsSpent());
         const CTxOut &prevout = coin.out;
         if (prevout.scriptPubKey.IsPayToScriptHash())
@@ -135,7 +136,19 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& in
     return nSigOps;
 }
 
-int64_t GetTransactionSigOpCost(const CTransaction& tx, const CCoinsViewCache& inputs, int flags)
+unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& inputs)
+{
+    return P2SHSigOpCount(tx, CTxSpentCoins(inputs, tx));
+}
+
+unsigned int GetP2SHSigOpCount(const CTransaction& tx, const std::vector<Coin>& spentCoins)
+{
+    assert(tx.IsCoinBase() || spentCoins.size() == tx.vin.size());
+    return P2SHSigOpCount(tx, spentCoins);
+}
+
+template <typename SpentCoins>
+static int64_t TransactionSigOpCost(const CTransaction& tx, const SpentCoins& coins, int flags)
 {
     int64_t nSigOps = GetLegacySigOpCount(tx) * WITNESS_SCALE_FACTOR;
 
@@ -143,12 +156,12 @@ int64_t GetTransactionSigOpCost(const CTransaction& tx, const CCoinsViewCache& i
         return nSigOps;
 
     if (flags & SCRIPT_VERIFY_P2SH) {
-        nSigOps += GetP2SHSigOpCount(tx, inputs) * WITNESS_SCALE_FACTOR;
+        nSigOps += P2SHSigOpCount(tx, coins) * WITNESS_SCALE_FACTOR;
     }
 
     for (unsigned int i = 0; i < tx.vin.size(); i++)
     {
-        const Coin& coin = inputs.AccessCoin(tx.vin[i].prevout);
+        const Coin& coin = coins[i];
         assert(!coin.IsSpent());
         const CTxOut &prevout = coin.out;
         nSigOps += CountWitnessSigOps(tx.vin[i].scriptSig, prevout.scriptPubKey, &tx.vin[i].scriptWitness, flags);
@@ -156,6 +169,17 @@ int64_t GetTransactionSigOpCost(const CTransaction& tx, const CCoinsViewCache& i
     return nSigOps;
 }
 
+int64_t GetTransactionSigOpCost(const CTransaction& tx, const CCoinsViewCache& inputs, int flags)
+{
+    return TransactionSigOpCost(tx, CTxSpentCoins(inputs, tx), flags);
+}
+
+int64_t GetTransactionSigOpCost(const CTransaction& tx, const std::vector<Coin>& spentCoins, int flags)
+{
+    assert(tx.IsCoinBase() || spentCoins.size() == tx.vin.size());
+    return TransactionSigOpCost(tx, spentCoins, flags);
+}
+
 bool CheckTransaction(const CTransaction& tx, CValidationState &state, bool fCheckDuplicateInputs)
 {
     // Basic checks that don't depend on any context
@@ -205,19 +229,14 @@ bool CheckTransaction(const CTransaction& tx, CValidationState &state, bool fChe
     return true;
 }
 
-bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, int nSpendHeight)
+template <typename SpentCoins>
+static bool CheckTxInputValues(const CTransaction& tx, CValidationState& state, const SpentCoins& coins, int nSpendHeight)
 {
-        // This doesn't trigger the DoS code on purpose; if it did, it would make it easier
-        // for an attacker to attempt to split the network.
-        if (!inputs.HaveInputs(tx))
-            return state.Invalid(false, 0, "", "Inputs unavailable");
-
         CAmount nValueIn = 0;
         CAmount nFees = 0;
         for (unsigned int i = 0; i < tx.vin.size(); i++)
         {
-            const COutPoint &prevout = tx.vin[i].prevout;
-            const Coin& coin = inputs.AccessCoin(prevout);
+            const Coin& coin = coins[i];
             assert(!coin.IsSpent());
 
             // If prev is coinbase, check that it's matured
@@ -248,3 +267,19 @@ bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, c
             return state.DoS(100, false, REJECT_INVALID, "bad-txns-fee-outofrange");
     return true;
 }
+
+bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, int nSpendHeight)
+{
+        // This doesn't trigger the DoS code on purpose; if it did, it would make it easier
+        // for an attacker to attempt to split the network.
+        if (!inputs.HaveInputs(tx))
+            return state.Invalid(false, 0, "", "Inputs unavailable");
+
+        return CheckTxInputValues(tx, state, CTxSpentCoins(inputs, tx), nSpendHeight);
+}
+
+bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, const std::vector<Coin>& spentCoins, int nSpendHeight)
+{
+    assert(spentCoins.size() == tx.vin.size());
+    return CheckTxInputValues(tx, state, spentCoins, nSpendHeight);
+}
@@ -10,6 +10,7 @@
 
 class CBlockIndex;
 class CCoinsViewCache;
+class Coin;
 class CTransaction;
 class CValidationState;
 
@@ -25,6 +26,12 @@ namespace Consensus {
  * Preconditions: tx.IsCoinBase() is false.
  */
 bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, int nSpendHeight);
+
+/**
+ * Same as above, given the coins spent by the transaction in the order of its
+ * inputs instead of a view to look them up in.
+ */
+bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const std::vector<Coin>& spentCoins, int nSpendHeight);
 } // namespace Consensus
 
 /** Auxiliary functions for transaction validation (ideally should not be exposed) */
@@ -44,6 +51,7 @@ unsigned int GetLegacySigOpCount(const CTransaction& tx);
  * @see CTransaction::FetchInputs
  */
 unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& mapInputs);
+unsigned int GetP2SHSigOpCount(const CTransaction& tx, const std::vector<Coin>& spentCoins);
 
 /**
  * Compute total signature operation cost of a transaction.
@@ -53,6 +61,7 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& ma
  * @return Total signature operation cost of tx
  */
 int64_t GetTransactionSigOpCost(const CTransaction& tx, const CCoinsViewCache& inputs, int flags);
+int64_t GetTransactionSigOpCost(const CTransaction& tx, const std::vector<Coin>& spentCoins, int flags);
 
 /**
  * Check if transaction is final and can be included in a block with the
@@ -0,0 +1,194 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/chacha20.h"
+#include "crypto/sha256.h"
+
+#include <string.h>
+
+namespace {
+
+typedef Num3072::limb_t limb_t;
+typedef Num3072::double_limb_t double_limb_t;
+constexpr int LIMBS = Num3072::LIMBS;
+constexpr int LIMB_SIZE = Num3072::LIMB_SIZE;
+/** 2^3072 - MAX_PRIME_DIFF is the largest prime below 2^3072. */
+constexpr limb_t MAX_PRIME_DIFF = 1103717;
+
+/** Add a * b to the three limb accumulator [c0,c1,c2]. */
+inline void muladd3(limb_t& c0, limb_t& c1, limb_t& c2, limb_t a, limb_t b)
+{
+    double_limb_t t = (double_limb_t)a * b;
+    limb_t th = t >> LIMB_SIZE;
+    limb_t tl = t;
+    c0 += tl;
+    th += (c0 < tl);
+    c1 += th;
+    c2 += (c1 < th);
+}
+
+/** Whether n, which is below 2^3072, is at least the modulus. */
+bool IsOverflow(const Num3072& n)
+{
+    if (n.limbs[0] <= ~(limb_t)0 - MAX_PRIME_DIFF)
+        return false;
+    for (int i = 1; i < LIMBS; ++i) {
+        if (n.limbs[i] != ~(limb_t)0)
+            return false;
+    }
+    return true;
+}
+
+/** Subtract the modulus from n, which is at least the modulus, by adding 2^3072 - modulus. */
+void FullReduce(Num3072& n)
+{
+    limb_t carry = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS && carry; ++i) {
+        n.limbs[i] += carry;
+        carry = n.limbs[i] < carry;
+    }
+}
+
+/** Hash a byte string to a number. */
+Num3072 ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(key);
+    unsigned char tmp[Num3072::BYTE_SIZE];
+    ChaCha20(key, sizeof(key)).Output(tmp, sizeof(tmp));
+    return Num3072(tmp);
+}
+
+} // namespace
+
+Num3072::Num3072()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i)
+        limbs[i] = 0;
+}
+
+Num3072::Num3072(const unsigned char* data)
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        limbs[i] = 0;
+        for (int j = sizeof(limb_t) - 1; j >= 0; --j)
+            limbs[i] = (limbs[i] << 8) | data[i * sizeof(limb_t) + j];
+    }
+}
+
+void Num3072::ToBytes(unsigned char* data) const
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        for (size_t j = 0; j < sizeof(limb_t); ++j)
+            data[i * sizeof(limb_t) + j] = limbs[i] >> (8 * j);
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    // Schoolbook product into 2 * LIMBS limbs, column by column.
+    limb_t tmp[2 * LIMBS];
+    limb_t c0 = 0, c1 = 0, c2 = 0;
+    for (int k = 0; k < 2 * LIMBS - 1; ++k) {
+        const int lo = k < LIMBS ? 0 : k - LIMBS + 1;
+        const int hi = k < LIMBS ? k : LIMBS - 1;
+        for (int i = lo; i <= hi; ++i)
+            muladd3(c0, c1, c2, limbs[i], a.limbs[k - i]);
+        tmp[k] = c0;
+        c0 = c1;
+        c1 = c2;
+        c2 = 0;
+    }
+    tmp[2 * LIMBS - 1] = c0;
+
+    // As 2^3072 is MAX_PRIME_DIFF modulo the prime, the high half folds
+    // into the low half multiplied by it.
+    double_limb_t carry = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        carry += (double_limb_t)tmp[LIMBS + i] * MAX_PRIME_DIFF + tmp[i];
+        limbs[i] = (limb_t)carry;
+        carry >>= LIMB_SIZE;
+    }
+    // The same for what carried out of the top limb; that can only carry
+    // out again once, with a small enough result to not carry a third time.
+    while (carry) {
+        carry *= MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS && carry; ++i) {
+            carry += limbs[i];
+            limbs[i] = (limb_t)carry;
+            carry >>= LIMB_SIZE;
+        }
+    }
+    if (IsOverflow(*this))
+        FullReduce(*this);
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // By Fermat's little theorem the inverse is this^(p - 2). Exponentiate
+    // with a window of 4 bits. All bits of p - 2 are set except in the
+    // lowest limb.
+    Num3072 table[16];
+    table[1] = *this;
+    for (int i = 2; i < 16; ++i) {
+        table[i] = table[i - 1];
+        table[i].Multiply(*this);
+    }
+    const limb_t low = (limb_t)0 - MAX_PRIME_DIFF - 2;
+    Num3072 r;
+    for (int i = LIMBS - 1; i >= 0; --i) {
+        const limb_t e = i ? ~(limb_t)0 : low;
+        for (int shift = LIMB_SIZE - 4; shift >= 0; shift -= 4) {
+            for (int j = 0; j < 4; ++j)
+                r.Multiply(r);
+            const int w = (e >> shift) & 15;
+            if (w)
+                r.Multiply(table[w]);
+        }
+    }
+    return r;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    Multiply(a.GetInverse());
+}
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& other)
+{
+    numerator.Multiply(other.numerator);
+    denominator.Multiply(other.denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& other)
+{
+    numerator.Multiply(other.denominator);
+    denominator.Multiply(other.numerator);
+    return *this;
+}
+
+void MuHash3072::Finalize(unsigned char* hash) const
+{
+    Num3072 r = numerator;
+    r.Divide(denominator);
+    unsigned char data[Num3072::BYTE_SIZE];
+    r.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(hash);
+}
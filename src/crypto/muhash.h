@@ -0,0 +1,97 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** A number modulo the prime 2^3072 - 1103717. */
+class Num3072
+{
+public:
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 double_limb_t;
+    typedef uint64_t limb_t;
+    static const int LIMBS = 48;
+    static const int LIMB_SIZE = 64;
+#else
+    typedef uint64_t double_limb_t;
+    typedef uint32_t limb_t;
+    static const int LIMBS = 96;
+    static const int LIMB_SIZE = 32;
+#endif
+    static const size_t BYTE_SIZE = 384;
+
+    limb_t limbs[LIMBS];
+
+    //! Construct the number 1.
+    Num3072();
+    //! Construct from BYTE_SIZE little endian bytes. The result need not be reduced.
+    explicit Num3072(const unsigned char* data);
+
+    //! Multiply by a, the result is fully reduced.
+    void Multiply(const Num3072& a);
+    //! Multiply by the inverse of a. a must not be a multiple of the modulus.
+    void Divide(const Num3072& a);
+    //! Write BYTE_SIZE little endian bytes.
+    void ToBytes(unsigned char* data) const;
+
+private:
+    Num3072 GetInverse() const;
+};
+
+/**
+ * A hash of a multiset of byte strings, which can be updated in constant
+ * time as elements are added or removed, and where two hashes can be
+ * combined into the hash of the union of their sets.
+ *
+ * Elements are hashed to numbers modulo a 3072-bit prime with SHA256 and
+ * ChaCha20, and the set is hashed to their product (MuHash). Additions and
+ * removals are kept apart as numerator and denominator so that only
+ * Finalize has to compute an inverse.
+ */
+class MuHash3072
+{
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+public:
+    //! Start with the empty set.
+    MuHash3072() {}
+
+    //! Add an element to the set.
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    //! Remove an element from the set. It is not checked that it is in the set.
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+    //! Add all elements of the set hashed by other.
+    MuHash3072& operator*=(const MuHash3072& other);
+    //! Remove all elements of the set hashed by other.
+    MuHash3072& operator/=(const MuHash3072& other);
+
+    //! Compute the 32-byte hash of the set.
+    void Finalize(unsigned char* hash) const;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        unsigned char data[2 * Num3072::BYTE_SIZE];
+        numerator.ToBytes(data);
+        denominator.ToBytes(data + Num3072::BYTE_SIZE);
+        s.write((const char*)data, sizeof(data));
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        unsigned char data[2 * Num3072::BYTE_SIZE];
+        s.read((char*)data, sizeof(data));
+        numerator = Num3072(data);
+        denominator = Num3072(data + Num3072::BYTE_SIZE);
+    }
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
@@ -6,6 +6,12 @@
 
 #include "crypto/common.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <string.h>
 
 // Internal implementation code.
@@ -14,11 +20,11 @@ namespace
 /// Internal RIPEMD-160 implementation.
 namespace ripemd160
 {
-uint32_t inline f1(uint32_t x, uint32_t y, uint32_t z) { return x ^ y ^ z; }
-uint32_t inline f2(uint32_t x, uint32_t y, uint32_t z) { return (x & y) | (~x & z); }
-uint32_t inline f3(uint32_t x, uint32_t y, uint32_t z) { return (x | ~y) ^ z; }
-uint32_t inline f4(uint32_t x, uint32_t y, uint32_t z) { return (x & z) | (y & ~z); }
-uint32_t inline f5(uint32_t x, uint32_t y, uint32_t z) { return x ^ (y | ~z); }
+template<typename W> W inline f1(W x, W y, W z) { return x ^ y ^ z; }
+template<typename W> W inline f2(W x, W y, W z) { return (x & y) | (~x & z); }
+template<typename W> W inline f3(W x, W y, W z) { return (x | ~y) ^ z; }
+template<typename W> W inline f4(W x, W y, W z) { return (x & z) | (y & ~z); }
+template<typename W> W inline f5(W x, W y, W z) { return x ^ (y | ~z); }
 
 /** Initialize RIPEMD-160 state. */
 void inline Initialize(uint32_t* s)
@@ -32,33 +38,35 @@ void inline Initialize(uint32_t* s)
 
 uint32_t inline rol(uint32_t x, int i) { return (x << i) | (x >> (32 - i)); }
 
-void inline Round(uint32_t& a, uint32_t b, uint32_t& c, uint32_t d, uint32_t e, uint32_t f, uint32_t x, uint32_t k, int r)
+template<typename W> void inline Round(W& a, W b, W& c, W d, W e, W f, W x, uint32_t k, int r)
 {
-    a = rol(a + f + x + k, r) + e;
+    a = rol(a + f + x + W(k), r) + e;
     c = rol(c, 10);
 }
 
-void inline R11(uint32_t& a, uint32_t b, uint32_t& c, uint32_t d, uint32_t e, uint32_t x, int r) { Round(a, b, c, d, e, f1(b, c, d), x, 0, r); }
-void inline R21(uint32_t& a, uint32_t b, uint32_t& c, uint32_t d, uint32_t e, uint32_t x, int r) { Round(a, b, c, d, e, f2(b, c, d), x, 0x5A827999ul, r); }
-void inline R31(uint32_t& a, uint32_t b, uint32_t& c, uint32_t d, uint32_t e, uint32_t x, int r) { Round(a, b, c, d, e, f3(b, c, d), x, 0x6ED9EBA1ul, r); }
-void inline R41(uint32_t& a, uint32_t b, uint32_t& c, uint32_t d, uint32_t e, uint32_t x, int r) { Round(a, b, c, d, e, f4(b, c, d), x, 0x8F1BBCDCul, r); }
-void inline R51(uint32_t& a, uint32_t b, uint32_t& c, uint32_t d, uint32_t e, uint32_t x, int r) { Round(a, b, c, d, e, f5(b, c, d), x, 0xA953FD4Eul, r); }
+template<typename W> void inline R11(W& a, W b, W& c, W d, W e, W x, int r) { Round(a, b, c, d, e, f1(b, c, d), x, 0, r); }
+template<typename W> void inline R21(W& a, W b, W& c, W d, W e, W x, int r) { Round(a, b, c, d, e, f2(b, c, d), x, 0x5A827999ul, r); }
+template<typename W> void inline R31(W& a, W b, W& c, W d, W e, W x, int r) { Round(a, b, c, d, e, f3(b, c, d), x, 0x6ED9EBA1ul, r); }
+template<typename W> void inline R41(W& a, W b, W& c, W d, W e, W x, int r) { Round(a, b, c, d, e, f4(b, c, d), x, 0x8F1BBCDCul, r); }
+template<typename W> void inline R51(W& a, W b, W& c, W d, W e, W x, int r) { Round(a, b, c, d, e, f5(b, c, d), x, 0xA953FD4Eul, r); }
 
-void inline R12(uint32_t& a, uint32_t b, uint32_t& c, uint32_t d, uint32_t e, uint32_t x, int r) { Round(a, b, c, d, e, f5(b, c, d), x, 0x50A28BE6ul, r); }
-void inline R22(uint32_t& a, uint32_t b, uint32_t& c, uint32_t d, uint32_t e, uint32_t x, int r) { Round(a, b, c, d, e, f4(b, c, d), x, 0x5C4DD124ul, r); }
-void inline R32(uint32_t& a, uint32_t b, uint32_t& c, uint32_t d, uint32_t e, uint32_t x, int r) { Round(a, b, c, d, e, f3(b, c, d), x, 0x6D703EF3ul, r); }
-void inline R42(uint32_t& a, uint32_t b, uint32_t& c, uint32_t d, uint32_t e, uint32_t x, int r) { Round(a, b, c, d, e, f2(b, c, d), x, 0x7A6D76E9ul, r); }
-void inline R52(uint32_t& a, uint32_t b, uint32_t& c, uint32_t d, uint32_t e, uint32_t x, int r) { Round(a, b, c, d, e, f1(b, c, d), x, 0, r); }
+template<typename W> void inline R12(W& a, W b, W& c, W d, W e, W x, int r) { Round(a, b, c, d, e, f5(b, c, d), x, 0x50A28BE6ul, r); }
+template<typename W> void inline R22(W& a, W b, W& c, W d, W e, W x, int r) { Round(a, b, c, d, e, f4(b, c, d), x, 0x5C4DD124ul, r); }
+template<typename W> void inline R32(W& a, W b, W& c, W d, W e, W x, int r) { Round(a, b, c, d, e, f3(b, c, d), x, 0x6D703EF3ul, r); }
+template<typename W> void inline R42(W& a, W b, W& c, W d, W e, W x, int r) { Round(a, b, c, d, e, f2(b, c, d), x, 0x7A6D76E9ul, r); }
+template<typename W> void inline R52(W& a, W b, W& c, W d, W e, W x, int r) { Round(a, b, c, d, e, f1(b, c, d), x, 0, r); }
 
-/** Perform a RIPEMD-160 transformation, processing a 64-byte chunk. */
-void Transform(uint32_t* s, const unsigned char* chunk)
+/** Perform a RIPEMD-160 transformation on the 16 message words of a 64-byte chunk.
+ *  W is either uint32_t or a vector of independent 32-bit lanes. */
+template<typename W>
+void inline TransformWords(W* s, const W* w)
 {
-    uint32_t a1 = s[0], b1 = s[1], c1 = s[2], d1 = s[3], e1 = s[4];
-    uint32_t a2 = a1, b2 = b1, c2 = c1, d2 = d1, e2 = e1;
-    uint32_t w0 = ReadLE32(chunk + 0), w1 = ReadLE32(chunk + 4), w2 = ReadLE32(chunk + 8), w3 = ReadLE32(chunk + 12);
-    uint32_t w4 = ReadLE32(chunk + 16), w5 = ReadLE32(chunk + 20), w6 = ReadLE32(chunk + 24), w7 = ReadLE32(chunk + 28);
-    uint32_t w8 = ReadLE32(chunk + 32), w9 = ReadLE32(chunk + 36), w10 = ReadLE32(chunk + 40), w11 = ReadLE32(chunk + 44);
-    uint32_t w12 = ReadLE32(chunk + 48), w13 = ReadLE32(chunk + 52), w14 = ReadLE32(chunk + 56), w15 = ReadLE32(chunk + 60);
+    W a1 = s[0], b1 = s[1], c1 = s[2], d1 = s[3], e1 = s[4];
+    W a2 = a1, b2 = b1, c2 = c1, d2 = d1, e2 = e1;
+    W w0 = w[0], w1 = w[1], w2 = w[2], w3 = w[3];
+    W w4 = w[4], w5 = w[5], w6 = w[6], w7 = w[7];
+    W w8 = w[8], w9 = w[9], w10 = w[10], w11 = w[11];
+    W w12 = w[12], w13 = w[13], w14 = w[14], w15 = w[15];
 
     R11(a1, b1, c1, d1, e1, w0, 11);
     R12(a2, b2, c2, d2, e2, w5, 8);
@@ -225,7 +233,7 @@ void Transform(uint32_t* s, const unsigned char* chunk)
     R51(b1, c1, d1, e1, a1, w13, 6);
     R52(b2, c2, d2, e2, a2, w11, 11);
 
-    uint32_t t = s[0];
+    W t = s[0];
     s[0] = s[1] + c1 + d2;
     s[1] = s[2] + d1 + e2;
     s[2] = s[3] + e1 + a2;
@@ -233,8 +241,99 @@ void Transform(uint32_t* s, const unsigned char* chunk)
     s[4] = t + b1 + c2;
 }
 
+/** Perform a RIPEMD-160 transformation, processing a 64-byte chunk. */
+void Transform(uint32_t* s, const unsigned char* chunk)
+{
+    uint32_t w[16];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ReadLE32(chunk + 4 * i);
+    }
+    TransformWords(s, w);
+}
+
 } // namespace ripemd160
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__SSE2__)
+/// Four independent RIPEMD-160 computations in the lanes of a 128-bit vector.
+namespace ripemd160_4way
+{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+typedef uint32x4_t vec;
+vec inline Splat(uint32_t k) { return vdupq_n_u32(k); }
+vec inline Load(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    alignas(16) const uint32_t v[4] = {a, b, c, d};
+    return vld1q_u32(v);
+}
+void inline Store(uint32_t* out, vec x) { vst1q_u32(out, x); }
+vec inline Add(vec x, vec y) { return vaddq_u32(x, y); }
+vec inline Xor(vec x, vec y) { return veorq_u32(x, y); }
+vec inline And(vec x, vec y) { return vandq_u32(x, y); }
+vec inline Or(vec x, vec y) { return vorrq_u32(x, y); }
+vec inline Not(vec x) { return vmvnq_u32(x); }
+vec inline Rol(vec x, int i) { return vorrq_u32(vshlq_u32(x, vdupq_n_s32(i)), vshlq_u32(x, vdupq_n_s32(i - 32))); }
+#else
+typedef __m128i vec;
+vec inline Splat(uint32_t k) { return _mm_set1_epi32(k); }
+vec inline Load(uint32_t a, uint32_t b, uint32_t c, uint32_t d) { return _mm_set_epi32(d, c, b, a); }
+void inline Store(uint32_t* out, vec x) { _mm_storeu_si128((__m128i*)out, x); }
+vec inline Add(vec x, vec y) { return _mm_add_epi32(x, y); }
+vec inline Xor(vec x, vec y) { return _mm_xor_si128(x, y); }
+vec inline And(vec x, vec y) { return _mm_and_si128(x, y); }
+vec inline Or(vec x, vec y) { return _mm_or_si128(x, y); }
+vec inline Not(vec x) { return _mm_xor_si128(x, _mm_set1_epi32(-1)); }
+vec inline Rol(vec x, int i) { return _mm_or_si128(_mm_slli_epi32(x, i), _mm_srli_epi32(x, 32 - i)); }
+#endif
+
+/** Word type for ripemd160::TransformWords, applying every operation to all lanes. */
+struct Word
+{
+    vec v;
+    Word() {}
+    Word(vec x) : v(x) {}
+    explicit Word(uint32_t k) : v(Splat(k)) {}
+};
+
+Word inline operator+(Word x, Word y) { return Add(x.v, y.v); }
+Word inline operator^(Word x, Word y) { return Xor(x.v, y.v); }
+Word inline operator&(Word x, Word y) { return And(x.v, y.v); }
+Word inline operator|(Word x, Word y) { return Or(x.v, y.v); }
+Word inline operator~(Word x) { return Not(x.v); }
+Word inline rol(Word x, int i) { return Rol(x.v, i); }
+
+/** Compute the RIPEMD-160 hashes of four 32-byte inputs (in: 4*32 bytes, out: 4*20 bytes). */
+void Transform_32(unsigned char* out, const unsigned char* in)
+{
+    Word s[5], w[16];
+    for (int i = 0; i < 8; i++) {
+        w[i] = Load(ReadLE32(in + 4 * i), ReadLE32(in + 32 + 4 * i), ReadLE32(in + 64 + 4 * i), ReadLE32(in + 96 + 4 * i));
+    }
+    // Padding of a single 32-byte message: 0x80 terminator, then the length in bits.
+    w[8] = Word(0x80);
+    for (int i = 9; i < 16; i++) {
+        w[i] = Word(0);
+    }
+    w[14] = Word(32 << 3);
+
+    uint32_t init[5];
+    ripemd160::Initialize(init);
+    for (int i = 0; i < 5; i++) {
+        s[i] = Word(init[i]);
+    }
+    ripemd160::TransformWords(s, w);
+
+    alignas(16) uint32_t lanes[4];
+    for (int i = 0; i < 5; i++) {
+        Store(lanes, s[i].v);
+        for (int j = 0; j < 4; j++) {
+            WriteLE32(out + 20 * j + 4 * i, lanes[j]);
+        }
+    }
+}
+
+} // namespace ripemd160_4way
+#endif
+
 } // namespace
 
 ////// RIPEMD160
@@ -290,3 +389,21 @@ CRIPEMD160& CRIPEMD160::Reset()
     ripemd160::Initialize(s);
     return *this;
 }
+
+void RIPEMD160_32(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__SSE2__)
+    while (blocks >= 4) {
+        ripemd160_4way::Transform_32(out, in);
+        out += 4 * CRIPEMD160::OUTPUT_SIZE;
+        in += 4 * 32;
+        blocks -= 4;
+    }
+#endif
+    while (blocks) {
+        CRIPEMD160().Write(in, 32).Finalize(out);
+        out += CRIPEMD160::OUTPUT_SIZE;
+        in += 32;
+        blocks -= 1;
+    }
+}
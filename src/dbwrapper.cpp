@@ -15,6 +15,9 @@
 #include <stdint.h>
 #include <algorithm>
 
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+
 class CBitcoinLevelDBLogger : public leveldb::Logger {
 public:
     // This code is adapted from posix_logger.h, which is why it is using vsprintf.
@@ -73,14 +76,73 @@ public:
     }
 };
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+std::string CDBOptions::ToString() const
+{
+    return strprintf("blockcache=%d,writebuffer=%d,bloombits=%d,maxopenfiles=%d,blocksize=%u,maxfilesize=%u",
+        nBlockCachePercent, nWriteBufferPercent, nBloomBits, nMaxOpenFiles, nBlockSize, nMaxFileSize);
+}
+
+bool ParseDBOptions(const std::string& strOptions, CDBOptions& dbOptions, std::string& strError)
+{
+    CDBOptions result;
+    std::vector<std::string> vOptions;
+    boost::split(vOptions, strOptions, boost::is_any_of(","));
+    for (const std::string& strOption : vOptions) {
+        if (strOption.empty() || strOption == "default") {
+            continue;
+        } else if (strOption == "lowmem") {
+            // For small boards: most of the cache goes to reading, not to
+            // write buffers, and larger blocks keep the index of every open
+            // table, which lives outside the cache, four times smaller.
+            // Writes flush more often and every read decodes a larger block,
+            // so this is slower than the default.
+            result.nBlockCachePercent = 70;
+            result.nWriteBufferPercent = 10;
+            result.nBlockSize = 16 << 10;
+            continue;
+        }
+        const size_t nEquals = strOption.find('=');
+        int64_t nValue;
+        if (nEquals == std::string::npos || !ParseInt64(strOption.substr(nEquals + 1), &nValue) || nValue < 0) {
+            strError = strprintf("invalid database option '%s'", strOption);
+            return false;
+        }
+        const std::string strName = strOption.substr(0, nEquals);
+        if (strName == "blockcache" && nValue <= 100) {
+            result.nBlockCachePercent = nValue;
+        } else if (strName == "writebuffer" && nValue >= 1 && nValue <= 50) {
+            result.nWriteBufferPercent = nValue;
+        } else if (strName == "bloombits" && nValue <= 64) {
+            result.nBloomBits = nValue;
+        } else if (strName == "maxopenfiles" && nValue <= 50000) {
+            result.nMaxOpenFiles = nValue;
+        } else if (strName == "blocksize" && nValue >= (1 << 10) && nValue <= (4 << 20)) {
+            result.nBlockSize = nValue;
+        } else if (strName == "maxfilesize" && nValue >= (1 << 20) && nValue <= (1 << 30)) {
+            result.nMaxFileSize = nValue;
+        } else {
+            strError = strprintf("invalid database option '%s'", strOption);
+            return false;
+        }
+    }
+    if (result.nBlockCachePercent + 2 * result.nWriteBufferPercent > 100) {
+        strError = "block cache and two write buffers exceed the cache size";
+        return false;
+    }
+    dbOptions = result;
+    return true;
+}
+
+static leveldb::Options GetOptions(size_t nCacheSize, const CDBOptions& dbOptions)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    options.block_cache = leveldb::NewLRUCache(nCacheSize * dbOptions.nBlockCachePercent / 100);
+    options.write_buffer_size = nCacheSize * dbOptions.nWriteBufferPercent / 100; // up to two write buffers may be held in memory simultaneously
+    options.filter_policy = dbOptions.nBloomBits ? leveldb::NewBloomFilterPolicy(dbOptions.nBloomBits) : nullptr;
     options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    options.max_open_files = dbOptions.nMaxOpenFiles;
+    options.block_size = dbOptions.nBlockSize;
+    options.max_file_size = dbOptions.nMaxFileSize;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -90,14 +152,14 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const CDBOptions& dbOptions)
 {
     penv = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, dbOptions);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
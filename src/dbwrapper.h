@@ -19,6 +19,38 @@
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 
+/**
+ * LevelDB tuning of a single database. The cache size a CDBWrapper is given
+ * is shared between the block cache and the write buffers by percentage.
+ */
+struct CDBOptions
+{
+    //! Percentage of the cache size used for the block cache
+    int nBlockCachePercent;
+    //! Percentage of the cache size used for each of the (up to two) write buffers
+    int nWriteBufferPercent;
+    //! Bloom filter bits per key, 0 for no filters
+    int nBloomBits;
+    //! Open table files to keep, each with its index and filter in memory
+    int nMaxOpenFiles;
+    //! Size of the blocks LevelDB reads and caches
+    size_t nBlockSize;
+    //! Size at which LevelDB starts a new table file
+    size_t nMaxFileSize;
+
+    CDBOptions() : nBlockCachePercent(50), nWriteBufferPercent(25), nBloomBits(10), nMaxOpenFiles(64), nBlockSize(4096), nMaxFileSize(2 << 20) {}
+
+    std::string ToString() const;
+};
+
+/**
+ * Parse database options: a profile ("default" or "lowmem") and/or comma
+ * separated overrides, as in "lowmem,maxopenfiles=200". Overrides are
+ * blockcache and writebuffer (percent), bloombits, maxopenfiles, blocksize
+ * and maxfilesize (bytes). Returns false with strError set if invalid.
+ */
+bool ParseDBOptions(const std::string& strOptions, CDBOptions& dbOptions, std::string& strError);
+
 class dbwrapper_error : public std::runtime_error
 {
 public:
@@ -41,6 +73,22 @@ void HandleError(const leveldb::Status& status);
  */
 const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
+/** Deobfuscate strValue in place and deserialize it into value, without
+ * copying it into a CDataStream first.
+ */
+template <typename V>
+bool DeserializeValue(const CDBWrapper &w, std::string& strValue, V& value)
+{
+    const std::vector<unsigned char>& key = GetObfuscateKey(w);
+    XorObfuscate((unsigned char*)&strValue[0], strValue.size(), key.data(), key.size());
+    try {
+        CBufferReader(SER_DISK, CLIENT_VERSION, strValue.data(), strValue.data() + strValue.size()) >> value;
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
 };
 
 /** Batch of changes queued to be written to a CDBWrapper */
@@ -119,6 +167,8 @@ class CDBIterator
 private:
     const CDBWrapper &parent;
     leveldb::Iterator *piter;
+    //! Copy of the current value, reused for every value the iterator reads
+    std::string strValue;
 
 public:
 
@@ -157,14 +207,8 @@ public:
 
     template<typename V> bool GetValue(V& value) {
         leveldb::Slice slValue = piter->value();
-        try {
-            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
-            ssValue >> value;
-        } catch (const std::exception&) {
-            return false;
-        }
-        return true;
+        strValue.assign(slValue.data(), slValue.size());
+        return dbwrapper_private::DeserializeValue(parent, strValue, value);
     }
 
     unsigned int GetValueSize() {
@@ -217,8 +261,9 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] dbOptions   LevelDB tuning for this database.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const CDBOptions& dbOptions = CDBOptions());
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -229,6 +274,8 @@ public:
         ssKey << key;
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
+        // LevelDB copies the value out of its cache; deobfuscate and
+        // deserialize that copy in place rather than copying it again.
         std::string strValue;
         leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
         if (!status.ok()) {
@@ -237,14 +284,7 @@ public:
             LogPrintf("LevelDB read failure: %s\n", status.ToString());
             dbwrapper_private::HandleError(status);
         }
-        try {
-            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(obfuscate_key);
-            ssValue >> value;
-        } catch (const std::exception&) {
-            return false;
-        }
-        return true;
+        return dbwrapper_private::DeserializeValue(*this, strValue, value);
     }
 
     template <typename K, typename V>
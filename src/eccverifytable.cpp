@@ -0,0 +1,135 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "eccverifytable.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "pubkey.h"
+#include "tinyformat.h"
+#include "util.h"
+
+#include <string.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+/**
+ * File layout: an ECC_TABLE_HEADER_SIZE byte header holding the magic, the
+ * format version, the table size and the SHA256 of the table, followed by
+ * the table itself as exported by libsecp256k1.
+ */
+const unsigned char ECC_TABLE_MAGIC[8] = {'b', 'l', 'e', 'e', 'c', 'm', 't', 0};
+const uint32_t ECC_TABLE_VERSION = 1;
+const size_t ECC_TABLE_HEADER_SIZE = 64;
+
+#ifndef WIN32
+void* g_ecc_table_map = nullptr;
+size_t g_ecc_table_map_size = 0;
+#endif
+} // namespace
+
+#ifndef WIN32
+static bool MapVerifyTable(const fs::path& path)
+{
+    const size_t nTableSize = ECC_VerifyTableSize();
+    const size_t nFileSize = ECC_TABLE_HEADER_SIZE + nTableSize;
+
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != nFileSize) {
+        close(fd);
+        return false;
+    }
+    void* map = mmap(nullptr, nFileSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    // A damaged table would make valid signatures fail (or worse), so check
+    // it before use. This only reads the shared pages.
+    const unsigned char* header = (const unsigned char*)map;
+    const unsigned char* table = header + ECC_TABLE_HEADER_SIZE;
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(table, nTableSize).Finalize(hash);
+    if (memcmp(header, ECC_TABLE_MAGIC, sizeof(ECC_TABLE_MAGIC)) != 0 ||
+        ReadLE32(header + 8) != ECC_TABLE_VERSION ||
+        ReadLE64(header + 16) != nTableSize ||
+        memcmp(header + 24, hash, sizeof(hash)) != 0) {
+        munmap(map, nFileSize);
+        return false;
+    }
+
+    ECC_SetVerifyTable(table, nTableSize);
+    g_ecc_table_map = map;
+    g_ecc_table_map_size = nFileSize;
+    return true;
+}
+
+static bool WriteVerifyTable(const fs::path& path)
+{
+    std::vector<unsigned char> table;
+    {
+        ECCVerifyHandle handle;
+        if (!ECC_ExportVerifyTable(table))
+            return false;
+    }
+    unsigned char header[ECC_TABLE_HEADER_SIZE] = {};
+    memcpy(header, ECC_TABLE_MAGIC, sizeof(ECC_TABLE_MAGIC));
+    WriteLE32(header + 8, ECC_TABLE_VERSION);
+    WriteLE64(header + 16, table.size());
+    CSHA256().Write(table.data(), table.size()).Finalize(header + 24);
+
+    // Write under a process specific name so concurrent starts cannot mix their writes.
+    fs::path pathTmp = path;
+    pathTmp += strprintf(".%d.tmp", getpid());
+    FILE* file = fsbridge::fopen(pathTmp, "wb");
+    if (!file)
+        return false;
+    bool fOk = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+               fwrite(table.data(), 1, table.size(), file) == table.size();
+    if (fOk)
+        FileCommit(file);
+    fclose(file);
+    if (!fOk || !RenameOver(pathTmp, path)) {
+        fs::remove(pathTmp);
+        return false;
+    }
+    return true;
+}
+#endif
+
+bool ECC_MapVerifyTable(const fs::path& path)
+{
+#ifdef WIN32
+    return false;
+#else
+    if (MapVerifyTable(path))
+        return true;
+    LogPrintf("Writing signature verification tables to %s\n", path.string());
+    if (WriteVerifyTable(path) && MapVerifyTable(path))
+        return true;
+    LogPrintf("Could not map signature verification tables from %s, computing them in memory\n", path.string());
+    return false;
+#endif
+}
+
+void ECC_UnmapVerifyTable()
+{
+#ifndef WIN32
+    if (g_ecc_table_map == nullptr)
+        return;
+    ECC_SetVerifyTable(nullptr, 0);
+    munmap(g_ecc_table_map, g_ecc_table_map_size);
+    g_ecc_table_map = nullptr;
+    g_ecc_table_map_size = 0;
+#endif
+}
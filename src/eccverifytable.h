@@ -0,0 +1,27 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ECCVERIFYTABLE_H
+#define BITCOIN_ECCVERIFYTABLE_H
+
+#include "fs.h"
+
+/** Default for -ecctable */
+static const bool DEFAULT_ECC_TABLE = true;
+/** Name of the verification table file in the data directory */
+static const char* const ECC_TABLE_FILENAME = "ecctable.dat";
+
+/**
+ * Map the secp256k1 signature verification tables read-only from path, so
+ * that processes sharing the file share its pages instead of each computing
+ * a private copy. A missing, stale or damaged file is (re)written first.
+ * Must be called before the first ECCVerifyHandle is created. Returns false
+ * if verification will compute its tables in memory as usual.
+ */
+bool ECC_MapVerifyTable(const fs::path& path);
+
+/** Release the mapping. No ECCVerifyHandle may exist anymore. */
+void ECC_UnmapVerifyTable();
+
+#endif // BITCOIN_ECCVERIFYTABLE_H
@@ -0,0 +1,358 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_FLATMAP_H
+#define BITCOIN_FLATMAP_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Hash map for many small entries, laid out for few cache misses per lookup.
+ *
+ * Entries are stored inline in large chunks instead of in separately
+ * allocated nodes. They are found through an open addressed index (linear
+ * probing) of which every slot holds the entry's number and 32 bits of its
+ * hash, eight slots to a cache line. A lookup walks a few adjacent slots and
+ * then compares the key of, almost always, only the entry it is looking for,
+ * where a std::unordered_map walks a chain of pointers to nodes that are
+ * scattered over the heap. Erased entries are reused by later insertions.
+ *
+ * It provides the part of the std::unordered_map interface that is used on
+ * it. Entries never move, so references stay valid until their entry is
+ * erased. Iterators also stay valid when other entries are inserted or
+ * erased. Memory is only released by clear() or destruction.
+ */
+template <typename K, typename T, typename Hash = std::hash<K>, typename Pred = std::equal_to<K> >
+class flatmap
+{
+public:
+    typedef K key_type;
+    typedef T mapped_type;
+    typedef std::pair<const K, T> value_type;
+    typedef size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef Hash hasher;
+    typedef Pred key_equal;
+
+    //! Number of entries allocated at once.
+    static const size_type ENTRIES_PER_CHUNK = 1024;
+
+private:
+    static const uint32_t ENTRY_NONE = 0xFFFFFFFF;
+    static const uint32_t ENTRY_DELETED = 0xFFFFFFFE;
+    static const size_type MIN_BUCKETS = 16;
+
+    //! A slot of the index, referring to an entry by its number.
+    struct Bucket {
+        uint32_t hash;
+        uint32_t entry;
+    };
+
+    struct Chunk {
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type entries[ENTRIES_PER_CHUNK];
+        //! Hash of each entry; for a free entry, the number of the next free one.
+        uint32_t hashes[ENTRIES_PER_CHUNK];
+        bool used[ENTRIES_PER_CHUNK];
+    };
+
+    std::vector<Chunk*> vChunks;
+    std::vector<Bucket> vBuckets;
+    //! Entries below this number have been handed out at some point.
+    uint32_t nEntriesTouched;
+    //! First entry on the list of erased entries.
+    uint32_t nFirstFree;
+    size_type nSize;
+    size_type nDeleted;
+    Hash hashFunction;
+    Pred keyEqual;
+
+    value_type* Entry(uint32_t entry) const { return reinterpret_cast<value_type*>(&vChunks[entry / ENTRIES_PER_CHUNK]->entries[entry % ENTRIES_PER_CHUNK]); }
+    uint32_t& EntryHash(uint32_t entry) const { return vChunks[entry / ENTRIES_PER_CHUNK]->hashes[entry % ENTRIES_PER_CHUNK]; }
+    bool& EntryUsed(uint32_t entry) const { return vChunks[entry / ENTRIES_PER_CHUNK]->used[entry % ENTRIES_PER_CHUNK]; }
+
+    //! Return the slot referring to an entry with this key, or vBuckets.size().
+    size_type FindBucket(const K& key, uint32_t hash) const
+    {
+        if (nSize == 0) return vBuckets.size();
+        const size_type mask = vBuckets.size() - 1;
+        for (size_type pos = hash & mask; vBuckets[pos].entry != ENTRY_NONE; pos = (pos + 1) & mask) {
+            const Bucket& bucket = vBuckets[pos];
+            if (bucket.hash == hash && bucket.entry != ENTRY_DELETED && keyEqual(Entry(bucket.entry)->first, key)) {
+                return pos;
+            }
+        }
+        return vBuckets.size();
+    }
+
+    void Rehash(size_type nBuckets)
+    {
+        std::vector<Bucket> vOld(nBuckets, Bucket{0, ENTRY_NONE});
+        vOld.swap(vBuckets);
+        const size_type mask = nBuckets - 1;
+        for (const Bucket& bucket : vOld) {
+            if (bucket.entry >= ENTRY_DELETED) continue;
+            size_type pos = bucket.hash & mask;
+            while (vBuckets[pos].entry != ENTRY_NONE) pos = (pos + 1) & mask;
+            vBuckets[pos] = bucket;
+        }
+        nDeleted = 0;
+    }
+
+    //! Store a new entry, which must not exist yet, and return its number.
+    template <typename... Args>
+    uint32_t Insert(uint32_t hash, Args&&... args)
+    {
+        if ((nSize + nDeleted + 1) * 4 > vBuckets.size() * 3) {
+            // If erased slots take up much of the index, clean them up
+            // instead of growing.
+            if (nSize + 1 <= vBuckets.size() / 2) {
+                Rehash(vBuckets.size());
+            } else {
+                Rehash(vBuckets.empty() ? MIN_BUCKETS : vBuckets.size() * 2);
+            }
+        }
+        uint32_t entry = nFirstFree;
+        if (entry != ENTRY_NONE) {
+            nFirstFree = EntryHash(entry);
+        } else {
+            assert(nEntriesTouched < ENTRY_DELETED);
+            if (nEntriesTouched == vChunks.size() * ENTRIES_PER_CHUNK) {
+                Chunk* chunk = new Chunk;
+                memset(chunk->used, 0, sizeof(chunk->used));
+                vChunks.push_back(chunk);
+            }
+            entry = nEntriesTouched++;
+        }
+        new (Entry(entry)) value_type(std::forward<Args>(args)...);
+        EntryHash(entry) = hash;
+        EntryUsed(entry) = true;
+
+        const size_type mask = vBuckets.size() - 1;
+        size_type pos = hash & mask;
+        while (vBuckets[pos].entry < ENTRY_DELETED) pos = (pos + 1) & mask;
+        if (vBuckets[pos].entry == ENTRY_DELETED) nDeleted--;
+        vBuckets[pos] = Bucket{hash, entry};
+        nSize++;
+        return entry;
+    }
+
+    void Erase(uint32_t entry)
+    {
+        const uint32_t hash = EntryHash(entry);
+        const size_type mask = vBuckets.size() - 1;
+        size_type pos = hash & mask;
+        while (vBuckets[pos].entry != entry) pos = (pos + 1) & mask;
+        // A slot followed by an empty one does not continue any probe sequence.
+        if (vBuckets[(pos + 1) & mask].entry == ENTRY_NONE) {
+            vBuckets[pos].entry = ENTRY_NONE;
+        } else {
+            vBuckets[pos].entry = ENTRY_DELETED;
+            nDeleted++;
+        }
+        Entry(entry)->~value_type();
+        EntryUsed(entry) = false;
+        EntryHash(entry) = nFirstFree;
+        nFirstFree = entry;
+        nSize--;
+    }
+
+    template <typename V>
+    class basic_iterator
+    {
+        friend class flatmap;
+        template <typename> friend class basic_iterator;
+
+        const flatmap* map;
+        uint32_t entry;
+
+        basic_iterator(const flatmap* mapIn, uint32_t entryIn) : map(mapIn), entry(entryIn) {}
+        void SkipUnused()
+        {
+            while (entry < map->nEntriesTouched && !map->EntryUsed(entry)) entry++;
+            if (entry >= map->nEntriesTouched) entry = ENTRY_NONE;
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef V value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef V* pointer;
+        typedef V& reference;
+
+        basic_iterator() : map(nullptr), entry(ENTRY_NONE) {}
+        template <typename W, typename = typename std::enable_if<std::is_convertible<W*, V*>::value>::type>
+        basic_iterator(const basic_iterator<W>& other) : map(other.map), entry(other.entry) {}
+
+        V& operator*() const { return *map->Entry(entry); }
+        V* operator->() const { return map->Entry(entry); }
+        basic_iterator& operator++() { entry++; SkipUnused(); return *this; }
+        basic_iterator operator++(int) { basic_iterator copy(*this); ++(*this); return copy; }
+        template <typename W>
+        bool operator==(const basic_iterator<W>& other) const { return entry == other.entry; }
+        template <typename W>
+        bool operator!=(const basic_iterator<W>& other) const { return entry != other.entry; }
+    };
+
+public:
+    typedef basic_iterator<value_type> iterator;
+    typedef basic_iterator<const value_type> const_iterator;
+
+    explicit flatmap(size_type n = 0, const Hash& hashIn = Hash(), const Pred& eqIn = Pred())
+        : nEntriesTouched(0), nFirstFree(ENTRY_NONE), nSize(0), nDeleted(0), hashFunction(hashIn), keyEqual(eqIn)
+    {
+        reserve(n);
+    }
+
+    flatmap(flatmap&& other) : flatmap(0, other.hashFunction, other.keyEqual)
+    {
+        swap(other);
+    }
+
+    flatmap& operator=(flatmap&& other)
+    {
+        clear();
+        swap(other);
+        return *this;
+    }
+
+    flatmap(const flatmap&) = delete;
+    flatmap& operator=(const flatmap&) = delete;
+
+    ~flatmap() { clear(); }
+
+    void swap(flatmap& other)
+    {
+        vChunks.swap(other.vChunks);
+        vBuckets.swap(other.vBuckets);
+        std::swap(nEntriesTouched, other.nEntriesTouched);
+        std::swap(nFirstFree, other.nFirstFree);
+        std::swap(nSize, other.nSize);
+        std::swap(nDeleted, other.nDeleted);
+        std::swap(hashFunction, other.hashFunction);
+        std::swap(keyEqual, other.keyEqual);
+    }
+
+    iterator begin() { iterator it(this, 0); it.SkipUnused(); return it; }
+    const_iterator begin() const { const_iterator it(this, 0); it.SkipUnused(); return it; }
+    iterator end() { return iterator(this, ENTRY_NONE); }
+    const_iterator end() const { return const_iterator(this, ENTRY_NONE); }
+
+    bool empty() const { return nSize == 0; }
+    size_type size() const { return nSize; }
+    size_type bucket_count() const { return vBuckets.size(); }
+    size_type chunk_count() const { return vChunks.size(); }
+    hasher hash_function() const { return hashFunction; }
+    key_equal key_eq() const { return keyEqual; }
+
+    //! Make room in the index for n entries.
+    void reserve(size_type n)
+    {
+        size_type nBuckets = MIN_BUCKETS;
+        while (nBuckets * 3 < n * 4) nBuckets *= 2;
+        if (nBuckets > vBuckets.size()) Rehash(nBuckets);
+    }
+
+    //! Erase all entries and release all memory.
+    void clear()
+    {
+        for (uint32_t entry = 0; entry < nEntriesTouched; entry++) {
+            if (EntryUsed(entry)) Entry(entry)->~value_type();
+        }
+        for (Chunk* chunk : vChunks) {
+            delete chunk;
+        }
+        std::vector<Chunk*>().swap(vChunks);
+        std::vector<Bucket>().swap(vBuckets);
+        nEntriesTouched = 0;
+        nFirstFree = ENTRY_NONE;
+        nSize = 0;
+        nDeleted = 0;
+    }
+
+    iterator find(const K& key)
+    {
+        size_type pos = FindBucket(key, hashFunction(key));
+        return pos == vBuckets.size() ? end() : iterator(this, vBuckets[pos].entry);
+    }
+
+    const_iterator find(const K& key) const
+    {
+        size_type pos = FindBucket(key, hashFunction(key));
+        return pos == vBuckets.size() ? end() : const_iterator(this, vBuckets[pos].entry);
+    }
+
+    size_type count(const K& key) const { return find(key) == end() ? 0 : 1; }
+
+    T& at(const K& key)
+    {
+        iterator it = find(key);
+        if (it == end()) throw std::out_of_range("flatmap::at");
+        return it->second;
+    }
+
+    const T& at(const K& key) const
+    {
+        const_iterator it = find(key);
+        if (it == end()) throw std::out_of_range("flatmap::at");
+        return it->second;
+    }
+
+    T& operator[](const K& key)
+    {
+        const uint32_t hash = hashFunction(key);
+        size_type pos = FindBucket(key, hash);
+        if (pos != vBuckets.size()) return Entry(vBuckets[pos].entry)->second;
+        return Entry(Insert(hash, std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>()))->second;
+    }
+
+    template <typename V>
+    std::pair<iterator, bool> emplace(const K& key, V&& value)
+    {
+        const uint32_t hash = hashFunction(key);
+        size_type pos = FindBucket(key, hash);
+        if (pos != vBuckets.size()) return std::make_pair(iterator(this, vBuckets[pos].entry), false);
+        return std::make_pair(iterator(this, Insert(hash, key, std::forward<V>(value))), true);
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(std::piecewise_construct_t, std::tuple<const K&> key, std::tuple<Args...> args)
+    {
+        const uint32_t hash = hashFunction(std::get<0>(key));
+        size_type pos = FindBucket(std::get<0>(key), hash);
+        if (pos != vBuckets.size()) return std::make_pair(iterator(this, vBuckets[pos].entry), false);
+        return std::make_pair(iterator(this, Insert(hash, std::piecewise_construct, key, std::move(args))), true);
+    }
+
+    /**
+     * Unlike std::unordered_map::erase, this does not return the next
+     * iterator, as finding it may mean skipping over many erased entries.
+     * Use erase(it++) to erase while iterating.
+     */
+    void erase(const_iterator it) { Erase(it.entry); }
+
+    size_type erase(const K& key)
+    {
+        iterator it = find(key);
+        if (it == end()) return 0;
+        Erase(it.entry);
+        return 1;
+    }
+
+    //! Bytes allocated per chunk of entries, and per slot of the index.
+    static constexpr size_t ChunkBytes() { return sizeof(Chunk); }
+    static constexpr size_t BucketBytes() { return sizeof(Bucket); }
+};
+
+#endif // BITCOIN_FLATMAP_H
@@ -126,6 +126,26 @@ inline uint160 Hash160(const prevector<N, unsigned char>& vch)
     return Hash160(vch.begin(), vch.end());
 }
 
+/** Compute the 160-bit hashes of a batch of objects (e.g. serialized public keys).
+ *  The RIPEMD-160 step is shared across SIMD lanes, see RIPEMD160_32. */
+template<typename T>
+inline std::vector<uint160> Hash160Batch(const std::vector<T>& vobj)
+{
+    alignas(16) static const unsigned char pblank[1] = {};
+    std::vector<uint160> result(vobj.size());
+    if (vobj.empty()) {
+        return result;
+    }
+    std::vector<unsigned char> sha(vobj.size() * CSHA256::OUTPUT_SIZE);
+    for (size_t i = 0; i < vobj.size(); i++) {
+        const T& obj = vobj[i];
+        CSHA256().Write(obj.size() == 0 ? pblank : (const unsigned char*)&obj[0], obj.size())
+                 .Finalize(&sha[i * CSHA256::OUTPUT_SIZE]);
+    }
+    RIPEMD160_32(result[0].begin(), sha.data(), vobj.size());
+    return result;
+}
+
 /** A writer stream (for serialization) that computes a 256-bit hash. */
 class CHashWriter
 {
@@ -0,0 +1,230 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/addressindex.h"
+
+#include "chain.h"
+#include "coins.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "undo.h"
+#include "util.h"
+#include "validation.h"
+
+#include <algorithm>
+
+static const char DB_ADDRESS_OUTPUT = 'a';
+/** Number of rows a history lookup reads between looks at the active chain */
+static const size_t ADDRESS_HISTORY_READ_BATCH = 1000;
+
+std::unique_ptr<AddressIndex> g_addressindex;
+
+namespace {
+
+/**
+ * Key of an output in the database. The numbers are big endian, so that the
+ * outputs to a script are in order of height.
+ */
+struct AddressOutputKey
+{
+    uint256 hashScript;
+    uint32_t nHeight;
+    uint256 txid;
+    uint32_t nOut;
+
+    AddressOutputKey() : nHeight(0), nOut(0) {}
+    AddressOutputKey(const uint256& hashScriptIn, uint32_t nHeightIn, const uint256& txidIn, uint32_t nOutIn) :
+        hashScript(hashScriptIn), nHeight(nHeightIn), txid(txidIn), nOut(nOutIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        unsigned char buf[4];
+        s << DB_ADDRESS_OUTPUT << hashScript;
+        WriteBE32(buf, nHeight);
+        s.write((const char*)buf, sizeof(buf));
+        s << txid;
+        WriteBE32(buf, nOut);
+        s.write((const char*)buf, sizeof(buf));
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        unsigned char buf[4];
+        char key;
+        s >> key;
+        if (key != DB_ADDRESS_OUTPUT)
+            throw std::ios_base::failure("not an address index output");
+        s >> hashScript;
+        s.read((char*)buf, sizeof(buf));
+        nHeight = ReadBE32(buf);
+        s >> txid;
+        s.read((char*)buf, sizeof(buf));
+        nOut = ReadBE32(buf);
+    }
+};
+
+/** Value of an output in the database, the block of the input spending it is null while it is unspent */
+struct AddressOutputValue
+{
+    CAmount nValue;
+    uint256 hashBlock;
+    uint256 spentTxid;
+    uint32_t nSpentIn;
+    uint32_t nSpentHeight;
+    uint256 hashSpentBlock;
+
+    AddressOutputValue() : nValue(0), nSpentIn(0), nSpentHeight(0) {}
+    AddressOutputValue(CAmount nValueIn, const uint256& hashBlockIn) :
+        nValue(nValueIn), hashBlock(hashBlockIn), nSpentIn(0), nSpentHeight(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nValue);
+        READWRITE(hashBlock);
+        READWRITE(spentTxid);
+        READWRITE(VARINT(nSpentIn));
+        READWRITE(VARINT(nSpentHeight));
+        READWRITE(hashSpentBlock);
+    }
+};
+
+uint256 ScriptHash(const CScript& script)
+{
+    uint256 hash;
+    CSHA256().Write(script.data(), script.size()).Finalize(hash.begin());
+    return hash;
+}
+
+//! Whether the block of the hash is the one at that height of the active chain. Requires cs_main.
+bool IsActiveBlock(uint32_t nHeight, const uint256& hashBlock)
+{
+    AssertLockHeld(cs_main);
+    const CBlockIndex* pindex = chainActive[nHeight];
+    return pindex && pindex->GetBlockHash() == hashBlock;
+}
+
+} // namespace
+
+AddressIndex::AddressIndex(size_t nCacheSize, bool fMemory, bool fWipe) :
+    db(new DB(GetDataDir() / "indexes" / "addressindex", nCacheSize, fMemory, fWipe))
+{
+}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex, CDBBatch& batch)
+{
+    // The scripts and heights of the spent outputs are in the undo data. The
+    // genesis block spends nothing and has none.
+    CBlockUndo blockUndo;
+    if (pindex->pprev) {
+        if (!UndoReadFromDisk(blockUndo, pindex->GetUndoPos(), pindex->pprev->GetBlockHash()))
+            return error("%s: failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+        if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
+            return error("%s: undo data of block %s does not match it", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    const uint256 hashBlock = pindex->GetBlockHash();
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256 txid = tx.GetHash();
+
+        // Outputs spent in this block are written after they are created,
+        // so the entry with the spend is the one that stays.
+        if (i > 0) {
+            const CTxUndo& txUndo = blockUndo.vtxundo[i - 1];
+            if (txUndo.vprevout.size() != tx.vin.size())
+                return error("%s: undo data of block %s does not match it", __func__, hashBlock.ToString());
+            for (uint32_t j = 0; j < tx.vin.size(); j++) {
+                const Coin& prevout = txUndo.vprevout[j];
+                const COutPoint& outpoint = tx.vin[j].prevout;
+                AddressOutputValue value(prevout.out.nValue, pindex->GetAncestor(prevout.nHeight)->GetBlockHash());
+                value.spentTxid = txid;
+                value.nSpentIn = j;
+                value.nSpentHeight = pindex->nHeight;
+                value.hashSpentBlock = hashBlock;
+                batch.Write(AddressOutputKey(ScriptHash(prevout.out.scriptPubKey), prevout.nHeight, outpoint.hash, outpoint.n), value);
+            }
+        }
+
+        for (uint32_t n = 0; n < tx.vout.size(); n++) {
+            const CTxOut& txout = tx.vout[n];
+            if (txout.scriptPubKey.IsUnspendable())
+                continue;
+            batch.Write(AddressOutputKey(ScriptHash(txout.scriptPubKey), pindex->nHeight, txid, n), AddressOutputValue(txout.nValue, hashBlock));
+        }
+    }
+    return true;
+}
+
+bool AddressIndex::FindScriptHistory(const CScript& script, int nStartHeight, int nEndHeight, size_t nSkip, size_t nCount,
+                                     std::vector<CAddressHistoryEntry>& entries, bool& fMore) const
+{
+    entries.clear();
+    fMore = false;
+    if (nStartHeight < 0 || nStartHeight > nEndHeight)
+        return true;
+
+    const uint256 hashScript = ScriptHash(script);
+    std::unique_ptr<CDBIterator> pcursor(db->NewIterator());
+    pcursor->Seek(AddressOutputKey(hashScript, nStartHeight, uint256(), 0));
+    // Rows are read in batches, and the ones of blocks that are not in the
+    // active chain are left out with cs_main taken once per batch.
+    std::vector<std::pair<AddressOutputKey, AddressOutputValue>> rows;
+    bool fDone = false;
+    while (!fDone) {
+        rows.clear();
+        for (; rows.size() < ADDRESS_HISTORY_READ_BATCH; pcursor->Next()) {
+            AddressOutputKey key;
+            if (!pcursor->Valid() || !pcursor->GetKey(key) || key.hashScript != hashScript || key.nHeight > (uint32_t)nEndHeight) {
+                fDone = true;
+                break;
+            }
+            AddressOutputValue value;
+            if (!pcursor->GetValue(value))
+                return error("%s: failed to read output %s:%u", __func__, key.txid.ToString(), key.nOut);
+            rows.emplace_back(key, value);
+        }
+
+        {
+            LOCK(cs_main);
+            rows.erase(std::remove_if(rows.begin(), rows.end(), [](const std::pair<AddressOutputKey, AddressOutputValue>& row) {
+                return !IsActiveBlock(row.first.nHeight, row.second.hashBlock);
+            }), rows.end());
+            for (auto& row : rows) {
+                if (!row.second.spentTxid.IsNull() && !IsActiveBlock(row.second.nSpentHeight, row.second.hashSpentBlock))
+                    row.second.spentTxid.SetNull();
+            }
+        }
+
+        for (const auto& row : rows) {
+            if (nSkip > 0) {
+                nSkip--;
+                continue;
+            }
+            if (entries.size() == nCount) {
+                fMore = true;
+                return true;
+            }
+
+            entries.emplace_back();
+            CAddressHistoryEntry& entry = entries.back();
+            entry.nHeight = row.first.nHeight;
+            entry.hashBlock = row.second.hashBlock;
+            entry.txid = row.first.txid;
+            entry.nOut = row.first.nOut;
+            entry.nValue = row.second.nValue;
+            if (!row.second.spentTxid.IsNull()) {
+                entry.spentTxid = row.second.spentTxid;
+                entry.nSpentIn = row.second.nSpentIn;
+                entry.nSpentHeight = row.second.nSpentHeight;
+                entry.hashSpentBlock = row.second.hashSpentBlock;
+            }
+        }
+    }
+    return true;
+}
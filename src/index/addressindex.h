@@ -0,0 +1,77 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_ADDRESSINDEX_H
+#define BITCOIN_INDEX_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "index/base.h"
+#include "script/script.h"
+#include "uint256.h"
+
+#include <memory>
+#include <vector>
+
+/** Default for -addressindex */
+static const bool DEFAULT_ADDRESSINDEX = false;
+/** Maximum number of outputs a history query of the RPC and REST interfaces returns */
+static const size_t MAX_ADDRESS_HISTORY_RESULTS = 1000;
+
+/** An output to a script in the active chain, and the input that spends it, if any */
+struct CAddressHistoryEntry
+{
+    int nHeight;
+    uint256 hashBlock;
+    uint256 txid;
+    uint32_t nOut;
+    CAmount nValue;
+
+    //! Spending transaction, null if the output is unspent
+    uint256 spentTxid;
+    uint32_t nSpentIn;
+    int nSpentHeight;
+    uint256 hashSpentBlock;
+
+    CAddressHistoryEntry() : nHeight(0), nOut(0), nValue(0), nSpentIn(0), nSpentHeight(0) {}
+
+    bool IsSpent() const { return !spentTxid.IsNull(); }
+};
+
+/**
+ * Index of the outputs to each script in the active chain, enabled with
+ * -addressindex, in indexes/addressindex. Outputs are stored by the SHA256 of
+ * their script and the height of their block, so the history of a script
+ * over a range of heights is one range of the database, and the input that
+ * spends an output is recorded with it.
+ *
+ * Entries of blocks that were disconnected stay in the database, lookups
+ * leave out the outputs and spends of blocks that are not in the active chain.
+ */
+class AddressIndex final : public BaseIndex
+{
+private:
+    const std::unique_ptr<DB> db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, CDBBatch& batch) override;
+    DB& GetDB() const override { return *db; }
+    const char* GetName() const override { return "addressindex"; }
+
+public:
+    explicit AddressIndex(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    /**
+     * Look up the outputs to a script created from nStartHeight up to
+     * nEndHeight, in order of height, leaving out the first nSkip and
+     * returning at most nCount of them. fMore is set if there are more
+     * outputs in the range after the ones returned.
+     */
+    bool FindScriptHistory(const CScript& script, int nStartHeight, int nEndHeight, size_t nSkip, size_t nCount,
+                           std::vector<CAddressHistoryEntry>& entries, bool& fMore) const;
+};
+
+/** The address index, if -addressindex is set */
+extern std::unique_ptr<AddressIndex> g_addressindex;
+
+#endif // BITCOIN_INDEX_ADDRESSINDEX_H
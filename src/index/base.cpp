@@ -0,0 +1,262 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/base.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "tinyformat.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+static const char DB_BEST_BLOCK = 'B';
+
+/** Size of a batch after which an index writes it out */
+static const size_t INDEX_BATCH_SIZE = 16 << 20;
+/** Milliseconds after which an index catching up writes out its progress */
+static const int64_t INDEX_COMMIT_INTERVAL = 30000;
+
+BaseIndex::DB::DB(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe) :
+    CDBWrapper(path, nCacheSize, fMemory, fWipe)
+{
+}
+
+bool BaseIndex::DB::ReadBestBlock(uint256& hash) const
+{
+    return Read(DB_BEST_BLOCK, hash);
+}
+
+void BaseIndex::DB::WriteBestBlock(CDBBatch& batch, const uint256& hash)
+{
+    batch.Write(DB_BEST_BLOCK, hash);
+}
+
+BaseIndex::BaseIndex() : fSynced(false), pindexBest(nullptr)
+{
+}
+
+BaseIndex::~BaseIndex()
+{
+    assert(!threadSync.joinable());
+}
+
+const CBlockIndex* BaseIndex::NextSyncBlock(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (!pindex)
+        return chainActive.Genesis();
+    if (chainActive.Contains(pindex))
+        return chainActive.Next(pindex);
+    // The index is on a branch that was reorganized away, the blocks it has
+    // indexed past the fork stay in it.
+    const CBlockIndex* pindexFork = chainActive.FindFork(pindex);
+    return pindexFork ? chainActive.Next(pindexFork) : chainActive.Genesis();
+}
+
+bool BaseIndex::Commit(CDBBatch& batch, const CBlockIndex* pindex)
+{
+    if (pindex)
+        GetDB().WriteBestBlock(batch, pindex->GetBlockHash());
+    if (!GetDB().WriteBatch(batch))
+        return error("%s: failed to write %s", __func__, GetName());
+    batch.Clear();
+    BatchWritten();
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        pindexBest = pindex;
+    }
+    cond.notify_all();
+    return true;
+}
+
+void BaseIndex::ThreadSync()
+{
+    const int64_t nReadLimit = gArgs.GetArg("-indexreadlimit", DEFAULT_INDEX_READ_LIMIT) << 20;
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    CDBBatch batch(GetDB());
+    const CBlockIndex* pindex;
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        pindex = pindexBest;
+    }
+    int64_t nLastCommit = GetTimeMillis();
+    int64_t nLastLog = nLastCommit;
+    // The read limit is an average over the current catch-up, which starts
+    // again whenever the thread falls back from following BlockConnected.
+    bool fCatchingUp = false;
+    int64_t nReadStart = 0;
+    int64_t nBytesRead = 0;
+
+    try {
+        while (!interrupt) {
+            if (fSynced) {
+                fCatchingUp = false;
+                std::unique_lock<std::mutex> lock(cs);
+                cond.wait(lock, [this] { return !queue.empty() || !fSynced || interrupt; });
+                if (queue.empty())
+                    continue;
+                const auto entry = std::move(queue.front());
+                queue.pop_front();
+                const bool fLast = queue.empty();
+                lock.unlock();
+
+                if (!WriteBlock(*entry.first, entry.second, batch)) {
+                    error("%s: failed to index block %s", GetName(), entry.second->GetBlockHash().ToString());
+                    break;
+                }
+                pindex = entry.second;
+                // Queries wait for the tip to be written, so there is no
+                // waiting for more blocks to fill a batch.
+                if ((fLast || batch.SizeEstimate() > INDEX_BATCH_SIZE) && !Commit(batch, pindex))
+                    break;
+                continue;
+            }
+            if (!fCatchingUp) {
+                fCatchingUp = true;
+                nReadStart = GetTimeMicros();
+                nBytesRead = 0;
+            }
+
+            const CBlockIndex* pindexNext;
+            {
+                LOCK(cs_main);
+                pindexNext = NextSyncBlock(pindex);
+                if (!pindexNext) {
+                    // From here on BlockConnected, which is called under
+                    // cs_main, queues every block connected after pindex.
+                    fSynced = true;
+                    LogPrintf("%s is up to date at height %d\n", GetName(), pindex ? pindex->nHeight : -1);
+                }
+            }
+            if (!pindexNext) {
+                if (!Commit(batch, pindex))
+                    break;
+                continue;
+            }
+
+            // Blocks below a UTXO snapshot were never downloaded, the index
+            // cannot include them.
+            if (pindexNext->nStatus & BLOCK_HAVE_DATA) {
+                CBlock block;
+                if (!ReadBlockFromDisk(block, pindexNext, consensusParams)) {
+                    error("%s: failed to read block %s", GetName(), pindexNext->GetBlockHash().ToString());
+                    break;
+                }
+                if (!WriteBlock(block, pindexNext, batch)) {
+                    error("%s: failed to index block %s", GetName(), pindexNext->GetBlockHash().ToString());
+                    break;
+                }
+                nBytesRead += ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+            }
+            pindex = pindexNext;
+
+            const int64_t nNow = GetTimeMillis();
+            if (batch.SizeEstimate() > INDEX_BATCH_SIZE || nNow - nLastCommit > INDEX_COMMIT_INTERVAL) {
+                if (!Commit(batch, pindex))
+                    break;
+                nLastCommit = nNow;
+            }
+            if (nNow - nLastLog > INDEX_COMMIT_INTERVAL) {
+                LogPrintf("Syncing %s with block chain from height %d\n", GetName(), pindex->nHeight);
+                nLastLog = nNow;
+            }
+            if (nReadLimit > 0) {
+                // Sleep until the average read rate is back within the limit.
+                const int64_t nWait = nBytesRead * 1000000 / nReadLimit - (GetTimeMicros() - nReadStart);
+                if (nWait > 0)
+                    interrupt.sleep_for(std::chrono::milliseconds(nWait / 1000));
+            }
+        }
+        if (interrupt)
+            Commit(batch, pindex);
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s: %s\n", __func__, GetName(), e.what());
+    }
+
+    // Nothing waits for an index that is no longer built.
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fSynced = false;
+        queue.clear();
+    }
+    cond.notify_all();
+}
+
+void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex, const std::vector<CTransactionRef>& txnConflicted)
+{
+    if (!fSynced)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (queue.size() >= MAX_INDEX_QUEUE_BLOCKS) {
+            // Rather than holding more blocks in memory, let the thread read
+            // them from disk once it gets to them.
+            queue.clear();
+            fSynced = false;
+        } else {
+            queue.emplace_back(block, pindex);
+        }
+    }
+    cond.notify_all();
+}
+
+bool BaseIndex::BlockUntilSyncedToCurrentChain()
+{
+    if (!fSynced)
+        return false;
+    const CBlockIndex* pindexTip;
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+    }
+    if (!pindexTip)
+        return true;
+    std::unique_lock<std::mutex> lock(cs);
+    cond.wait(lock, [&] {
+        return !fSynced || (pindexBest && pindexBest->GetAncestor(pindexTip->nHeight) == pindexTip);
+    });
+    return fSynced;
+}
+
+void BaseIndex::Start()
+{
+    uint256 hashBest;
+    if (GetDB().ReadBestBlock(hashBest)) {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hashBest);
+        if (it != mapBlockIndex.end()) {
+            pindexBest = it->second;
+        } else {
+            LogPrintf("%s: best block %s of %s is unknown, building it from the genesis block\n", __func__, hashBest.ToString(), GetName());
+        }
+    }
+
+    interrupt.reset();
+    RegisterValidationInterface(this);
+    threadSync = std::thread([this] {
+        RenameThread(strprintf("bitcoin-%s", GetName()).c_str());
+        ThreadSync();
+    });
+}
+
+void BaseIndex::Interrupt()
+{
+    interrupt();
+    {
+        // Wake the thread with the lock taken, so it cannot miss the interrupt
+        // between checking for it and waiting.
+        std::lock_guard<std::mutex> lock(cs);
+    }
+    cond.notify_all();
+}
+
+void BaseIndex::Stop()
+{
+    if (!threadSync.joinable())
+        return;
+    UnregisterValidationInterface(this);
+    Interrupt();
+    threadSync.join();
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BASE_H
+#define BITCOIN_INDEX_BASE_H
+
+#include "dbwrapper.h"
+#include "primitives/block.h"
+#include "threadinterrupt.h"
+#include "uint256.h"
+#include "validationinterface.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+class CBlockIndex;
+
+/** Default for -indexreadlimit, in MiB per second, 0 for no limit */
+static const int64_t DEFAULT_INDEX_READ_LIMIT = 0;
+/** Blocks from BlockConnected an index keeps before it falls back to reading them from disk */
+static const size_t MAX_INDEX_QUEUE_BLOCKS = 100;
+
+/**
+ * Base of an optional index of the active chain, in its own database, that
+ * is built and kept up to date by a background thread.
+ *
+ * The thread first catches up from the blocks on disk, committing its
+ * progress as it goes so that it resumes where it stopped after a restart.
+ * Once it reaches the tip, blocks are handed to it by BlockConnected, which
+ * only queues them, so the index adds nothing to the time it takes to
+ * connect a block. If it falls too far behind, it goes back to reading
+ * blocks from disk.
+ */
+class BaseIndex : public CValidationInterface
+{
+protected:
+    /** The database of an index, which also records up to which block it is built. */
+    class DB : public CDBWrapper
+    {
+    public:
+        DB(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+        //! Read the last block the index includes. Returns false if there is none.
+        bool ReadBestBlock(uint256& hash) const;
+        //! Record the last block the index includes, in the batch that adds it.
+        void WriteBestBlock(CDBBatch& batch, const uint256& hash);
+    };
+
+private:
+    //! Whether the index is up to date and follows BlockConnected, set under cs_main
+    std::atomic<bool> fSynced;
+
+    std::mutex cs;
+    std::condition_variable cond;
+    //! Last block that is written to the database
+    const CBlockIndex* pindexBest;
+    //! Blocks from BlockConnected yet to be indexed
+    std::deque<std::pair<std::shared_ptr<const CBlock>, const CBlockIndex*>> queue;
+
+    std::thread threadSync;
+    CThreadInterrupt interrupt;
+
+    //! Next block to index after pindex to get to the active chain, or nullptr at the tip. Requires cs_main.
+    static const CBlockIndex* NextSyncBlock(const CBlockIndex* pindex);
+    //! Write the batch with what is indexed up to pindex.
+    bool Commit(CDBBatch& batch, const CBlockIndex* pindex);
+    void ThreadSync();
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex, const std::vector<CTransactionRef>& txnConflicted) override;
+
+    //! Add the entries of a block to the batch.
+    virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, CDBBatch& batch) = 0;
+    //! Called once what WriteBlock added to a batch is written to the database.
+    virtual void BatchWritten() {}
+    virtual DB& GetDB() const = 0;
+    //! Name of the index, for the log and the thread.
+    virtual const char* GetName() const = 0;
+
+public:
+    BaseIndex();
+    virtual ~BaseIndex();
+
+    /**
+     * Wait until the index includes the current tip. Returns false without
+     * waiting if it is still catching up. Must not be called with cs_main held.
+     */
+    bool BlockUntilSyncedToCurrentChain();
+
+    //! Look up where the index is in the block index and start the thread.
+    void Start();
+    //! Make the thread stop soon, for shutdown.
+    void Interrupt();
+    //! Stop the thread, after it has written what it has indexed. Must be called before destruction.
+    void Stop();
+};
+
+#endif // BITCOIN_INDEX_BASE_H
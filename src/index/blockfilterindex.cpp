@@ -0,0 +1,117 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/blockfilterindex.h"
+
+#include "chain.h"
+#include "coins.h"
+#include "undo.h"
+#include "util.h"
+#include "validation.h"
+
+static const char DB_FILTER = 'f';
+static const char DB_FILTER_HEADER = 'h';
+
+std::unique_ptr<BlockFilterIndex> g_blockfilterindex;
+
+BlockFilterIndex::BlockFilterIndex(BlockFilterType filterTypeIn, size_t nCacheSize, bool fMemory, bool fWipe) :
+    filterType(filterTypeIn),
+    db(new DB(GetDataDir() / "indexes" / "blockfilter" / BlockFilterTypeName(filterTypeIn), nCacheSize, fMemory, fWipe))
+{
+}
+
+bool BlockFilterIndex::ReadFilterHeader(const uint256& hashBlock, uint256& header) const
+{
+    std::map<uint256, uint256>::const_iterator it = mapUnwrittenHeaders.find(hashBlock);
+    if (it != mapUnwrittenHeaders.end()) {
+        header = it->second;
+        return true;
+    }
+    std::pair<uint256, uint256> entry;
+    if (!db->Read(std::make_pair(DB_FILTER_HEADER, hashBlock), entry))
+        return false;
+    header = entry.second;
+    return true;
+}
+
+bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex, CDBBatch& batch)
+{
+    // The genesis block spends nothing and has no undo data, and its filter
+    // header builds on zero.
+    CBlockUndo blockUndo;
+    uint256 prevHeader;
+    if (pindex->pprev) {
+        if (!UndoReadFromDisk(blockUndo, pindex->GetUndoPos(), pindex->pprev->GetBlockHash()))
+            return error("%s: failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+        if (!ReadFilterHeader(pindex->pprev->GetBlockHash(), prevHeader))
+            return error("%s: no filter header of block %s", __func__, pindex->pprev->GetBlockHash().ToString());
+    }
+
+    const BlockFilter filter(filterType, block, blockUndo);
+    const uint256 header = filter.ComputeHeader(prevHeader);
+    batch.Write(std::make_pair(DB_FILTER, pindex->GetBlockHash()), filter.GetEncodedFilter());
+    batch.Write(std::make_pair(DB_FILTER_HEADER, pindex->GetBlockHash()), std::make_pair(filter.GetHash(), header));
+    mapUnwrittenHeaders[pindex->GetBlockHash()] = header;
+    return true;
+}
+
+bool BlockFilterIndex::GetBlockRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<const CBlockIndex*>& vBlocks)
+{
+    if (nStartHeight < 0 || nStartHeight > pindexStop->nHeight)
+        return false;
+    vBlocks.resize(pindexStop->nHeight - nStartHeight + 1);
+    for (const CBlockIndex* pindex = pindexStop; pindex && pindex->nHeight >= nStartHeight; pindex = pindex->pprev)
+        vBlocks[pindex->nHeight - nStartHeight] = pindex;
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilter(const CBlockIndex* pindex, BlockFilter& filter) const
+{
+    std::vector<unsigned char> vchFilter;
+    if (!db->Read(std::make_pair(DB_FILTER, pindex->GetBlockHash()), vchFilter))
+        return false;
+    try {
+        filter = BlockFilter(filterType, pindex->GetBlockHash(), std::move(vchFilter));
+    } catch (const std::exception& e) {
+        return error("%s: invalid filter of block %s: %s", __func__, pindex->GetBlockHash().ToString(), e.what());
+    }
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterHeader(const CBlockIndex* pindex, uint256& header) const
+{
+    std::pair<uint256, uint256> entry;
+    if (!db->Read(std::make_pair(DB_FILTER_HEADER, pindex->GetBlockHash()), entry))
+        return false;
+    header = entry.second;
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<BlockFilter>& filters) const
+{
+    std::vector<const CBlockIndex*> vBlocks;
+    if (!GetBlockRange(nStartHeight, pindexStop, vBlocks))
+        return false;
+    filters.resize(vBlocks.size());
+    for (size_t i = 0; i < vBlocks.size(); i++) {
+        if (!LookupFilter(vBlocks[i], filters[i]))
+            return false;
+    }
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterHashRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<uint256>& hashes) const
+{
+    std::vector<const CBlockIndex*> vBlocks;
+    if (!GetBlockRange(nStartHeight, pindexStop, vBlocks))
+        return false;
+    hashes.resize(vBlocks.size());
+    std::pair<uint256, uint256> entry;
+    for (size_t i = 0; i < vBlocks.size(); i++) {
+        if (!db->Read(std::make_pair(DB_FILTER_HEADER, vBlocks[i]->GetBlockHash()), entry))
+            return false;
+        hashes[i] = entry.first;
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BLOCKFILTERINDEX_H
+#define BITCOIN_INDEX_BLOCKFILTERINDEX_H
+
+#include "blockfilter.h"
+#include "index/base.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+/** Default for -blockfilterindex */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+/** Default for -peerblockfilters */
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+
+/**
+ * Index of the BIP 158 filters of the blocks of the active chain, with their
+ * filter headers, enabled with -blockfilterindex, in
+ * indexes/blockfilter/<filter type>. Filters are stored by block hash, so the
+ * ones of blocks that were disconnected stay in it. Every filter header builds
+ * on the one of the previous block, so the index needs the data of all blocks
+ * and cannot be built on a chainstate started from a UTXO snapshot.
+ */
+class BlockFilterIndex final : public BaseIndex
+{
+private:
+    const BlockFilterType filterType;
+    const std::unique_ptr<DB> db;
+    //! Filter headers in the batch that is not written yet, which the next blocks build on
+    std::map<uint256, uint256> mapUnwrittenHeaders;
+
+    //! Filter header of a block, from the database or the batch being built.
+    bool ReadFilterHeader(const uint256& hashBlock, uint256& header) const;
+    //! Blocks from the one at nStartHeight up to pindexStop, which must be its ancestor or itself.
+    static bool GetBlockRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<const CBlockIndex*>& vBlocks);
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, CDBBatch& batch) override;
+    void BatchWritten() override { mapUnwrittenHeaders.clear(); }
+    DB& GetDB() const override { return *db; }
+    const char* GetName() const override { return "blockfilterindex"; }
+
+public:
+    BlockFilterIndex(BlockFilterType filterTypeIn, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    BlockFilterType GetFilterType() const { return filterType; }
+
+    //! Look up the filter of a block. Returns false if it is not in the index.
+    bool LookupFilter(const CBlockIndex* pindex, BlockFilter& filter) const;
+    //! Look up the filter header of a block. Returns false if it is not in the index.
+    bool LookupFilterHeader(const CBlockIndex* pindex, uint256& header) const;
+    //! Look up the filters of the blocks from height nStartHeight up to pindexStop.
+    bool LookupFilterRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<BlockFilter>& filters) const;
+    //! Look up the filter hashes of the blocks from height nStartHeight up to pindexStop.
+    bool LookupFilterHashRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<uint256>& hashes) const;
+};
+
+/** The basic block filter index, if -blockfilterindex is set */
+extern std::unique_ptr<BlockFilterIndex> g_blockfilterindex;
+
+#endif // BITCOIN_INDEX_BLOCKFILTERINDEX_H
@@ -0,0 +1,38 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_TXINDEX_H
+#define BITCOIN_INDEX_TXINDEX_H
+
+#include "index/base.h"
+#include "txdb.h"
+
+#include <memory>
+
+/**
+ * Index of where each transaction of the active chain is stored on disk,
+ * enabled with -txindex, in indexes/txindex. Transactions of blocks that
+ * were disconnected stay in it.
+ */
+class TxIndex final : public BaseIndex
+{
+private:
+    const std::unique_ptr<DB> db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, CDBBatch& batch) override;
+    DB& GetDB() const override { return *db; }
+    const char* GetName() const override { return "txindex"; }
+
+public:
+    explicit TxIndex(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    //! Look up where a transaction is stored. Returns false if it is not in the index.
+    bool FindTx(const uint256& txid, CDiskTxPos& pos) const;
+};
+
+/** The transaction index, if -txindex is set */
+extern std::unique_ptr<TxIndex> g_txindex;
+
+#endif // BITCOIN_INDEX_TXINDEX_H
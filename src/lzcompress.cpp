@@ -0,0 +1,151 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "lzcompress.h"
+
+#include <stdint.h>
+#include <string.h>
+
+namespace {
+
+//! Shortest match that is encoded.
+const size_t MIN_MATCH = 4;
+//! The last bytes of the input are always literals.
+const size_t LAST_LITERALS = 5;
+//! The last match must start at least this far from the end of the input.
+const size_t MATCH_FIND_LIMIT = 12;
+//! Farthest back a match can refer to.
+const size_t MAX_DISTANCE = 65535;
+const int HASH_LOG = 14;
+
+uint32_t Read32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+uint32_t Hash32(uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - HASH_LOG);
+}
+
+void WriteLength(std::vector<unsigned char>& out, size_t nLength)
+{
+    for (; nLength >= 255; nLength -= 255)
+        out.push_back(255);
+    out.push_back(nLength);
+}
+
+void WriteSequence(std::vector<unsigned char>& out, const unsigned char* literals, size_t nLiterals, size_t nDistance, size_t nMatch)
+{
+    const size_t nMatchCode = nMatch - MIN_MATCH;
+    out.push_back((nLiterals < 15 ? nLiterals : 15) << 4 | (nMatchCode < 15 ? nMatchCode : 15));
+    if (nLiterals >= 15)
+        WriteLength(out, nLiterals - 15);
+    out.insert(out.end(), literals, literals + nLiterals);
+    out.push_back(nDistance & 0xff);
+    out.push_back(nDistance >> 8);
+    if (nMatchCode >= 15)
+        WriteLength(out, nMatchCode - 15);
+}
+
+void WriteLastLiterals(std::vector<unsigned char>& out, const unsigned char* literals, size_t nLiterals)
+{
+    out.push_back((nLiterals < 15 ? nLiterals : 15) << 4);
+    if (nLiterals >= 15)
+        WriteLength(out, nLiterals - 15);
+    out.insert(out.end(), literals, literals + nLiterals);
+}
+
+//! Read an extended length, adding it to nLength. Returns false on overrun.
+bool ReadLength(const unsigned char*& ip, const unsigned char* iend, size_t& nLength)
+{
+    unsigned char b;
+    do {
+        if (ip == iend)
+            return false;
+        b = *ip++;
+        nLength += b;
+    } while (b == 255);
+    return true;
+}
+
+} // namespace
+
+void LZCompress(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+{
+    out.reserve(out.size() + size + size / 255 + 16);
+    size_t nAnchor = 0;
+    if (size > MATCH_FIND_LIMIT) {
+        std::vector<uint32_t> table(1 << HASH_LOG, 0);
+        const size_t nMatchLimit = size - LAST_LITERALS;
+        const size_t nFindLimit = size - MATCH_FIND_LIMIT;
+        size_t nPos = 0;
+        while (nPos < nFindLimit) {
+            const uint32_t nSequence = Read32(data + nPos);
+            uint32_t& nCandidate = table[Hash32(nSequence)];
+            const size_t nRef = nCandidate;
+            nCandidate = nPos;
+            if (nRef >= nPos || nPos - nRef > MAX_DISTANCE || Read32(data + nRef) != nSequence) {
+                // Skip ahead faster through data that does not compress.
+                nPos += 1 + ((nPos - nAnchor) >> 6);
+                continue;
+            }
+            size_t nMatch = MIN_MATCH;
+            while (nPos + nMatch < nMatchLimit && data[nRef + nMatch] == data[nPos + nMatch])
+                nMatch++;
+            WriteSequence(out, data + nAnchor, nPos - nAnchor, nPos - nRef, nMatch);
+            nPos += nMatch;
+            nAnchor = nPos;
+        }
+    }
+    WriteLastLiterals(out, data + nAnchor, size - nAnchor);
+}
+
+bool LZDecompress(const unsigned char* data, size_t size, unsigned char* out, size_t nOutSize)
+{
+    const unsigned char* ip = data;
+    const unsigned char* const iend = data + size;
+    unsigned char* op = out;
+    unsigned char* const oend = out + nOutSize;
+    while (true) {
+        if (ip == iend)
+            return false;
+        const unsigned char token = *ip++;
+        size_t nLiterals = token >> 4;
+        if (nLiterals == 15 && !ReadLength(ip, iend, nLiterals))
+            return false;
+        if (nLiterals > (size_t)(iend - ip) || nLiterals > (size_t)(oend - op))
+            return false;
+        memcpy(op, ip, nLiterals);
+        ip += nLiterals;
+        op += nLiterals;
+        if (ip == iend)
+            // The last sequence has no match.
+            return op == oend;
+
+        if (iend - ip < 2)
+            return false;
+        const size_t nDistance = ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        if (nDistance == 0 || nDistance > (size_t)(op - out))
+            return false;
+        size_t nMatch = token & 15;
+        if (nMatch == 15 && !ReadLength(ip, iend, nMatch))
+            return false;
+        nMatch += MIN_MATCH;
+        if (nMatch > (size_t)(oend - op))
+            return false;
+        const unsigned char* ref = op - nDistance;
+        if (nDistance >= nMatch) {
+            memcpy(op, ref, nMatch);
+            op += nMatch;
+        } else {
+            // The match overlaps the bytes it produces.
+            for (size_t i = 0; i < nMatch; i++)
+                *op++ = *ref++;
+        }
+    }
+}
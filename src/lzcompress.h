@@ -0,0 +1,28 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_LZCOMPRESS_H
+#define BITCOIN_LZCOMPRESS_H
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ * A small, fast LZ77 codec producing the LZ4 block format: sequences of
+ * literals followed by a match of at least 4 bytes within the previous 64KiB.
+ * It favours speed over ratio, so that compressed block files cost little to
+ * read back.
+ */
+
+/** Compress size bytes at data, appending the result to out. */
+void LZCompress(const unsigned char* data, size_t size, std::vector<unsigned char>& out);
+
+/**
+ * Decompress size bytes at data into exactly nOutSize bytes at out.
+ * Returns false if the input is malformed or does not decompress to
+ * exactly nOutSize bytes. Never reads or writes outside the given buffers.
+ */
+bool LZDecompress(const unsigned char* data, size_t size, unsigned char* out, size_t nOutSize);
+
+#endif // BITCOIN_LZCOMPRESS_H
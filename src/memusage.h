@@ -5,6 +5,7 @@
 #ifndef BITCOIN_MEMUSAGE_H
 #define BITCOIN_MEMUSAGE_H
 
+#include "flatmap.h"
 #include "indirectmap.h"
 
 #include <stdlib.h>
@@ -130,6 +131,12 @@ static inline size_t IncrementalDynamicUsage(const indirectmap<X, Y>& m)
     return MallocUsage(sizeof(stl_tree_node<std::pair<const X*, Y> >));
 }
 
+template<typename X, typename Y, typename Z, typename P>
+static inline size_t DynamicUsage(const flatmap<X, Y, Z, P>& m)
+{
+    return MallocUsage(m.ChunkBytes()) * m.chunk_count() + MallocUsage(sizeof(void*) * m.chunk_count()) + MallocUsage(m.BucketBytes() * m.bucket_count());
+}
+
 template<typename X>
 static inline size_t DynamicUsage(const std::unique_ptr<X>& p)
 {
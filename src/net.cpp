@@ -2712,6 +2712,12 @@ ServiceFlags CConnman::GetLocalServices() const
     return nLocalServices;
 }
 
+void CConnman::AddLocalServices(ServiceFlags services)
+{
+    // Only init and the tasks it schedules change the services.
+    nLocalServices = ServiceFlags(nLocalServices | services);
+}
+
 void CConnman::SetBestHeight(int height)
 {
     nBestHeight.store(height, std::memory_order_release);
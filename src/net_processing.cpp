@@ -11,6 +11,7 @@
 #include "chainparams.h"
 #include "consensus/validation.h"
 #include "hash.h"
+#include "index/blockfilterindex.h"
 #include "init.h"
 #include "validation.h"
 #include "merkleblock.h"
@@ -62,6 +63,13 @@ static std::vector<std::pair<uint256, CTransactionRef>> vExtraTxnForCompact GUAR
 
 static const uint64_t RANDOMIZER_ID_ADDRESS_RELAY = 0x3cac0035b5866b90ULL; // SHA256("main address relay")[0:8]
 
+/** Maximum number of compact filters that may be requested with one getcfilters. See BIP 157. */
+static const uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of cf hashes that may be requested with one getcfheaders. See BIP 157. */
+static const uint32_t MAX_GETCFHEADERS_SIZE = 2000;
+/** Interval between compact filter checkpoints. See BIP 157. */
+static const int CFCHECKPT_INTERVAL = 1000;
+
 // Internal stuff
 namespace {
     /** Number of nodes with fSyncStarted. */
@@ -1089,6 +1097,15 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                     std::shared_ptr<const CBlock> pblock;
                     if (a_recent_block && a_recent_block->GetHash() == (*mi).second->GetBlockHash()) {
                         pblock = a_recent_block;
+                    } else if (inv.type == MSG_WITNESS_BLOCK) {
+                        // Send the block as it is stored on disk, which is
+                        // its serialization with witness, without
+                        // deserializing and serializing it again.
+                        CSerializedNetMsg msg;
+                        msg.command = NetMsgType::BLOCK;
+                        if (!ReadRawBlockFromDisk(msg.data, (*mi).second, Params().MessageStart()))
+                            assert(!"cannot load block from disk");
+                        connman->PushMessage(pfrom, std::move(msg));
                     } else {
                         // Send block from disk
                         std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
@@ -1098,7 +1115,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                     }
                     if (inv.type == MSG_BLOCK)
                         connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
-                    else if (inv.type == MSG_WITNESS_BLOCK)
+                    else if (inv.type == MSG_WITNESS_BLOCK && pblock)
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
                     else if (inv.type == MSG_FILTERED_BLOCK)
                     {
@@ -1448,6 +1465,53 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
     return true;
 }
 
+/**
+ * Check a getcfilters, getcfheaders or getcfcheckpt request of a range of at
+ * most nMaxCount blocks, from nStartHeight up to the block hashStop, and look
+ * up that block. Disconnects the peer for a request it should not have made.
+ */
+bool static PrepareBlockFilterRequest(CNode* pfrom, uint8_t nFilterType, uint32_t nStartHeight, const uint256& hashStop, uint32_t nMaxCount, const CBlockIndex*& pindexStop)
+{
+    const bool fSupported = (pfrom->GetLocalServices() & NODE_COMPACT_FILTERS) && g_blockfilterindex &&
+        nFilterType == static_cast<uint8_t>(g_blockfilterindex->GetFilterType());
+    if (!fSupported) {
+        LogPrint(BCLog::NET, "peer %d requested unsupported block filter type: %d\n", pfrom->GetId(), nFilterType);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hashStop);
+        if (it == mapBlockIndex.end()) {
+            LogPrint(BCLog::NET, "peer %d requested block filters of unknown block %s\n", pfrom->GetId(), hashStop.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+        // The stop block may have been reorganized away since the peer asked.
+        if (!chainActive.Contains(it->second)) {
+            LogPrint(BCLog::NET, "peer %d requested block filters of block %s, which is not in the active chain\n", pfrom->GetId(), hashStop.ToString());
+            return false;
+        }
+        pindexStop = it->second;
+    }
+
+    const uint32_t nStopHeight = pindexStop->nHeight;
+    if (nStartHeight > nStopHeight) {
+        LogPrint(BCLog::NET, "peer %d sent invalid block filter request with start height %d and stop height %d\n",
+                 pfrom->GetId(), nStartHeight, nStopHeight);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (nStopHeight - nStartHeight >= nMaxCount) {
+        LogPrint(BCLog::NET, "peer %d requested too many block filters: %d / %d\n",
+                 pfrom->GetId(), nStopHeight - nStartHeight + 1, nMaxCount);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    return true;
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
@@ -2776,6 +2840,78 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         pfrom->fRelayTxes = true;
     }
 
+    else if (strCommand == NetMsgType::GETCFILTERS)
+    {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 hashStop;
+        vRecv >> nFilterType >> nStartHeight >> hashStop;
+
+        const CBlockIndex* pindexStop;
+        if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFILTERS_SIZE, pindexStop))
+            return true;
+
+        // The filters are read from the index without cs_main, a block it
+        // has not got to yet leaves the request unanswered.
+        std::vector<BlockFilter> filters;
+        if (!g_blockfilterindex->LookupFilterRange(nStartHeight, pindexStop, filters)) {
+            LogPrint(BCLog::NET, "Failed to find block filter up to %s for peer=%d\n", hashStop.ToString(), pfrom->GetId());
+            return true;
+        }
+        for (const BlockFilter& filter : filters)
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, filter));
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFHEADERS)
+    {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 hashStop;
+        vRecv >> nFilterType >> nStartHeight >> hashStop;
+
+        const CBlockIndex* pindexStop;
+        if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFHEADERS_SIZE, pindexStop))
+            return true;
+
+        // The headers of the range follow from the header of the block
+        // before it and the filter hashes.
+        uint256 prevHeader;
+        if (nStartHeight > 0 && !g_blockfilterindex->LookupFilterHeader(pindexStop->GetAncestor(nStartHeight - 1), prevHeader)) {
+            LogPrint(BCLog::NET, "Failed to find block filter header at height %d for peer=%d\n", nStartHeight - 1, pfrom->GetId());
+            return true;
+        }
+        std::vector<uint256> hashes;
+        if (!g_blockfilterindex->LookupFilterHashRange(nStartHeight, pindexStop, hashes)) {
+            LogPrint(BCLog::NET, "Failed to find block filter hashes up to %s for peer=%d\n", hashStop.ToString(), pfrom->GetId());
+            return true;
+        }
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFHEADERS, nFilterType, hashStop, prevHeader, hashes));
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFCHECKPT)
+    {
+        uint8_t nFilterType;
+        uint256 hashStop;
+        vRecv >> nFilterType >> hashStop;
+
+        const CBlockIndex* pindexStop;
+        if (!PrepareBlockFilterRequest(pfrom, nFilterType, 0, hashStop, std::numeric_limits<uint32_t>::max(), pindexStop))
+            return true;
+
+        std::vector<uint256> headers(pindexStop->nHeight / CFCHECKPT_INTERVAL);
+        for (size_t i = 0; i < headers.size(); i++) {
+            const int nHeight = (i + 1) * CFCHECKPT_INTERVAL;
+            if (!g_blockfilterindex->LookupFilterHeader(pindexStop->GetAncestor(nHeight), headers[i])) {
+                LogPrint(BCLog::NET, "Failed to find block filter header at height %d for peer=%d\n", nHeight, pfrom->GetId());
+                return true;
+            }
+        }
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFCHECKPT, nFilterType, hashStop, headers));
+    }
+
+
     else if (strCommand == NetMsgType::FEEFILTER) {
         CAmount newFeeFilter = 0;
         vRecv >> newFeeFilter;
@@ -0,0 +1,58 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "obfuscation.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+void XorObfuscate(unsigned char* data, size_t size, const unsigned char* key, size_t nKeySize, size_t nKeyOffset)
+{
+    if (nKeySize == 0)
+        return;
+    nKeyOffset %= nKeySize;
+    if (nKeySize != 8) {
+        for (size_t i = 0, j = nKeyOffset; i < size; i++) {
+            data[i] ^= key[j++];
+            if (j == nKeySize)
+                j = 0;
+        }
+        return;
+    }
+
+    // The key, rotated to start at nKeyOffset, twice. Every step below is a
+    // multiple of 8 bytes, so the key lines up with data[i] at rotated[i % 8].
+    unsigned char rotated[16];
+    for (size_t i = 0; i < sizeof(rotated); i++)
+        rotated[i] = key[(nKeyOffset + i) % 8];
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i keyVector = _mm_loadu_si128((const __m128i*)rotated);
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        _mm_storeu_si128((__m128i*)(data + i), _mm_xor_si128(block, keyVector));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint8x16_t keyVector = vld1q_u8(rotated);
+    for (; i + 16 <= size; i += 16)
+        vst1q_u8(data + i, veorq_u8(vld1q_u8(data + i), keyVector));
+#endif
+    uint64_t keyWord;
+    memcpy(&keyWord, rotated, 8);
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        word ^= keyWord;
+        memcpy(data + i, &word, 8);
+    }
+    for (; i < size; i++)
+        data[i] ^= rotated[i % 8];
+}
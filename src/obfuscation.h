@@ -0,0 +1,17 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_OBFUSCATION_H
+#define BITCOIN_OBFUSCATION_H
+
+#include <stddef.h>
+
+/**
+ * XOR size bytes at data with key, repeated, starting nKeyOffset bytes into
+ * the key. The 8 byte keys the databases use are applied 16 or 8 bytes at a
+ * time, with SSE2 or NEON where available; other key sizes byte by byte.
+ */
+void XorObfuscate(unsigned char* data, size_t size, const unsigned char* key, size_t nKeySize, size_t nKeyOffset = 0);
+
+#endif // BITCOIN_OBFUSCATION_H
@@ -11,6 +11,9 @@ namespace
 {
 /* Global secp256k1_context object used for verification. */
 secp256k1_context* secp256k1_context_verify = nullptr;
+/* Precomputed tables to create secp256k1_context_verify from, if any. */
+const unsigned char* verify_table = nullptr;
+size_t verify_table_size = 0;
 } // namespace
 
 /** This function is taken from the libsecp256k1 distribution and implements
@@ -283,7 +286,11 @@ ECCVerifyHandle::ECCVerifyHandle()
 {
     if (refcount == 0) {
         assert(secp256k1_context_verify == nullptr);
-        secp256k1_context_verify = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY);
+        if (verify_table != nullptr) {
+            secp256k1_context_verify = secp256k1_context_create_with_verify_table(SECP256K1_CONTEXT_VERIFY, verify_table, verify_table_size);
+        } else {
+            secp256k1_context_verify = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY);
+        }
         assert(secp256k1_context_verify != nullptr);
     }
     refcount++;
@@ -298,3 +305,22 @@ ECCVerifyHandle::~ECCVerifyHandle()
         secp256k1_context_verify = nullptr;
     }
 }
+
+size_t ECC_VerifyTableSize()
+{
+    return secp256k1_context_verify_table_size();
+}
+
+bool ECC_ExportVerifyTable(std::vector<unsigned char>& table)
+{
+    assert(secp256k1_context_verify != nullptr);
+    table.resize(secp256k1_context_verify_table_size());
+    return secp256k1_context_verify_table_export(secp256k1_context_verify, table.data(), table.size());
+}
+
+void ECC_SetVerifyTable(const unsigned char* table, size_t size)
+{
+    assert(secp256k1_context_verify == nullptr);
+    verify_table = table;
+    verify_table_size = size;
+}
@@ -247,4 +247,18 @@ public:
     ~ECCVerifyHandle();
 };
 
+/** Size in bytes of the verification context's precomputed tables. */
+size_t ECC_VerifyTableSize();
+
+/** Copy the verification tables out of the current context. Requires an ECCVerifyHandle. */
+bool ECC_ExportVerifyTable(std::vector<unsigned char>& table);
+
+/**
+ * Make verification contexts use the precomputed tables at table (e.g. a
+ * read-only file mapping) instead of computing their own. May only be called
+ * while no ECCVerifyHandle exists; the memory must stay valid until the last
+ * handle created afterwards is gone. Pass nullptr to compute tables again.
+ */
+void ECC_SetVerifyTable(const unsigned char* table, size_t size);
+
 #endif // BITCOIN_PUBKEY_H
@@ -3,9 +3,12 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "base58.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "core_io.h"
+#include "index/addressindex.h"
+#include "index/txindex.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "validation.h"
@@ -210,6 +213,10 @@ static bool rest_block(HTTPRequest* req,
 
     CBlock block;
     CBlockIndex* pblockindex = nullptr;
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    // The binary and hex formats can be served as stored on disk, unless a
+    // different serialization was asked for.
+    const bool fRaw = (rf == RF_BINARY || rf == RF_HEX) && RPCSerializationFlags() == 0;
     {
         LOCK(cs_main);
         if (mapBlockIndex.count(hash) == 0)
@@ -219,12 +226,18 @@ static bool rest_block(HTTPRequest* req,
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+        if (fRaw) {
+            std::vector<uint8_t> vRawBlock;
+            if (!ReadRawBlockFromDisk(vRawBlock, pblockindex, Params().MessageStart()))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+            ssBlock.write((const char*)vRawBlock.data(), vRawBlock.size());
+        } else if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) {
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        }
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ssBlock << block;
+    if (!fRaw)
+        ssBlock << block;
 
     switch (rf) {
     case RF_BINARY: {
@@ -358,10 +371,15 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
+    const bool fIndexReady = !g_txindex || g_txindex->BlockUntilSyncedToCurrentChain();
+
     CTransactionRef tx;
     uint256 hashBlock = uint256();
-    if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, true))
+    if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, true)) {
+        if (!fIndexReady)
+            return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "The transaction index is still being built");
         return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+    }
 
     CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
     ssTx << tx;
@@ -586,6 +604,59 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static bool rest_addresshistory(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 5)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/addresshistory/<startheight>/<endheight>/<count>/<skip>/<address>.json.");
+
+    int32_t nStartHeight, nEndHeight, nCount, nSkip;
+    if (!ParseInt32(path[0], &nStartHeight) || !ParseInt32(path[1], &nEndHeight) || nStartHeight < 0 || nEndHeight < nStartHeight)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height range: " + path[0] + "/" + path[1]);
+    if (!ParseInt32(path[2], &nCount) || nCount < 1 || nCount > (int32_t)MAX_ADDRESS_HISTORY_RESULTS)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Output count out of range: " + path[2]);
+    if (!ParseInt32(path[3], &nSkip) || nSkip < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid skip: " + path[3]);
+    CBitcoinAddress address(path[4]);
+    if (!address.IsValid())
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + path[4]);
+
+    if (!g_addressindex)
+        return RESTERR(req, HTTP_NOT_FOUND, "Address index not enabled, use -addressindex");
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain())
+        return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "The address index is still being built");
+
+    std::vector<CAddressHistoryEntry> entries;
+    bool fMore;
+    if (!g_addressindex->FindScriptHistory(GetScriptForDestination(address.Get()), nStartHeight, nEndHeight, nSkip, nCount, entries, fMore))
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Failed to read the address index");
+
+    switch (rf) {
+    case RF_JSON: {
+        UniValue objHistory(UniValue::VOBJ);
+        objHistory.push_back(Pair("address", path[4]));
+        objHistory.push_back(Pair("history", addressHistoryToJSON(entries)));
+        objHistory.push_back(Pair("more", fMore));
+        std::string strJSON = objHistory.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -598,6 +669,7 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/addresshistory/", rest_addresshistory},
 };
 
 bool StartREST()
@@ -6,16 +6,22 @@
 #include "rpc/blockchain.h"
 
 #include "amount.h"
+#include "base58.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "coins.h"
+#include "index/addressindex.h"
+#include "index/blockfilterindex.h"
+#include "init.h"
 #include "consensus/validation.h"
 #include "validation.h"
 #include "core_io.h"
 #include "policy/feerate.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
+#include "pubkey.h"
+#include "random.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
@@ -23,9 +29,13 @@
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "utxosnapshot.h"
 #include "hash.h"
 
+#include <atomic>
+#include <limits>
 #include <stdint.h>
+#include <unordered_set>
 
 #include <univalue.h>
 
@@ -687,6 +697,64 @@ UniValue getblockheader(const JSONRPCRequest& request)
     return blockheaderToJSON(pblockindex);
 }
 
+UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "getblockfilter \"blockhash\" ( \"filtertype\" )\n"
+            "\nRetrieve a BIP 157 content filter for a particular block.\n"
+            "Requires -blockfilterindex.\n"
+            "\nArguments:\n"
+            "1. \"blockhash\"     (string, required) The hash of the block\n"
+            "2. \"filtertype\"    (string, optional, default=\"basic\") The type name of the filter\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"hex\",   (string) the hex-encoded filter data\n"
+            "  \"header\" : \"hash\",  (string) the hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+        );
+
+    uint256 hash(uint256S(request.params[0].get_str()));
+    std::string strFilterType = "basic";
+    if (!request.params[1].isNull())
+        strFilterType = request.params[1].get_str();
+
+    BlockFilterType filterType;
+    if (!BlockFilterTypeByName(strFilterType, filterType))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+    if (!g_blockfilterindex || g_blockfilterindex->GetFilterType() != filterType)
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + strFilterType);
+
+    // Wait for the index to include the tip, without cs_main held.
+    const bool fIndexReady = g_blockfilterindex->BlockUntilSyncedToCurrentChain();
+
+    const CBlockIndex* pblockindex;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hash);
+        if (it == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = it->second;
+    }
+
+    BlockFilter filter;
+    uint256 header;
+    if (!g_blockfilterindex->LookupFilter(pblockindex, filter) || !g_blockfilterindex->LookupFilterHeader(pblockindex, header)) {
+        std::string strError = "Filter not found.";
+        if (!fIndexReady)
+            strError += " Block filters are still in the process of being indexed.";
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("filter", HexStr(filter.GetEncodedFilter())));
+    ret.push_back(Pair("header", header.GetHex()));
+    return ret;
+}
+
 UniValue getblock(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
@@ -759,6 +827,14 @@ UniValue getblock(const JSONRPCRequest& request)
     if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
         throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
 
+    if (verbosity <= 0 && RPCSerializationFlags() == 0) {
+        // The requested serialization is the one on disk.
+        std::vector<uint8_t> vRawBlock;
+        if (!ReadRawBlockFromDisk(vRawBlock, pblockindex, Params().MessageStart()))
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+        return HexStr(vRawBlock.begin(), vRawBlock.end());
+    }
+
     if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
         // Block not found on disk. This could be because we have the block
         // header in our index but don't have the block (for example if a
@@ -792,57 +868,93 @@ struct CCoinsStats
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
 };
 
-static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+template <typename Stream>
+static void ApplyStats(CCoinsStats &stats, Stream& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
 {
-    assert(!outputs.empty());
-    ss << hash;
-    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase);
+    HashTxOutputs(ss, hash, outputs);
     stats.nTransactions++;
-    for (const auto output : outputs) {
-        ss << VARINT(output.first + 1);
-        ss << output.second.out.scriptPubKey;
-        ss << VARINT(output.second.out.nValue);
+    for (const auto& output : outputs) {
         stats.nTransactionOutputs++;
         stats.nTotalAmount += output.second.out.nValue;
         stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
                            2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
     }
-    ss << VARINT(0);
 }
 
 //! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
+static bool GetUTXOStats(CCoinsViewDB *view, CCoinsStats &stats)
 {
-    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
+    // Each range of txids is read and serialized on one of the cores, and the
+    // results are added to the hash in order, which is all that is serial.
+    const int nThreads = std::max(1, GetNumCores());
+    std::vector<std::unique_ptr<CCoinsViewCursor>> vCursors = view->PartitionedCursors(nThreads * 32);
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
+    stats.hashBlock = vCursors[0]->GetBestBlock();
     {
         LOCK(cs_main);
         stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
     }
     ss << stats.hashBlock;
-    uint256 prevkey;
-    std::map<uint32_t, Coin> outputs;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        COutPoint key;
-        Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            if (!outputs.empty() && key.hash != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
-                outputs.clear();
+
+    std::mutex cs;
+    std::condition_variable cond;
+    size_t nHashed = 0;
+    bool fFailed = false;
+    auto fail = [&]() {
+        std::lock_guard<std::mutex> lock(cs);
+        fFailed = true;
+        cond.notify_all();
+    };
+    bool ret = ScanCursorsParallel(vCursors, nThreads, [&](size_t i, CCoinsViewCursor& cursor) {
+        CDataStream buf(SER_GETHASH, PROTOCOL_VERSION);
+        CCoinsStats part;
+        try {
+            uint256 prevkey;
+            std::map<uint32_t, Coin> outputs;
+            while (cursor.Valid()) {
+                if (ShutdownRequested()) {
+                    fail();
+                    return false;
+                }
+                COutPoint key;
+                Coin coin;
+                if (cursor.GetKey(key) && cursor.GetValue(coin)) {
+                    if (!outputs.empty() && key.hash != prevkey) {
+                        ApplyStats(part, buf, prevkey, outputs);
+                        outputs.clear();
+                    }
+                    prevkey = key.hash;
+                    outputs[key.n] = std::move(coin);
+                } else {
+                    fail();
+                    return error("%s: unable to read value", __func__);
+                }
+                cursor.Next();
             }
-            prevkey = key.hash;
-            outputs[key.n] = std::move(coin);
-        } else {
-            return error("%s: unable to read value", __func__);
+            if (!outputs.empty()) {
+                ApplyStats(part, buf, prevkey, outputs);
+            }
+        } catch (...) {
+            fail();
+            throw;
         }
-        pcursor->Next();
-    }
-    if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
-    }
+
+        std::unique_lock<std::mutex> lock(cs);
+        cond.wait(lock, [&] { return nHashed == i || fFailed; });
+        if (fFailed)
+            return false;
+        ss.write(buf.data(), buf.size());
+        stats.nTransactions += part.nTransactions;
+        stats.nTransactionOutputs += part.nTransactionOutputs;
+        stats.nBogoSize += part.nBogoSize;
+        stats.nTotalAmount += part.nTotalAmount;
+        nHashed++;
+        cond.notify_all();
+        return true;
+    });
+    if (!ret)
+        return false;
     stats.hashSerialized = ss.GetHash();
     stats.nDiskSize = view->EstimateSize();
     return true;
@@ -899,11 +1011,15 @@ UniValue pruneblockchain(const JSONRPCRequest& request)
 
 UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 1)
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "With hash_type \"muhash\" they come from the rolling hash and totals that are kept\n"
+            "up to date as blocks are connected, which takes no time, but without transactions.\n"
+            "Otherwise the whole set is read on all cores, and this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"   (string, optional, default=\"hash_serialized_2\") \"hash_serialized_2\" or \"muhash\"\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
@@ -912,16 +1028,36 @@ UniValue gettxoutsetinfo(const JSONRPCRequest& request)
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
             "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
+            "  \"muhash\": \"hash\",       (string) The rolling hash, with hash_type \"muhash\"\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
-            + HelpExampleRpc("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"muhash\"")
+            + HelpExampleRpc("gettxoutsetinfo", "\"muhash\"")
         );
 
     UniValue ret(UniValue::VOBJ);
 
+    const std::string strHashType = request.params[0].isNull() ? "hash_serialized_2" : request.params[0].get_str();
+    if (strHashType == "muhash") {
+        LOCK(cs_main);
+        CCoinsSetHash setHash;
+        if (!pcoinsTip->GetSetHash(setHash))
+            throw JSONRPCError(RPC_MISC_ERROR, "The UTXO set hash is not known yet");
+        ret.push_back(Pair("height", (int64_t)chainActive.Height()));
+        ret.push_back(Pair("bestblock", chainActive.Tip()->GetBlockHash().GetHex()));
+        ret.push_back(Pair("txouts", setHash.nTxOuts));
+        ret.push_back(Pair("bogosize", setHash.nBogoSize));
+        ret.push_back(Pair("muhash", setHash.GetHash().GetHex()));
+        ret.push_back(Pair("disk_size", (uint64_t)pcoinsdbview->EstimateSize()));
+        ret.push_back(Pair("total_amount", ValueFromAmount(setHash.nTotalAmount)));
+        return ret;
+    } else if (strHashType != "hash_serialized_2") {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown hash_type " + strHashType);
+    }
+
     CCoinsStats stats;
     FlushStateToDisk();
     if (GetUTXOStats(pcoinsdbview, stats)) {
@@ -939,6 +1075,426 @@ UniValue gettxoutsetinfo(const JSONRPCRequest& request)
     return ret;
 }
 
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the unspent transaction output set to a snapshot file, which\n"
+            "a node with an empty chainstate can start from with -loadtxoutset.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The file to write, which must not exist. Relative to the data directory.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,         (numeric) The number of unspent outputs written\n"
+            "  \"base_hash\": \"hex\",         (string) The block the set is the state after\n"
+            "  \"base_height\": n,           (numeric) The height of that block\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The hash to give -loadtxoutsethash, as in gettxoutsetinfo\n"
+            "  \"muhash\": \"hash\",         (string) The rolling hash of the set, if it is known\n"
+            "  \"path\": \"path\"              (string) The absolute path of the snapshot\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    const fs::path pathTemp = path.string() + ".incomplete";
+    if (fs::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+
+    FlushStateToDisk();
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    CUTXOSnapshotHeader header;
+    CCoinsSetHash setHash;
+    bool fSetHash;
+    {
+        // No flush can come between taking the cursor and the rolling hash.
+        LOCK(cs_main);
+        pcursor.reset(pcoinsdbview->Cursor());
+        fSetHash = pcoinsdbview->GetSetHash(setHash);
+        header.hashBlock = pcursor->GetBestBlock();
+        const CBlockIndex* pindex = mapBlockIndex.find(header.hashBlock)->second;
+        header.nChainTx = pindex->nChainTx;
+        for (; pindex->pprev; pindex = pindex->pprev)
+            header.vHeaders.push_back(pindex->GetBlockHeader());
+        std::reverse(header.vHeaders.begin(), header.vHeaders.end());
+    }
+    if (header.vHeaders.empty())
+        throw JSONRPCError(RPC_MISC_ERROR, "There is no chain to take a snapshot of");
+
+    CAutoFile file(fsbridge::fopen(pathTemp, "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to open " + pathTemp.string());
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << header.hashBlock;
+    try {
+        // The counts are not known yet, they are filled in at the end.
+        file << header;
+        uint256 prevkey;
+        std::map<uint32_t, Coin> outputs;
+        auto WriteOutputs = [&]() {
+            if (!IsSingleTransaction(outputs))
+                throw std::ios_base::failure("outputs of " + prevkey.GetHex() + " differ in height or coinbase flag");
+            WriteSnapshotTransaction(file, prevkey, outputs);
+            HashTxOutputs(ss, prevkey, outputs);
+            header.nTransactions++;
+            header.nCoins += outputs.size();
+            outputs.clear();
+        };
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin))
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+            if (!outputs.empty() && key.hash != prevkey)
+                WriteOutputs();
+            prevkey = key.hash;
+            outputs[key.n] = std::move(coin);
+            pcursor->Next();
+        }
+        if (!outputs.empty())
+            WriteOutputs();
+        if (fseek(file.Get(), 0, SEEK_SET) != 0)
+            throw std::ios_base::failure("seek failed");
+        file << header;
+    } catch (const std::ios_base::failure& e) {
+        file.fclose();
+        fs::remove(pathTemp);
+        throw JSONRPCError(RPC_MISC_ERROR, std::string("Unable to write snapshot: ") + e.what());
+    }
+    FileCommit(file.Get());
+    file.fclose();
+    if (!RenameOver(pathTemp, path))
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to rename " + pathTemp.string());
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins_written", (int64_t)header.nCoins));
+    ret.push_back(Pair("base_hash", header.hashBlock.GetHex()));
+    ret.push_back(Pair("base_height", (int64_t)header.vHeaders.size()));
+    ret.push_back(Pair("hash_serialized_2", ss.GetHash().GetHex()));
+    if (fSetHash)
+        ret.push_back(Pair("muhash", setHash.GetHash().GetHex()));
+    ret.push_back(Pair("path", path.string()));
+    return ret;
+}
+
+/** Whether a scantxoutset is running, and the signal to abort it */
+static std::atomic<bool> g_scan_in_progress(false);
+static std::atomic<bool> g_should_abort_scan(false);
+/** Percentage of the UTXO set scanned by the running scantxoutset */
+static std::atomic<int> g_scan_progress(0);
+
+/** Marks a scantxoutset as running for as long as it is in scope */
+class CCoinsViewScanReserver
+{
+private:
+    bool fReserved;
+
+public:
+    CCoinsViewScanReserver() : fReserved(false) {}
+
+    //! Returns false if another scan is already running.
+    bool Reserve()
+    {
+        assert(!fReserved);
+        bool fExpected = false;
+        if (!g_scan_in_progress.compare_exchange_strong(fExpected, true))
+            return false;
+        fReserved = true;
+        return true;
+    }
+
+    ~CCoinsViewScanReserver()
+    {
+        if (fReserved)
+            g_scan_in_progress = false;
+    }
+};
+
+/** Hashes a script with a key that is random per process */
+class SaltedScriptHasher
+{
+private:
+    const uint64_t k0, k1;
+
+public:
+    SaltedScriptHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+    size_t operator()(const CScript& script) const
+    {
+        return CSipHasher(k0, k1).Write(script.data(), script.size()).Finalize();
+    }
+};
+
+/** Add the scripts a scan object of scantxoutset stands for. */
+static void AddScanObjectScripts(const std::string& strObject, std::unordered_set<CScript, SaltedScriptHasher>& setScripts)
+{
+    const size_t nOpen = strObject.find('(');
+    if (nOpen == std::string::npos || strObject.back() != ')')
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid scan object: " + strObject);
+    const std::string strType = strObject.substr(0, nOpen);
+    const std::string strArg = strObject.substr(nOpen + 1, strObject.size() - nOpen - 2);
+    if (strType == "addr") {
+        CBitcoinAddress address(strArg);
+        if (!address.IsValid())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + strArg);
+        setScripts.insert(GetScriptForDestination(address.Get()));
+    } else if (strType == "raw") {
+        if (!IsHex(strArg))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid script: " + strArg);
+        const std::vector<unsigned char> vchScript(ParseHex(strArg));
+        setScripts.insert(CScript(vchScript.begin(), vchScript.end()));
+    } else if (strType == "combo") {
+        const CPubKey pubkey(IsHex(strArg) ? ParseHex(strArg) : std::vector<unsigned char>());
+        if (!pubkey.IsFullyValid())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid public key: " + strArg);
+        setScripts.insert(GetScriptForRawPubKey(pubkey));
+        setScripts.insert(GetScriptForDestination(pubkey.GetID()));
+    } else {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid scan object type: " + strType);
+    }
+}
+
+UniValue scantxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "scantxoutset \"action\" ( [scanobjects,...] )\n"
+            "\nScan the unspent transaction output set for outputs to any of the given scripts,\n"
+            "on all cores. Only one scan can run at a time.\n"
+            "\nArguments:\n"
+            "1. \"action\"          (string, required) \"start\" to scan, \"abort\" to stop a running scan,\n"
+            "                     or \"status\" for the progress of a running scan\n"
+            "2. \"scanobjects\"     (array, required with \"start\") What to look for, each one of\n"
+            "    [\n"
+            "      \"addr(<address>)\",   (string) The output script of an address\n"
+            "      \"raw(<script>)\",     (string) An output script in hex\n"
+            "      \"combo(<pubkey>)\",   (string) P2PK and P2PKH outputs of a public key in hex\n"
+            "      ,...\n"
+            "    ]\n"
+            "\nResult with \"start\":\n"
+            "{\n"
+            "  \"success\": true|false,   (boolean) False if the scan was aborted\n"
+            "  \"searched_items\": n,     (numeric) The number of unspent outputs scanned\n"
+            "  \"height\": n,             (numeric) The height of the block the set is the state after\n"
+            "  \"bestblock\": \"hex\",      (string) The hash of that block\n"
+            "  \"unspents\": [\n"
+            "    {\n"
+            "      \"txid\": \"hex\",         (string) The transaction id\n"
+            "      \"vout\": n,             (numeric) The output number\n"
+            "      \"scriptPubKey\": \"hex\", (string) The output script\n"
+            "      \"amount\": x.xxx,       (numeric) The amount in " + CURRENCY_UNIT + "\n"
+            "      \"height\": n            (numeric) The height of the block with the transaction\n"
+            "    }\n"
+            "    ,...\n"
+            "  ],\n"
+            "  \"total_amount\": x.xxx    (numeric) The total amount of the unspent outputs\n"
+            "}\n"
+            "\nResult with \"status\", or null if no scan is running:\n"
+            "{\n"
+            "  \"progress\": n            (numeric) The percentage of the set scanned\n"
+            "}\n"
+            "\nResult with \"abort\":\n"
+            "true|false                 (boolean) Whether a scan was running\n"
+            "\nExamples:\n"
+            + HelpExampleCli("scantxoutset", "\"start\" \"[\\\"addr(1BvBMSEYstWetqTFn5Au4m4GFg7xJaNVN2)\\\"]\"")
+            + HelpExampleCli("scantxoutset", "\"status\"")
+            + HelpExampleRpc("scantxoutset", "\"start\", [\"addr(1BvBMSEYstWetqTFn5Au4m4GFg7xJaNVN2)\"]")
+        );
+
+    const std::string strAction = request.params[0].get_str();
+    if (strAction == "status") {
+        if (!g_scan_in_progress)
+            return NullUniValue;
+        UniValue ret(UniValue::VOBJ);
+        ret.push_back(Pair("progress", (int)g_scan_progress));
+        return ret;
+    } else if (strAction == "abort") {
+        if (!g_scan_in_progress)
+            return false;
+        g_should_abort_scan = true;
+        return true;
+    } else if (strAction != "start") {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid action " + strAction);
+    }
+
+    if (request.params[1].isNull())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "scanobjects is required with \"start\"");
+    std::unordered_set<CScript, SaltedScriptHasher> setScripts;
+    const UniValue& scanobjects = request.params[1].get_array();
+    for (size_t i = 0; i < scanobjects.size(); i++)
+        AddScanObjectScripts(scanobjects[i].get_str(), setScripts);
+
+    CCoinsViewScanReserver reserver;
+    if (!reserver.Reserve())
+        throw JSONRPCError(RPC_MISC_ERROR, "A scan is already in progress, use \"abort\" or \"status\"");
+    g_should_abort_scan = false;
+    g_scan_progress = 0;
+
+    FlushStateToDisk();
+    const int nThreads = std::max(1, GetNumCores());
+    std::vector<std::unique_ptr<CCoinsViewCursor>> vCursors = pcoinsdbview->PartitionedCursors(nThreads * 32);
+    const uint256 hashBlock = vCursors[0]->GetBestBlock();
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = mapBlockIndex.find(hashBlock)->second->nHeight;
+    }
+
+    // Every range keeps its own results, so that they come out in txid order.
+    std::vector<std::vector<std::pair<COutPoint, Coin>>> vFound(vCursors.size());
+    std::atomic<uint64_t> nSearched(0);
+    std::atomic<size_t> nDone(0);
+    std::atomic<bool> fRead(true);
+    bool fOk = ScanCursorsParallel(vCursors, nThreads, [&](size_t i, CCoinsViewCursor& cursor) {
+        uint64_t nCount = 0;
+        for (; cursor.Valid(); cursor.Next()) {
+            if (++nCount % 10000 == 0 && (g_should_abort_scan || ShutdownRequested()))
+                return false;
+            COutPoint key;
+            Coin coin;
+            if (!cursor.GetKey(key) || !cursor.GetValue(coin)) {
+                fRead = false;
+                return false;
+            }
+            if (setScripts.count(coin.out.scriptPubKey))
+                vFound[i].emplace_back(key, std::move(coin));
+        }
+        nSearched += nCount;
+        g_scan_progress = (int)(++nDone * 100 / vCursors.size());
+        return true;
+    });
+    if (!fRead)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("success", fOk));
+    if (!fOk)
+        return ret;
+    ret.push_back(Pair("searched_items", nSearched.load()));
+    ret.push_back(Pair("height", nHeight));
+    ret.push_back(Pair("bestblock", hashBlock.GetHex()));
+    UniValue unspents(UniValue::VARR);
+    CAmount nTotal = 0;
+    for (const auto& vPart : vFound) {
+        for (const auto& found : vPart) {
+            UniValue unspent(UniValue::VOBJ);
+            unspent.push_back(Pair("txid", found.first.hash.GetHex()));
+            unspent.push_back(Pair("vout", (int32_t)found.first.n));
+            unspent.push_back(Pair("scriptPubKey", HexStr(found.second.out.scriptPubKey.begin(), found.second.out.scriptPubKey.end())));
+            unspent.push_back(Pair("amount", ValueFromAmount(found.second.out.nValue)));
+            unspent.push_back(Pair("height", (int32_t)found.second.nHeight));
+            unspents.push_back(unspent);
+            nTotal += found.second.out.nValue;
+        }
+    }
+    ret.push_back(Pair("unspents", unspents));
+    ret.push_back(Pair("total_amount", ValueFromAmount(nTotal)));
+    return ret;
+}
+
+UniValue addressHistoryToJSON(const std::vector<CAddressHistoryEntry>& entries)
+{
+    UniValue history(UniValue::VARR);
+    for (const CAddressHistoryEntry& entry : entries) {
+        UniValue output(UniValue::VOBJ);
+        output.push_back(Pair("txid", entry.txid.GetHex()));
+        output.push_back(Pair("vout", (int64_t)entry.nOut));
+        output.push_back(Pair("height", entry.nHeight));
+        output.push_back(Pair("blockhash", entry.hashBlock.GetHex()));
+        output.push_back(Pair("amount", ValueFromAmount(entry.nValue)));
+        if (entry.IsSpent()) {
+            UniValue spent(UniValue::VOBJ);
+            spent.push_back(Pair("txid", entry.spentTxid.GetHex()));
+            spent.push_back(Pair("vin", (int64_t)entry.nSpentIn));
+            spent.push_back(Pair("height", entry.nSpentHeight));
+            spent.push_back(Pair("blockhash", entry.hashSpentBlock.GetHex()));
+            output.push_back(Pair("spent", spent));
+        }
+        history.push_back(output);
+    }
+    return history;
+}
+
+UniValue getaddresshistory(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 5)
+        throw std::runtime_error(
+            "getaddresshistory \"address\" ( startheight endheight count skip )\n"
+            "\nReturns the outputs to an address in blocks from startheight up to endheight of the active chain,\n"
+            "in order of height, with the inputs that spend them. Requires -addressindex, and fails until it is built.\n"
+            "\nArguments:\n"
+            "1. \"address\"     (string, required) The address\n"
+            "2. startheight     (numeric, optional, default=0) The height of the first block\n"
+            "3. endheight       (numeric, optional, default=the tip) The height of the last block\n"
+            "4. count           (numeric, optional, default=100) The number of outputs to return, at most " + std::to_string(MAX_ADDRESS_HISTORY_RESULTS) + "\n"
+            "5. skip            (numeric, optional, default=0) The number of outputs to skip, to page through them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"address\" : \"address\",  (string) The address\n"
+            "  \"history\" : [\n"
+            "    {\n"
+            "      \"txid\" : \"hash\",     (string) The transaction id of the output\n"
+            "      \"vout\" : n,          (numeric) The output number\n"
+            "      \"height\" : n,        (numeric) The height of the block of the output\n"
+            "      \"blockhash\" : \"hash\", (string) The hash of the block of the output\n"
+            "      \"amount\" : x.xxx,    (numeric) The value of the output in " + CURRENCY_UNIT + "\n"
+            "      \"spent\" : {          (object) The input that spends the output, if it is spent\n"
+            "        \"txid\" : \"hash\",   (string) The transaction id of the input\n"
+            "        \"vin\" : n,         (numeric) The input number\n"
+            "        \"height\" : n,      (numeric) The height of the block of the input\n"
+            "        \"blockhash\" : \"hash\" (string) The hash of the block of the input\n"
+            "      }\n"
+            "    }\n"
+            "    ,...\n"
+            "  ],\n"
+            "  \"more\" : true|false     (boolean) Whether there are more outputs in the range, after skip + count\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddresshistory", "\"1BvBMSEYstWetqTFn5Au4m4GFg7xJaNVN2\"")
+            + HelpExampleCli("getaddresshistory", "\"1BvBMSEYstWetqTFn5Au4m4GFg7xJaNVN2\" 100000 200000 1000 1000")
+            + HelpExampleRpc("getaddresshistory", "\"1BvBMSEYstWetqTFn5Au4m4GFg7xJaNVN2\", 100000, 200000, 1000, 1000")
+        );
+
+    if (!g_addressindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled, use -addressindex");
+
+    const std::string strAddress = request.params[0].get_str();
+    CBitcoinAddress address(strAddress);
+    if (!address.IsValid())
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + strAddress);
+
+    const int nStartHeight = request.params[1].isNull() ? 0 : request.params[1].get_int();
+    const int nEndHeight = request.params[2].isNull() ? std::numeric_limits<int>::max() : request.params[2].get_int();
+    if (nStartHeight < 0 || nEndHeight < nStartHeight)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid height range");
+    const int nCount = request.params[3].isNull() ? 100 : request.params[3].get_int();
+    if (nCount < 1 || nCount > (int)MAX_ADDRESS_HISTORY_RESULTS)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("count must be between 1 and %u", MAX_ADDRESS_HISTORY_RESULTS));
+    const int nSkip = request.params[4].isNull() ? 0 : request.params[4].get_int();
+    if (nSkip < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative skip");
+
+    // Wait for the index to include the tip, without cs_main held. While it is
+    // still catching up, the history would be missing outputs.
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain())
+        throw JSONRPCError(RPC_MISC_ERROR, "The address index is still being built");
+
+    std::vector<CAddressHistoryEntry> entries;
+    bool fMore;
+    if (!g_addressindex->FindScriptHistory(GetScriptForDestination(address.Get()), nStartHeight, nEndHeight, nSkip, nCount, entries, fMore))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the address index");
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("address", strAddress));
+    ret.push_back(Pair("history", addressHistoryToJSON(entries)));
+    ret.push_back(Pair("more", fMore));
+    return ret;
+}
+
 UniValue gettxout(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
@@ -1538,12 +2094,14 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafe argNames
   //  --------------------- ------------------------  -----------------------  ------ ----------
     { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,  {} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true,  {"path"} },
     { "blockchain",         "getchaintxstats",        &getchaintxstats,        true,  {"nblocks", "blockhash"} },
     { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  {} },
     { "blockchain",         "getblockcount",          &getblockcount,          true,  {} },
     { "blockchain",         "getblock",               &getblock,               true,  {"blockhash","verbosity|verbose"} },
     { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"} },
     { "blockchain",         "getblockheader",         &getblockheader,         true,  {"blockhash","verbose"} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         true,  {"blockhash","filtertype"} },
     { "blockchain",         "getchaintips",           &getchaintips,           true,  {} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true,  {} },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    true,  {"txid","verbose"} },
@@ -1552,8 +2110,10 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {"hash_type"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        true,  {"height"} },
+    { "blockchain",         "scantxoutset",           &scantxoutset,           true,  {"action", "scanobjects"} },
+    { "blockchain",         "getaddresshistory",      &getaddresshistory,      true,  {"address","startheight","endheight","count","skip"} },
     { "blockchain",         "verifychain",            &verifychain,            true,  {"checklevel","nblocks"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          true,  {"blockhash"} },
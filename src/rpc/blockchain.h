@@ -5,9 +5,12 @@
 #ifndef BITCOIN_RPC_BLOCKCHAIN_H
 #define BITCOIN_RPC_BLOCKCHAIN_H
 
+#include <vector>
+
 class CBlock;
 class CBlockIndex;
 class UniValue;
+struct CAddressHistoryEntry;
 
 /**
  * Get the difficulty of the net wrt to the given block index, or the chain tip if
@@ -33,5 +36,8 @@ UniValue mempoolToJSON(bool fVerbose = false);
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
+/** Outputs of the address index, with the inputs spending them, to JSON */
+UniValue addressHistoryToJSON(const std::vector<CAddressHistoryEntry>& entries);
+
 #endif
 
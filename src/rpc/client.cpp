@@ -101,6 +101,11 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "gettxout", 1, "n" },
     { "gettxout", 2, "include_mempool" },
     { "gettxoutproof", 0, "txids" },
+    { "scantxoutset", 1, "scanobjects" },
+    { "getaddresshistory", 1, "startheight" },
+    { "getaddresshistory", 2, "endheight" },
+    { "getaddresshistory", 3, "count" },
+    { "getaddresshistory", 4, "skip" },
     { "lockunspent", 0, "unlock" },
     { "lockunspent", 1, "transactions" },
     { "importprivkey", 2, "rescan" },
@@ -14,6 +14,7 @@
 #include "netbase.h"
 #include "rpc/blockchain.h"
 #include "rpc/server.h"
+#include "script/sigcache.h"
 #include "timedata.h"
 #include "util.h"
 #include "utilstrencodings.h"
@@ -568,6 +569,48 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+static UniValue CacheStatsToJSON(const ValidationCacheStats& stats)
+{
+    UniValue obj(UniValue::VOBJ);
+    uint64_t nLookups = stats.nHits + stats.nMisses;
+    obj.push_back(Pair("capacity", stats.nCapacity));
+    obj.push_back(Pair("hits", stats.nHits));
+    obj.push_back(Pair("misses", stats.nMisses));
+    obj.push_back(Pair("hitrate", nLookups ? (double)stats.nHits / nLookups : 0.0));
+    obj.push_back(Pair("inserts", stats.nInserts));
+    obj.push_back(Pair("evictions", stats.nEvictions));
+    return obj;
+}
+
+UniValue getcachestats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getcachestats\n"
+            "Returns usage counters of the validation caches since startup, to help size -maxsigcachesize.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"sigcache\": {            (json object) Signature cache\n"
+            "    \"capacity\": xxxxx,      (numeric) Number of entries the cache can hold\n"
+            "    \"hits\": xxxxx,          (numeric) Number of lookups that found an entry\n"
+            "    \"misses\": xxxxx,        (numeric) Number of lookups that did not\n"
+            "    \"hitrate\": x.xxx,       (numeric) hits / (hits + misses)\n"
+            "    \"inserts\": xxxxx,       (numeric) Number of entries added\n"
+            "    \"evictions\": xxxxx,     (numeric) Number of inserts that pushed out a live entry\n"
+            "  },\n"
+            "  \"scriptcache\": { ... }   (json object) Script execution cache, same fields\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getcachestats", "")
+            + HelpExampleRpc("getcachestats", "")
+        );
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("sigcache", CacheStatsToJSON(GetSignatureCacheStats())));
+    obj.push_back(Pair("scriptcache", CacheStatsToJSON(GetScriptExecutionCacheStats())));
+    return obj;
+}
+
 uint32_t getCategoryMask(UniValue cats) {
     cats = cats.get_array();
     uint32_t mask = 0;
@@ -653,6 +696,7 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getinfo",                &getinfo,                true,  {} }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  {"mode"} },
+    { "control",            "getcachestats",          &getcachestats,          true,  {} },
     { "util",               "validateaddress",        &validateaddress,        true,  {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         true,  {"nrequired","keys"} },
     { "util",               "verifymessage",          &verifymessage,          true,  {"address","signature","message"} },
@@ -12,6 +12,7 @@
 #include "util.h"
 
 #include "cuckoocache.h"
+#include <atomic>
 #include <boost/thread.hpp>
 
 namespace {
@@ -27,10 +28,19 @@ private:
     uint256 nonce;
     typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
     map_type setValid;
+    //! Serializes inserts; readers only take it when an insert overlaps their lookup
     boost::shared_mutex cs_sigcache;
+    //! Incremented before and after every insert, so it is odd while one is in progress
+    std::atomic<uint32_t> nInsertSeq;
+    uint32_t nCapacity;
+
+    std::atomic<uint64_t> nHits;
+    std::atomic<uint64_t> nMisses;
+    std::atomic<uint64_t> nInserts;
+    std::atomic<uint64_t> nEvictions;
 
 public:
-    CSignatureCache()
+    CSignatureCache() : nInsertSeq(0), nCapacity(0), nHits(0), nMisses(0), nInserts(0), nEvictions(0)
     {
         GetRandBytes(nonce.begin(), 32);
     }
@@ -44,18 +54,55 @@ public:
     bool
     Get(const uint256& entry, const bool erase)
     {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
-        return setValid.contains(entry, erase);
+        bool found;
+        // Only inserts modify the table; erasing merely sets the cuckoo
+        // cache's atomic collection flags. A lookup that did not overlap an
+        // insert therefore needs no lock. If one did, a stray collection flag
+        // costs at most a later cache miss, and the lookup is repeated under
+        // the lock.
+        uint32_t seq = nInsertSeq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+            found = setValid.contains(entry, erase);
+        } else {
+            found = setValid.contains(entry, erase);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (nInsertSeq.load(std::memory_order_relaxed) != seq) {
+                boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+                found = setValid.contains(entry, erase);
+            }
+        }
+        (found ? nHits : nMisses).fetch_add(1, std::memory_order_relaxed);
+        return found;
     }
 
     void Set(uint256& entry)
     {
         boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        setValid.insert(entry);
+        uint32_t seq = nInsertSeq.load(std::memory_order_relaxed);
+        nInsertSeq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bool evicted = setValid.insert(entry);
+        nInsertSeq.store(seq + 2, std::memory_order_release);
+        nInserts.fetch_add(1, std::memory_order_relaxed);
+        if (evicted)
+            nEvictions.fetch_add(1, std::memory_order_relaxed);
     }
     uint32_t setup_bytes(size_t n)
     {
-        return setValid.setup_bytes(n);
+        nCapacity = setValid.setup_bytes(n);
+        return nCapacity;
+    }
+
+    ValidationCacheStats GetStats() const
+    {
+        ValidationCacheStats stats;
+        stats.nCapacity = nCapacity;
+        stats.nHits = nHits.load(std::memory_order_relaxed);
+        stats.nMisses = nMisses.load(std::memory_order_relaxed);
+        stats.nInserts = nInserts.load(std::memory_order_relaxed);
+        stats.nEvictions = nEvictions.load(std::memory_order_relaxed);
+        return stats;
     }
 };
 
@@ -80,6 +127,11 @@ void InitSignatureCache()
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
 }
 
+ValidationCacheStats GetSignatureCacheStats()
+{
+    return signatureCache.GetStats();
+}
+
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
     uint256 entry;
@@ -51,6 +51,18 @@ public:
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const override;
 };
 
+/** Usage counters of a signature or script execution cache. */
+struct ValidationCacheStats
+{
+    uint64_t nCapacity;
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nInserts;
+    uint64_t nEvictions;
+};
+
 void InitSignatureCache();
 
+ValidationCacheStats GetSignatureCacheStats();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
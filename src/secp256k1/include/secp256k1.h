@@ -179,6 +179,48 @@ SECP256K1_API secp256k1_context* secp256k1_context_clone(
     const secp256k1_context* ctx
 ) SECP256K1_ARG_NONNULL(1) SECP256K1_WARN_UNUSED_RESULT;
 
+/** Get the size of the precomputed tables of a verification context.
+ *
+ *  Returns: the number of bytes secp256k1_context_verify_table_export writes.
+ *
+ *  The size depends on how the library was configured, so tables can only be
+ *  exchanged between builds with the same size.
+ */
+SECP256K1_API size_t secp256k1_context_verify_table_size(void);
+
+/** Copy the precomputed tables of a verification context.
+ *
+ *  Returns: 1 if the tables were written.
+ *  Args:    ctx:       a context created with SECP256K1_CONTEXT_VERIFY (cannot be NULL)
+ *  Out:     output:    pointer to a buffer of outputlen bytes (cannot be NULL)
+ *  In:      outputlen: must equal secp256k1_context_verify_table_size()
+ */
+SECP256K1_API int secp256k1_context_verify_table_export(
+    const secp256k1_context* ctx,
+    unsigned char *output,
+    size_t outputlen
+) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2);
+
+/** Create a context whose verification tables are read from caller memory.
+ *
+ *  Returns: a newly created context object, or NULL if the table is invalid.
+ *  In:      flags:    which parts of the context to initialize; verification is
+ *                     always enabled
+ *           table:    tables previously written by
+ *                     secp256k1_context_verify_table_export, 8-byte aligned.
+ *                     They are used in place (e.g. from a shared read-only file
+ *                     mapping), so they must outlive the context and its clones
+ *                     must be made after it was created.
+ *           tablelen: must equal secp256k1_context_verify_table_size()
+ *
+ *  The tables are not checked; callers must make sure they are intact.
+ */
+SECP256K1_API secp256k1_context* secp256k1_context_create_with_verify_table(
+    unsigned int flags,
+    const unsigned char *table,
+    size_t tablelen
+) SECP256K1_WARN_UNUSED_RESULT;
+
 /** Destroy a secp256k1 context object.
  *
  *  The context pointer may not be used afterwards.
@@ -16,6 +16,7 @@ typedef struct {
 #ifdef USE_ENDOMORPHISM
     secp256k1_ge_storage (*pre_g_128)[]; /* odd multiples of 2^128*generator */
 #endif
+    int external; /* tables point at caller-owned memory and are not freed */
 } secp256k1_ecmult_context;
 
 static void secp256k1_ecmult_context_init(secp256k1_ecmult_context *ctx);
@@ -25,6 +26,13 @@ static void secp256k1_ecmult_context_clone(secp256k1_ecmult_context *dst,
 static void secp256k1_ecmult_context_clear(secp256k1_ecmult_context *ctx);
 static int secp256k1_ecmult_context_is_built(const secp256k1_ecmult_context *ctx);
 
+/** Size in bytes of the serialized tables (all of them, back to back). */
+static size_t secp256k1_ecmult_context_table_size(void);
+/** Copy the tables of a built context to out, which must hold table_size bytes. */
+static void secp256k1_ecmult_context_table_export(const secp256k1_ecmult_context *ctx, unsigned char *out);
+/** Use tables stored at data (table_size bytes, suitably aligned) without copying them. */
+static void secp256k1_ecmult_context_table_attach(secp256k1_ecmult_context *ctx, const unsigned char *data);
+
 /** Double multiply: R = na*A + ng*G */
 static void secp256k1_ecmult(const secp256k1_ecmult_context *ctx, secp256k1_gej *r, const secp256k1_gej *a, const secp256k1_scalar *na, const secp256k1_scalar *ng);
 
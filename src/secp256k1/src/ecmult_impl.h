@@ -159,6 +159,7 @@ static void secp256k1_ecmult_context_init(secp256k1_ecmult_context *ctx) {
 #ifdef USE_ENDOMORPHISM
     ctx->pre_g_128 = NULL;
 #endif
+    ctx->external = 0;
 }
 
 static void secp256k1_ecmult_context_build(secp256k1_ecmult_context *ctx, const secp256k1_callback *cb) {
@@ -195,6 +196,8 @@ static void secp256k1_ecmult_context_build(secp256k1_ecmult_context *ctx, const
 
 static void secp256k1_ecmult_context_clone(secp256k1_ecmult_context *dst,
                                            const secp256k1_ecmult_context *src, const secp256k1_callback *cb) {
+    /* Clones always own their tables, even if src uses external ones. */
+    dst->external = 0;
     if (src->pre_g == NULL) {
         dst->pre_g = NULL;
     } else {
@@ -218,13 +221,40 @@ static int secp256k1_ecmult_context_is_built(const secp256k1_ecmult_context *ctx
 }
 
 static void secp256k1_ecmult_context_clear(secp256k1_ecmult_context *ctx) {
-    free(ctx->pre_g);
+    if (!ctx->external) {
+        free(ctx->pre_g);
 #ifdef USE_ENDOMORPHISM
-    free(ctx->pre_g_128);
+        free(ctx->pre_g_128);
 #endif
+    }
     secp256k1_ecmult_context_init(ctx);
 }
 
+static size_t secp256k1_ecmult_context_table_size(void) {
+    size_t size = sizeof(secp256k1_ge_storage) * ECMULT_TABLE_SIZE(WINDOW_G);
+#ifdef USE_ENDOMORPHISM
+    size *= 2;
+#endif
+    return size;
+}
+
+static void secp256k1_ecmult_context_table_export(const secp256k1_ecmult_context *ctx, unsigned char *out) {
+    size_t size = sizeof(secp256k1_ge_storage) * ECMULT_TABLE_SIZE(WINDOW_G);
+    memcpy(out, ctx->pre_g, size);
+#ifdef USE_ENDOMORPHISM
+    memcpy(out + size, ctx->pre_g_128, size);
+#endif
+}
+
+static void secp256k1_ecmult_context_table_attach(secp256k1_ecmult_context *ctx, const unsigned char *data) {
+    /* The tables are only ever read, so read-only (e.g. mapped) memory is fine. */
+    ctx->pre_g = (secp256k1_ge_storage (*)[])data;
+#ifdef USE_ENDOMORPHISM
+    ctx->pre_g_128 = (secp256k1_ge_storage (*)[])(data + sizeof(secp256k1_ge_storage) * ECMULT_TABLE_SIZE(WINDOW_G));
+#endif
+    ctx->external = 1;
+}
+
 /** Convert a number to WNAF notation. The number becomes represented by sum(2^i * wnaf[i], i=0..bits),
  *  with the following guarantees:
  *  - each wnaf[i] is either 0, or an odd integer between -(1<<(w-1) - 1) and (1<<(w-1) - 1)
@@ -89,6 +89,32 @@ secp256k1_context* secp256k1_context_clone(const secp256k1_context* ctx) {
     return ret;
 }
 
+size_t secp256k1_context_verify_table_size(void) {
+    return secp256k1_ecmult_context_table_size();
+}
+
+int secp256k1_context_verify_table_export(const secp256k1_context* ctx, unsigned char *output, size_t outputlen) {
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(secp256k1_ecmult_context_is_built(&ctx->ecmult_ctx));
+    ARG_CHECK(output != NULL);
+    ARG_CHECK(outputlen == secp256k1_ecmult_context_table_size());
+    secp256k1_ecmult_context_table_export(&ctx->ecmult_ctx, output);
+    return 1;
+}
+
+secp256k1_context* secp256k1_context_create_with_verify_table(unsigned int flags, const unsigned char *table, size_t tablelen) {
+    secp256k1_context* ret;
+    if (EXPECT(table == NULL || tablelen != secp256k1_ecmult_context_table_size() || ((uintptr_t)table % sizeof(uint64_t)) != 0, 0)) {
+        secp256k1_callback_call(&default_illegal_callback, "Invalid verification table");
+        return NULL;
+    }
+    ret = secp256k1_context_create(flags & ~SECP256K1_FLAGS_BIT_CONTEXT_VERIFY);
+    if (ret != NULL) {
+        secp256k1_ecmult_context_table_attach(&ret->ecmult_ctx, table);
+    }
+    return ret;
+}
+
 void secp256k1_context_destroy(secp256k1_context* ctx) {
     if (ctx != NULL) {
         secp256k1_ecmult_context_clear(&ctx->ecmult_ctx);
@@ -250,6 +250,37 @@ void run_context_tests(void) {
 
 /***** HASH TESTS *****/
 
+void run_context_verify_table_tests(void) {
+    secp256k1_context *sign = secp256k1_context_create(SECP256K1_CONTEXT_SIGN);
+    secp256k1_context *vrfy = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY);
+    secp256k1_context *ext, *ext_clone;
+    secp256k1_pubkey pubkey;
+    secp256k1_ecdsa_signature sig;
+    unsigned char ctmp[32];
+    size_t size = secp256k1_context_verify_table_size();
+    unsigned char *table = (unsigned char *)checked_malloc(&vrfy->error_callback, size);
+
+    CHECK(secp256k1_context_verify_table_export(vrfy, table, size) == 1);
+    ext = secp256k1_context_create_with_verify_table(SECP256K1_CONTEXT_VERIFY, table, size);
+    CHECK(ext != NULL);
+    ext_clone = secp256k1_context_clone(ext);
+
+    memset(ctmp, 1, 32);
+    CHECK(secp256k1_ec_pubkey_create(sign, &pubkey, ctmp) == 1);
+    CHECK(secp256k1_ecdsa_sign(sign, &sig, ctmp, ctmp, NULL, NULL) == 1);
+    CHECK(secp256k1_ecdsa_verify(ext, &sig, ctmp, &pubkey) == 1);
+    CHECK(secp256k1_ecdsa_verify(ext_clone, &sig, ctmp, &pubkey) == 1);
+    ctmp[0] = 0;
+    CHECK(secp256k1_ecdsa_verify(ext, &sig, ctmp, &pubkey) == 0);
+
+    /* Destroying contexts must leave the caller's table alone. */
+    secp256k1_context_destroy(ext_clone);
+    secp256k1_context_destroy(ext);
+    free(table);
+    secp256k1_context_destroy(vrfy);
+    secp256k1_context_destroy(sign);
+}
+
 void run_sha256_tests(void) {
     static const char *inputs[8] = {
         "", "abc", "message digest", "secure hash algorithm", "SHA256 is considered to be safe",
@@ -4451,6 +4482,7 @@ int main(int argc, char **argv) {
 
     /* initialize */
     run_context_tests();
+    run_context_verify_table_tests();
     ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
     if (secp256k1_rand_bits(1)) {
         secp256k1_rand256(run32);
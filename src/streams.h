@@ -7,6 +7,7 @@
 #define BITCOIN_STREAMS_H
 
 #include "support/allocators/zeroafterfree.h"
+#include "obfuscation.h"
 #include "serialize.h"
 
 #include <algorithm>
@@ -15,6 +16,7 @@
 #include <limits>
 #include <map>
 #include <set>
+#include <stdexcept>
 #include <stdint.h>
 #include <stdio.h>
 #include <string>
@@ -138,6 +140,144 @@ private:
     size_t nPos;
 };
 
+/* Minimal stream for reading from a byte range owned by someone else, without copying it
+ *
+ * The referenced memory must outlive the reader.
+ */
+class CBufferReader
+{
+ public:
+
+/*
+ * @param[in]  nTypeIn Serialization Type
+ * @param[in]  nVersionIn Serialization Version (including any flags)
+ * @param[in]  pbeginIn, pendIn The bytes to read
+*/
+    CBufferReader(int nTypeIn, int nVersionIn, const char* pbeginIn, const char* pendIn) : nType(nTypeIn), nVersion(nVersionIn), pbegin(pbeginIn), pend(pendIn)
+    {
+        assert(pbegin <= pend);
+    }
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize > size()) {
+            throw std::ios_base::failure("CBufferReader::read(): end of data");
+        }
+        memcpy(pch, pbegin, nSize);
+        pbegin += nSize;
+    }
+    void ignore(size_t nSize)
+    {
+        if (nSize > size()) {
+            throw std::ios_base::failure("CBufferReader::ignore(): end of data");
+        }
+        pbegin += nSize;
+    }
+    template<typename T>
+    CBufferReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+    int GetVersion() const
+    {
+        return nVersion;
+    }
+    int GetType() const
+    {
+        return nType;
+    }
+    size_t size() const
+    {
+        return pend - pbegin;
+    }
+    bool empty() const
+    {
+        return pbegin == pend;
+    }
+private:
+    const int nType;
+    const int nVersion;
+    const char* pbegin;
+    const char* pend;
+};
+
+/* Reads a stream bit by bit, most significant bit of each byte first */
+template <typename IStream>
+class BitStreamReader
+{
+private:
+    IStream& istream;
+    //! The byte last read from the stream
+    uint8_t nBuffer;
+    //! Number of bits of nBuffer already returned, from the most significant one
+    int nOffset;
+
+public:
+    explicit BitStreamReader(IStream& istreamIn) : istream(istreamIn), nBuffer(0), nOffset(8) {}
+
+    //! Read the next nbits bits, at most 64, as the low bits of the result.
+    uint64_t Read(int nbits)
+    {
+        if (nbits < 0 || nbits > 64)
+            throw std::out_of_range("BitStreamReader::Read(): nbits must be between 0 and 64");
+        uint64_t data = 0;
+        while (nbits > 0) {
+            if (nOffset == 8) {
+                istream >> nBuffer;
+                nOffset = 0;
+            }
+            const int bits = std::min(8 - nOffset, nbits);
+            data <<= bits;
+            data |= static_cast<uint8_t>(nBuffer << nOffset) >> (8 - bits);
+            nOffset += bits;
+            nbits -= bits;
+        }
+        return data;
+    }
+};
+
+/* Writes to a stream bit by bit, most significant bit of each byte first */
+template <typename OStream>
+class BitStreamWriter
+{
+private:
+    OStream& ostream;
+    //! The bits of the byte being filled
+    uint8_t nBuffer;
+    //! Number of bits of nBuffer that are filled, from the most significant one
+    int nOffset;
+
+public:
+    explicit BitStreamWriter(OStream& ostreamIn) : ostream(ostreamIn), nBuffer(0), nOffset(0) {}
+    ~BitStreamWriter() { Flush(); }
+
+    //! Write the low nbits bits of data, at most 64.
+    void Write(uint64_t data, int nbits)
+    {
+        if (nbits < 0 || nbits > 64)
+            throw std::out_of_range("BitStreamWriter::Write(): nbits must be between 0 and 64");
+        while (nbits > 0) {
+            const int bits = std::min(8 - nOffset, nbits);
+            nBuffer |= (data << (64 - nbits)) >> (64 - 8 + nOffset);
+            nOffset += bits;
+            nbits -= bits;
+            if (nOffset == 8)
+                Flush();
+        }
+    }
+
+    //! Write out the byte being filled, padded with zero bits.
+    void Flush()
+    {
+        if (nOffset == 0)
+            return;
+        ostream << nBuffer;
+        nBuffer = 0;
+        nOffset = 0;
+    }
+};
+
 /** Double ended buffer combining vector and stream-like interfaces.
  *
  * >> and << read and write unformatted data using the above serialization templates.
@@ -420,20 +560,7 @@ public:
      */
     void Xor(const std::vector<unsigned char>& key)
     {
-        if (key.size() == 0) {
-            return;
-        }
-
-        for (size_type i = 0, j = 0; i != size(); i++) {
-            vch[i] ^= key[j++];
-
-            // This potentially acts on very many bytes of data, so it's
-            // important that we calculate `j`, i.e. the `key` index in this
-            // way instead of doing a %, which would effectively be a division
-            // for each byte Xor'd -- much slower than need be.
-            if (j == key.size())
-                j = 0;
-        }
+        XorObfuscate((unsigned char*)vch.data(), vch.size(), key.data(), key.size());
     }
 };
 
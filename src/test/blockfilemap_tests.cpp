@@ -0,0 +1,76 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+#include "fs.h"
+#include "util.h"
+#include "test/test_bitcoin.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilemap_tests, BasicTestingSetup)
+
+static const fs::path testDir = fs::temp_directory_path() / fs::unique_path();
+
+static fs::path TestFilePath(int nFile)
+{
+    return testDir / strprintf("map%05u.dat", nFile);
+}
+
+static void AppendToFile(int nFile, const std::string& data)
+{
+    FILE* file = fsbridge::fopen(TestFilePath(nFile), "ab");
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fwrite(data.data(), 1, data.size(), file), data.size());
+    fclose(file);
+}
+
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(blockfilemap_get)
+{
+    fs::create_directories(testDir);
+    CBlockFileMap map(TestFilePath, 2);
+
+    // Missing files can't be mapped.
+    BOOST_CHECK(!map.Get(0, 1));
+
+    AppendToFile(0, "abcd");
+    std::shared_ptr<const CBlockFileMap::Mapping> mapping = map.Get(0, 4);
+    BOOST_REQUIRE(mapping);
+    BOOST_CHECK_EQUAL(mapping->size(), 4U);
+    BOOST_CHECK(memcmp(mapping->data(), "abcd", 4) == 0);
+    BOOST_CHECK(map.Get(0, 2) == mapping);
+    // Not enough data yet.
+    BOOST_CHECK(!map.Get(0, 8));
+
+    // Once the file has grown it is mapped again; the old mapping stays
+    // usable while it is referenced.
+    AppendToFile(0, "efgh");
+    std::shared_ptr<const CBlockFileMap::Mapping> grown = map.Get(0, 8);
+    BOOST_REQUIRE(grown);
+    BOOST_CHECK(grown != mapping);
+    BOOST_CHECK(memcmp(grown->data(), "abcdefgh", 8) == 0);
+    BOOST_CHECK(memcmp(mapping->data(), "abcd", 4) == 0);
+
+    // Only the most recently used files are kept.
+    AppendToFile(1, "1");
+    AppendToFile(2, "2");
+    BOOST_CHECK(map.Get(1, 1));
+    BOOST_CHECK(map.Get(2, 1));
+    BOOST_CHECK(map.Get(0, 1) != grown);
+
+    std::shared_ptr<const CBlockFileMap::Mapping> unmapped = map.Get(2, 1);
+    map.Unmap(2);
+    BOOST_CHECK(map.Get(2, 1) != unmapped);
+    BOOST_CHECK_EQUAL(*unmapped->data(), '2');
+
+    map.Clear();
+    fs::remove_all(testDir);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
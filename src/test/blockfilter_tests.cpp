@@ -0,0 +1,142 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "coins.h"
+#include "crypto/common.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "streams.h"
+#include "undo.h"
+#include "utilstrencodings.h"
+#include "test/test_bitcoin.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilter_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(gcsfilter_test)
+{
+    GCSFilter::ElementSet included_elements, excluded_elements;
+    for (int i = 0; i < 100; ++i) {
+        GCSFilter::Element element1(32);
+        element1[0] = i;
+        included_elements.insert(std::move(element1));
+
+        GCSFilter::Element element2(32);
+        element2[1] = i;
+        excluded_elements.insert(std::move(element2));
+    }
+
+    GCSFilter filter(GCSFilter::Params(0, 0, 10, 1 << 10), included_elements);
+    for (const auto& element : included_elements) {
+        BOOST_CHECK(filter.Match(element));
+
+        auto insertion = excluded_elements.insert(element);
+        BOOST_CHECK(filter.MatchAny(excluded_elements));
+        excluded_elements.erase(insertion.first);
+    }
+    BOOST_CHECK_EQUAL(filter.GetN(), 100);
+
+    // The filter decodes to the same filter.
+    GCSFilter filter2(filter.GetParams(), filter.GetEncoded());
+    BOOST_CHECK_EQUAL(filter2.GetN(), 100);
+    for (const auto& element : included_elements)
+        BOOST_CHECK(filter2.Match(element));
+
+    // An encoding with missing or excess data is rejected.
+    std::vector<unsigned char> vchEncoded = filter.GetEncoded();
+    vchEncoded.push_back(0);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), vchEncoded), std::ios_base::failure);
+    vchEncoded.resize(vchEncoded.size() - 20);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), vchEncoded), std::ios_base::failure);
+
+    // An empty filter matches nothing.
+    GCSFilter empty;
+    BOOST_CHECK_EQUAL(empty.GetEncoded().size(), 1);
+    BOOST_CHECK(!empty.MatchAny(included_elements));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_basic_test)
+{
+    CScript included_scripts[5], excluded_scripts[3];
+
+    // Output scripts of the block
+    included_scripts[0] << std::vector<unsigned char>(0, 65) << OP_CHECKSIG;
+    included_scripts[1] << OP_DUP << OP_HASH160 << std::vector<unsigned char>(1, 20) << OP_EQUALVERIFY << OP_CHECKSIG;
+    included_scripts[2] << OP_1 << std::vector<unsigned char>(6, 33) << std::vector<unsigned char>(7, 33) << OP_2 << OP_CHECKMULTISIG;
+
+    // Scripts of the outputs it spends
+    included_scripts[3] << OP_HASH160 << std::vector<unsigned char>(2, 20) << OP_EQUAL;
+    included_scripts[4] << std::vector<unsigned char>(3, 33) << OP_CHECKSIG;
+
+    // OP_RETURN outputs of the block are left out, and so are scripts the
+    // block only has in inputs and empty ones.
+    excluded_scripts[0] << OP_RETURN << std::vector<unsigned char>(4, 40);
+    excluded_scripts[1] << std::vector<unsigned char>(5, 33) << OP_CHECKSIG;
+
+    CMutableTransaction tx_1;
+    tx_1.vout.emplace_back(100, included_scripts[0]);
+    tx_1.vout.emplace_back(200, included_scripts[1]);
+    tx_1.vout.emplace_back(0, excluded_scripts[0]);
+    tx_1.vout.emplace_back(0, CScript());
+
+    CMutableTransaction tx_2;
+    tx_2.vin.emplace_back(COutPoint(InsecureRand256(), 0), excluded_scripts[1]);
+    tx_2.vout.emplace_back(300, included_scripts[2]);
+
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(tx_1));
+    block.vtx.push_back(MakeTransactionRef(tx_2));
+
+    CBlockUndo block_undo;
+    block_undo.vtxundo.emplace_back();
+    block_undo.vtxundo.back().vprevout.emplace_back(CTxOut(500, included_scripts[3]), 1000, true);
+    block_undo.vtxundo.back().vprevout.emplace_back(CTxOut(600, included_scripts[4]), 10000, false);
+    block_undo.vtxundo.back().vprevout.emplace_back(CTxOut(700, excluded_scripts[2]), 100000, false);
+
+    BlockFilter block_filter(BlockFilterType::BASIC, block, block_undo);
+    const GCSFilter& filter = block_filter.GetFilter();
+
+    for (const CScript& script : included_scripts)
+        BOOST_CHECK(filter.Match(GCSFilter::Element(script.begin(), script.end())));
+    for (const CScript& script : excluded_scripts)
+        BOOST_CHECK(!filter.Match(GCSFilter::Element(script.begin(), script.end())));
+
+    // The filter survives serialization as in the cfilter message.
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << block_filter;
+    BlockFilter block_filter2;
+    stream >> block_filter2;
+    BOOST_CHECK(block_filter2.GetFilterType() == BlockFilterType::BASIC);
+    BOOST_CHECK(block_filter2.GetBlockHash() == block.GetHash());
+    BOOST_CHECK(block_filter2.GetEncodedFilter() == block_filter.GetEncodedFilter());
+    BOOST_CHECK(block_filter2.GetHash() == block_filter.GetHash());
+
+    BlockFilter block_filter3(BlockFilterType::BASIC, block.GetHash(), block_filter.GetEncodedFilter());
+    BOOST_CHECK(block_filter3.ComputeHeader(uint256()) == block_filter.ComputeHeader(uint256()));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_bip158_vector)
+{
+    // The first test vector of BIP 158, the testnet genesis block, which has
+    // nothing to spend. Block headers here commit to the metronome hash, so
+    // the block is given by its hash and its one output script.
+    const uint256 hashBlock = uint256S("000000000933ea01ad0ee984209779baaec3ced90fa3f408719526f8d77f4943");
+    const CScript script = CScript() << ParseHex("04678afdb0fe5548271967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5f") << OP_CHECKSIG;
+
+    GCSFilter::ElementSet elements;
+    elements.emplace(script.begin(), script.end());
+    const GCSFilter::Params params(ReadLE64(hashBlock.begin()), ReadLE64(hashBlock.begin() + 8), BASIC_FILTER_P, BASIC_FILTER_M);
+    BOOST_CHECK_EQUAL(HexStr(GCSFilter(params, elements).GetEncoded()), "019dfca8");
+
+    BlockFilter filter(BlockFilterType::BASIC, hashBlock, ParseHex("019dfca8"));
+    BOOST_CHECK(filter.GetFilter().Match(GCSFilter::Element(script.begin(), script.end())));
+    BOOST_CHECK_EQUAL(filter.ComputeHeader(uint256()).GetHex(), "21584579b7eb08997773e5aeff3a7f932700042d0ed2a6129012b7d7ae81b750");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
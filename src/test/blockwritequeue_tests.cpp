@@ -0,0 +1,104 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockwritequeue.h"
+#include "fs.h"
+#include "tinyformat.h"
+#include "test/test_bitcoin.h"
+
+#include <stdio.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockwritequeue_tests, BasicTestingSetup)
+
+static const fs::path testDir = fs::temp_directory_path() / fs::unique_path();
+
+static fs::path TestFilePath(int nFile, bool fUndo)
+{
+    return testDir / strprintf("%s%05u.dat", fUndo ? "rev" : "blk", nFile);
+}
+
+static FILE* OpenTestFile(const CDiskBlockPos& pos, bool fUndo)
+{
+    FILE* file = fsbridge::fopen(TestFilePath(pos.nFile, fUndo), "rb+");
+    if (!file)
+        file = fsbridge::fopen(TestFilePath(pos.nFile, fUndo), "wb+");
+    if (file && fseek(file, pos.nPos, SEEK_SET) != 0) {
+        fclose(file);
+        return nullptr;
+    }
+    return file;
+}
+
+static std::string ReadTestFile(int nFile, bool fUndo)
+{
+    std::string str;
+    FILE* file = fsbridge::fopen(TestFilePath(nFile, fUndo), "rb");
+    if (!file)
+        return str;
+    char buf[256];
+    size_t nRead;
+    while ((nRead = fread(buf, 1, sizeof(buf), file)) > 0)
+        str.append(buf, nRead);
+    fclose(file);
+    return str;
+}
+
+static std::vector<unsigned char> Bytes(const std::string& str)
+{
+    return std::vector<unsigned char>(str.begin(), str.end());
+}
+
+BOOST_AUTO_TEST_CASE(blockwritequeue_ordered)
+{
+    fs::create_directories(testDir);
+    {
+        CBlockWriteQueue queue(OpenTestFile, 64);
+
+        // Without a thread, writes happen right away.
+        BOOST_CHECK(queue.Write(CDiskBlockPos(0, 0), false, Bytes("abc")));
+        BOOST_CHECK_EQUAL(ReadTestFile(0, false), "abc");
+
+        // With one, in the order they were queued, also when they overlap.
+        queue.Start();
+        std::string expected = "abc";
+        for (int i = 0; i < 200; i++) {
+            std::string data = strprintf("<%d>", i);
+            BOOST_CHECK(queue.Write(CDiskBlockPos(0, expected.size() - 1), false, Bytes(data)));
+            expected = expected.substr(0, expected.size() - 1) + data;
+            BOOST_CHECK(queue.Write(CDiskBlockPos(0, i), true, Bytes(std::string(1, 'a' + i % 26))));
+        }
+        queue.WaitForFile(0, false);
+        BOOST_CHECK_EQUAL(ReadTestFile(0, false), expected);
+
+        // Truncating commits apply after the writes queued before them.
+        BOOST_CHECK(queue.Write(CDiskBlockPos(1, 0), true, Bytes("0123456789")));
+        BOOST_CHECK(queue.Commit(1, true, true, 4));
+        BOOST_CHECK(queue.Wait());
+        BOOST_CHECK_EQUAL(ReadTestFile(1, true), "0123");
+
+        // Stopping writes out everything still queued.
+        for (int i = 0; i < 100; i++)
+            BOOST_CHECK(queue.Write(CDiskBlockPos(2, i), false, Bytes("x")));
+        queue.Stop();
+        BOOST_CHECK_EQUAL(ReadTestFile(2, false), std::string(100, 'x'));
+        BOOST_CHECK_EQUAL(ReadTestFile(0, true).size(), 200U);
+    }
+    fs::remove_all(testDir);
+}
+
+BOOST_AUTO_TEST_CASE(blockwritequeue_failure)
+{
+    CBlockWriteQueue queue([](const CDiskBlockPos& pos, bool fUndo) { return (FILE*)nullptr; });
+    queue.Start();
+    queue.Write(CDiskBlockPos(0, 0), false, Bytes("abc"));
+    BOOST_CHECK(!queue.Wait());
+    // Once a write failed, everything after fails as well.
+    BOOST_CHECK(!queue.Write(CDiskBlockPos(0, 3), false, Bytes("def")));
+    BOOST_CHECK(!queue.Commit(0, false));
+    queue.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -34,6 +34,7 @@ class CCoinsViewTest : public CCoinsView
 {
     uint256 hashBestBlock_;
     std::map<COutPoint, Coin> map_;
+    CCoinsSetHash setHash_;
 
 public:
     bool GetCoin(const COutPoint& outpoint, Coin& coin) const override
@@ -69,12 +70,20 @@ public:
             hashBestBlock_ = hashBlock;
         return true;
     }
+
+    bool GetSetHash(CCoinsSetHash& setHash) const override
+    {
+        setHash = setHash_;
+        return true;
+    }
+
+    void ApplySetHashDelta(const CCoinsSetHash& delta) override { setHash_ += delta; }
 };
 
 class CCoinsViewCacheTest : public CCoinsViewCache
 {
 public:
-    CCoinsViewCacheTest(CCoinsView* _base) : CCoinsViewCache(_base) {}
+    CCoinsViewCacheTest(CCoinsView* _base, bool fTrackSetHashIn = false) : CCoinsViewCache(_base, fTrackSetHashIn) {}
 
     void SelfTest() const
     {
@@ -95,6 +104,20 @@ public:
 
 } // namespace
 
+//! Check a rolling hash against the unspent coins of a set.
+static void CheckSetHash(const CCoinsSetHash& setHash, const std::map<COutPoint, Coin>& coins)
+{
+    CCoinsSetHash expected;
+    for (const auto& entry : coins) {
+        if (!entry.second.IsSpent())
+            expected.AddCoin(entry.first, entry.second);
+    }
+    BOOST_CHECK_EQUAL(setHash.nTxOuts, expected.nTxOuts);
+    BOOST_CHECK_EQUAL(setHash.nTotalAmount, expected.nTotalAmount);
+    BOOST_CHECK_EQUAL(setHash.nBogoSize, expected.nBogoSize);
+    BOOST_CHECK(setHash.GetHash() == expected.GetHash());
+}
+
 BOOST_FIXTURE_TEST_SUITE(coins_tests, BasicTestingSetup)
 
 static const unsigned int NUM_SIMULATION_ITERATIONS = 40000;
@@ -120,6 +143,8 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     bool found_an_entry = false;
     bool missed_an_entry = false;
     bool uncached_an_entry = false;
+    bool synced_a_cache = false;
+    bool checked_set_hash = false;
 
     // A simple map to track what we expect the cache stack to represent.
     std::map<COutPoint, Coin> result;
@@ -127,7 +152,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     // The cache stack.
     CCoinsViewTest base; // A CCoinsViewTest at the bottom.
     std::vector<CCoinsViewCacheTest*> stack; // A stack of CCoinsViewCaches on top.
-    stack.push_back(new CCoinsViewCacheTest(&base)); // Start with one cache.
+    stack.push_back(new CCoinsViewCacheTest(&base, true)); // Start with one cache, which keeps the rolling hash.
 
     // Use a limited set of random transaction ids, so we do test overwriting entries.
     std::vector<uint256> txids;
@@ -204,6 +229,15 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
             for (const CCoinsViewCacheTest *test : stack) {
                 test->SelfTest();
             }
+
+            // Only the bottom cache keeps the rolling hash; it matches the
+            // expected set when there are no caches on top of it.
+            CCoinsSetHash setHash;
+            BOOST_CHECK_EQUAL(stack.back()->GetSetHash(setHash), stack.size() == 1);
+            if (stack.size() == 1) {
+                CheckSetHash(setHash, result);
+                checked_set_hash = true;
+            }
         }
 
         if (InsecureRandRange(100) == 0) {
@@ -213,6 +247,12 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
                 stack[flushIndex]->Flush();
             }
         }
+        if (InsecureRandRange(100) == 0) {
+            // Every 100 iterations, sync a random cache, evicting down to a random size
+            CCoinsViewCacheTest* cache = stack[InsecureRandRange(stack.size())];
+            cache->Sync(InsecureRandRange(cache->DynamicMemoryUsage() + 1));
+            synced_a_cache = true;
+        }
         if (InsecureRandRange(100) == 0) {
             // Every 100 iterations, change the cache stack.
             if (stack.size() > 0 && InsecureRandBool() == 0) {
@@ -229,7 +269,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
                 } else {
                     removed_all_caches = true;
                 }
-                stack.push_back(new CCoinsViewCacheTest(tip));
+                stack.push_back(new CCoinsViewCacheTest(tip, tip == &base));
                 if (stack.size() == 4) {
                     reached_4_caches = true;
                 }
@@ -237,6 +277,19 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
         }
     }
 
+    // The bottom cache works out the rolling hash from what the caches on
+    // top of it write, and passes it on to the base.
+    if (!stack.empty()) {
+        for (size_t i = stack.size() - 1; i > 0; i--)
+            BOOST_CHECK(stack[i]->Flush());
+        CCoinsSetHash setHash;
+        BOOST_CHECK(stack[0]->GetSetHash(setHash));
+        CheckSetHash(setHash, result);
+        BOOST_CHECK(stack[0]->Flush());
+        BOOST_CHECK(base.GetSetHash(setHash));
+        CheckSetHash(setHash, result);
+    }
+
     // Clean up the stack.
     while (stack.size() > 0) {
         delete stack.back();
@@ -244,6 +297,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     }
 
     // Verify coverage.
+    BOOST_CHECK(checked_set_hash);
     BOOST_CHECK(removed_all_caches);
     BOOST_CHECK(reached_4_caches);
     BOOST_CHECK(added_an_entry);
@@ -253,6 +307,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(found_an_entry);
     BOOST_CHECK(missed_an_entry);
     BOOST_CHECK(uncached_an_entry);
+    BOOST_CHECK(synced_a_cache);
 }
 
 // Store of all necessary tx and undo data for next test
@@ -855,4 +910,123 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_sync)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+
+    std::vector<COutPoint> outpoints;
+    // Enough entries to fill several of the cache's memory chunks.
+    for (int i = 0; i < 10000; i++) {
+        outpoints.emplace_back(InsecureRand256(), 0);
+        Coin coin;
+        SetCoinsValue(VALUE1 + i, coin);
+        cache.AddCoin(outpoints.back(), std::move(coin), false);
+    }
+    cache.SetBestBlock(InsecureRand256());
+
+    // Modified entries are written to the base and stay cached, unmodified.
+    BOOST_CHECK(cache.Sync(std::numeric_limits<size_t>::max()));
+    BOOST_CHECK(base.GetBestBlock() == cache.GetBestBlock());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), outpoints.size());
+    for (const COutPoint& out : outpoints) {
+        Coin coin;
+        BOOST_CHECK(base.GetCoin(out, coin));
+        BOOST_CHECK_EQUAL(cache.map().at(out).flags, 0);
+    }
+    cache.SelfTest();
+
+    // Spent entries are written to the base and dropped.
+    BOOST_CHECK(cache.SpendCoin(outpoints[0]));
+    BOOST_CHECK(cache.Sync(std::numeric_limits<size_t>::max()));
+    BOOST_CHECK_EQUAL(cache.map().count(outpoints[0]), 0U);
+    Coin spent;
+    BOOST_CHECK(!base.GetCoin(outpoints[0], spent) || spent.IsSpent());
+    cache.SelfTest();
+
+    // Entries used since the previous sync are evicted last.
+    for (size_t i = 1; i < 5000; i++) {
+        cache.AccessCoin(outpoints[i]);
+    }
+    size_t usage = cache.DynamicMemoryUsage();
+    BOOST_CHECK(cache.Sync(usage * 3 / 4));
+    BOOST_CHECK(cache.DynamicMemoryUsage() < usage);
+    BOOST_CHECK(cache.GetCacheSize() < outpoints.size() - 1);
+    for (size_t i = 1; i < 5000; i++) {
+        BOOST_CHECK(cache.HaveCoinInCache(outpoints[i]));
+    }
+    cache.SelfTest();
+
+    // If that is not enough, they are evicted too.
+    BOOST_CHECK(cache.Sync(0));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    cache.SelfTest();
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_prefetch)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+
+    // A prefetched coin is cached unmodified.
+    COutPoint out1(InsecureRand256(), 0);
+    Coin coin1;
+    SetCoinsValue(VALUE1, coin1);
+    cache.AddPrefetchedCoin(out1, std::move(coin1));
+    BOOST_CHECK(cache.HaveCoinInCache(out1));
+    BOOST_CHECK_EQUAL(cache.map().at(out1).flags, 0);
+    BOOST_CHECK_EQUAL(cache.AccessCoin(out1).out.nValue, VALUE1);
+    cache.SelfTest();
+
+    // It does not replace an entry that is already cached, even a spent one.
+    COutPoint out2(InsecureRand256(), 0);
+    Coin coin2;
+    SetCoinsValue(VALUE2, coin2);
+    cache.AddCoin(out2, std::move(coin2), true);
+    BOOST_CHECK(cache.SpendCoin(out2));
+    Coin stale;
+    SetCoinsValue(VALUE3, stale);
+    cache.AddPrefetchedCoin(out2, std::move(stale));
+    BOOST_CHECK(!cache.HaveCoin(out2));
+    SetCoinsValue(VALUE3, stale);
+    cache.AddPrefetchedCoin(out1, std::move(stale));
+    BOOST_CHECK_EQUAL(cache.AccessCoin(out1).out.nValue, VALUE1);
+    cache.SelfTest();
+}
+
+BOOST_FIXTURE_TEST_CASE(ccoins_db_background_write, TestingSetup)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewCache cache(&db);
+
+    COutPoint out(InsecureRand256(), 0);
+    Coin coin;
+    SetCoinsValue(VALUE1, coin);
+    cache.AddCoin(out, std::move(coin), false);
+    uint256 hashBlock = InsecureRand256();
+    cache.SetBestBlock(hashBlock);
+
+    // Whether or not the write has finished yet, the view reflects it.
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(db.HaveCoin(out));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    BOOST_CHECK(db.WaitForWrite());
+    BOOST_CHECK(db.HaveCoin(out));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    // Written coins no longer count against the cache.
+    BOOST_CHECK_EQUAL(db.PendingMemoryUsage(), 0U);
+
+    BOOST_CHECK(cache.SpendCoin(out));
+    hashBlock = InsecureRand256();
+    cache.SetBestBlock(hashBlock);
+    BOOST_CHECK(cache.Sync(std::numeric_limits<size_t>::max()));
+    BOOST_CHECK(!db.HaveCoin(out));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+
+    std::unique_ptr<CCoinsViewCursor> cursor(db.Cursor());
+    BOOST_CHECK(cursor->GetBestBlock() == hashBlock);
+    BOOST_CHECK(!cursor->Valid());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
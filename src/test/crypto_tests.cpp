@@ -10,7 +10,9 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/muhash.h"
 #include "random.h"
+#include "streams.h"
 #include "utilstrencodings.h"
 #include "test/test_bitcoin.h"
 
@@ -230,6 +232,23 @@ BOOST_AUTO_TEST_CASE(ripemd160_testvectors) {
     TestRIPEMD160(test1, "464243587bd146ea835cdf57bdae582f25ec45f1");
 }
 
+BOOST_AUTO_TEST_CASE(ripemd160_32_multilane) {
+    // Every batch size up to two full groups of lanes plus a tail must match the scalar hasher.
+    for (size_t blocks = 0; blocks <= 9; blocks++) {
+        std::vector<unsigned char> in(blocks * 32);
+        for (size_t i = 0; i < in.size(); i++) {
+            in[i] = InsecureRandBits(8);
+        }
+        std::vector<unsigned char> out(blocks * CRIPEMD160::OUTPUT_SIZE);
+        RIPEMD160_32(out.data(), in.data(), blocks);
+        for (size_t i = 0; i < blocks; i++) {
+            unsigned char expected[CRIPEMD160::OUTPUT_SIZE];
+            CRIPEMD160().Write(&in[i * 32], 32).Finalize(expected);
+            BOOST_CHECK(std::equal(expected, expected + CRIPEMD160::OUTPUT_SIZE, &out[i * CRIPEMD160::OUTPUT_SIZE]));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sha1_testvectors) {
     TestSHA1("", "da39a3ee5e6b4b0d3255bfef95601890afd80709");
     TestSHA1("abc", "a9993e364706816aba3e25717850c26c9cd0d89d");
@@ -483,6 +502,75 @@ BOOST_AUTO_TEST_CASE(chacha20_testvector)
                  "fab78c9");
 }
 
+static MuHash3072 FromInt(unsigned char i)
+{
+    unsigned char tmp[32] = {i, 0};
+    MuHash3072 acc;
+    acc.Insert(tmp, sizeof(tmp));
+    return acc;
+}
+
+static uint256 Finalized(const MuHash3072& acc)
+{
+    uint256 hash;
+    acc.Finalize(hash.begin());
+    return hash;
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    // The order in which elements are added and removed does not matter.
+    FastRandomContext ctx;
+    for (int iter = 0; iter < 10; ++iter) {
+        int table[4];
+        for (int i = 0; i < 4; ++i)
+            table[i] = ctx.randbits(3);
+        uint256 first;
+        for (int order = 0; order < 4; ++order) {
+            MuHash3072 acc;
+            for (int i = 0; i < 4; ++i) {
+                int t = table[i ^ order];
+                if (t & 4)
+                    acc /= FromInt(t & 3);
+                else
+                    acc *= FromInt(t & 3);
+            }
+            if (order == 0)
+                first = Finalized(acc);
+            else
+                BOOST_CHECK(Finalized(acc) == first);
+        }
+    }
+
+    // Removing what was added gives the empty set.
+    MuHash3072 x = FromInt(0);
+    MuHash3072 y = FromInt(1);
+    MuHash3072 z;
+    z *= x;
+    z *= y;
+    y *= x;
+    z /= y;
+    BOOST_CHECK(Finalized(z) == Finalized(MuHash3072()));
+    unsigned char data[32] = {0};
+    z.Insert(data, sizeof(data));
+    BOOST_CHECK(Finalized(z) == Finalized(x));
+    z.Remove(data, sizeof(data));
+    BOOST_CHECK(Finalized(z) == Finalized(MuHash3072()));
+
+    MuHash3072 acc = FromInt(0);
+    acc *= FromInt(1);
+    acc /= FromInt(2);
+    BOOST_CHECK_EQUAL(Finalized(acc).GetHex(), "10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863");
+
+    // The state serializes without losing anything.
+    CDataStream ss(SER_DISK, 0);
+    ss << acc;
+    BOOST_CHECK_EQUAL(ss.size(), 2 * Num3072::BYTE_SIZE);
+    MuHash3072 acc2;
+    ss >> acc2;
+    BOOST_CHECK(Finalized(acc2) == Finalized(acc));
+}
+
 BOOST_AUTO_TEST_CASE(countbits_tests)
 {
     FastRandomContext ctx;
@@ -77,6 +77,39 @@ BOOST_AUTO_TEST_CASE(dbwrapper_batch)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_options)
+{
+    CDBOptions dbOptions;
+    std::string strError;
+    BOOST_CHECK(ParseDBOptions("", dbOptions, strError));
+    BOOST_CHECK_EQUAL(dbOptions.ToString(), CDBOptions().ToString());
+
+    BOOST_CHECK(ParseDBOptions("lowmem,maxopenfiles=200", dbOptions, strError));
+    BOOST_CHECK_EQUAL(dbOptions.nWriteBufferPercent, 10);
+    BOOST_CHECK_EQUAL(dbOptions.nMaxOpenFiles, 200);
+    BOOST_CHECK(ParseDBOptions("default,bloombits=0,blocksize=65536", dbOptions, strError));
+    BOOST_CHECK_EQUAL(dbOptions.nWriteBufferPercent, 25);
+    BOOST_CHECK_EQUAL(dbOptions.nBloomBits, 0);
+    BOOST_CHECK_EQUAL(dbOptions.nBlockSize, 65536U);
+
+    // Invalid options leave the options untouched.
+    for (const char* strInvalid : {"highmem", "bloombits", "bloombits=x", "bloombits=-1", "blocksize=100", "blockcache=60,writebuffer=25", "nosuchoption=1"}) {
+        BOOST_CHECK(!ParseDBOptions(strInvalid, dbOptions, strError));
+        BOOST_CHECK_EQUAL(dbOptions.nBlockSize, 65536U);
+    }
+
+    // Databases work the same with any options.
+    BOOST_CHECK(ParseDBOptions("lowmem,bloombits=0", dbOptions, strError));
+    fs::path ph = fs::temp_directory_path() / fs::unique_path();
+    CDBWrapper dbw(ph, (1 << 20), true, false, true, dbOptions);
+    for (uint32_t i = 0; i < 1000; i++)
+        BOOST_CHECK(dbw.Write(i, i * 3));
+    for (uint32_t i = 0; i < 1000; i++) {
+        uint32_t value;
+        BOOST_CHECK(dbw.Read(i, value) && value == i * 3);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
 {
     // Perform tests both obfuscated and non-obfuscated.
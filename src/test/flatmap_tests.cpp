@@ -0,0 +1,99 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "flatmap.h"
+
+#include "test/test_bitcoin.h"
+
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(flatmap_tests, BasicTestingSetup)
+
+/** Hasher with few distinct values, so that probe sequences get long. */
+struct CollidingHasher
+{
+    size_t operator()(int key) const { return key % 61; }
+};
+
+typedef flatmap<int, int, CollidingHasher> TestMap;
+
+static void CheckEqual(const TestMap& map, const std::map<int, int>& expected)
+{
+    BOOST_CHECK_EQUAL(map.size(), expected.size());
+    size_t count = 0;
+    for (const TestMap::value_type& entry : map) {
+        auto it = expected.find(entry.first);
+        BOOST_CHECK(it != expected.end() && it->second == entry.second);
+        count++;
+    }
+    BOOST_CHECK_EQUAL(count, expected.size());
+}
+
+BOOST_AUTO_TEST_CASE(flatmap_random)
+{
+    TestMap map;
+    std::map<int, int> expected;
+    for (int i = 0; i < 20000; i++) {
+        int key = InsecureRandRange(2000);
+        switch (InsecureRandRange(4)) {
+        case 0: {
+            auto ret = map.emplace(key, i);
+            BOOST_CHECK_EQUAL(ret.second, expected.emplace(key, i).second);
+            BOOST_CHECK_EQUAL(ret.first->first, key);
+            break;
+        }
+        case 1:
+            map[key] = i;
+            expected[key] = i;
+            break;
+        case 2:
+            BOOST_CHECK_EQUAL(map.erase(key), expected.erase(key));
+            break;
+        case 3:
+            BOOST_CHECK_EQUAL(map.count(key), expected.count(key));
+            if (expected.count(key)) {
+                BOOST_CHECK_EQUAL(map.at(key), expected.at(key));
+            }
+            break;
+        }
+    }
+    CheckEqual(map, expected);
+
+    // Erasing while iterating visits every entry once.
+    for (TestMap::iterator it = map.begin(); it != map.end();) {
+        if (it->first % 2) {
+            BOOST_CHECK_EQUAL(expected.erase(it->first), 1U);
+            map.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    CheckEqual(map, expected);
+
+    TestMap moved(std::move(map));
+    BOOST_CHECK(map.empty());
+    CheckEqual(moved, expected);
+    moved.clear();
+    BOOST_CHECK(moved.begin() == moved.end());
+    BOOST_CHECK_EQUAL(moved.chunk_count(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(flatmap_stable_references)
+{
+    TestMap map;
+    int& first = map[1];
+    first = 42;
+    // Erased entries are reused, and the index grows, without moving entries.
+    for (int i = 2; i < 5000; i++) {
+        map[i] = i;
+        if (i % 3 == 0) map.erase(i - 1);
+    }
+    BOOST_CHECK_EQUAL(&first, &map.at(1));
+    BOOST_CHECK_EQUAL(first, 42);
+    BOOST_CHECK(map.chunk_count() * TestMap::ENTRIES_PER_CHUNK < 5000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -147,4 +147,18 @@ BOOST_AUTO_TEST_CASE(siphash)
     }
 }
 
+BOOST_AUTO_TEST_CASE(hash160_batch)
+{
+    std::vector<std::vector<unsigned char>> vobj;
+    for (int i = 0; i < 7; i++) {
+        vobj.push_back(std::vector<unsigned char>(33 * i, i));
+    }
+    std::vector<uint160> vhash = Hash160Batch(vobj);
+    BOOST_CHECK_EQUAL(vhash.size(), vobj.size());
+    for (size_t i = 0; i < vobj.size(); i++) {
+        BOOST_CHECK(vhash[i] == Hash160(vobj[i]));
+    }
+    BOOST_CHECK(Hash160Batch(std::vector<std::vector<unsigned char>>()).empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
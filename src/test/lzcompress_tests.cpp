@@ -0,0 +1,81 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "lzcompress.h"
+#include "random.h"
+#include "test/test_bitcoin.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(lzcompress_tests, BasicTestingSetup)
+
+static void CheckRoundTrip(const std::vector<unsigned char>& data)
+{
+    std::vector<unsigned char> compressed;
+    LZCompress(data.data(), data.size(), compressed);
+    std::vector<unsigned char> decompressed(data.size());
+    BOOST_CHECK(LZDecompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()));
+    BOOST_CHECK(decompressed == data);
+}
+
+BOOST_AUTO_TEST_CASE(lzcompress_roundtrip)
+{
+    // Empty and short inputs are stored as literals only.
+    for (size_t nSize = 0; nSize < 32; nSize++)
+        CheckRoundTrip(std::vector<unsigned char>(nSize, 'a'));
+
+    // Random data does not compress, but must survive.
+    CheckRoundTrip(insecure_rand_ctx.randbytes(100000));
+
+    // Repetitive data with long matches, overlapping matches and long
+    // literal runs in between.
+    std::vector<unsigned char> data;
+    for (int i = 0; i < 200; i++) {
+        std::vector<unsigned char> noise = insecure_rand_ctx.randbytes(InsecureRandRange(400));
+        data.insert(data.end(), noise.begin(), noise.end());
+        data.insert(data.end(), InsecureRandRange(1000), (unsigned char)i);
+        data.insert(data.end(), noise.begin(), noise.end());
+    }
+    CheckRoundTrip(data);
+
+    std::vector<unsigned char> compressed;
+    LZCompress(data.data(), data.size(), compressed);
+    BOOST_CHECK(compressed.size() < data.size() * 3 / 4);
+}
+
+BOOST_AUTO_TEST_CASE(lzcompress_malformed)
+{
+    std::vector<unsigned char> data(5000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = i % 7 == 0 ? InsecureRandBits(8) : i % 13;
+    std::vector<unsigned char> compressed;
+    LZCompress(data.data(), data.size(), compressed);
+    std::vector<unsigned char> out(data.size() + 1);
+
+    // The output size must match exactly.
+    BOOST_CHECK(LZDecompress(compressed.data(), compressed.size(), out.data(), data.size()));
+    BOOST_CHECK(!LZDecompress(compressed.data(), compressed.size(), out.data(), data.size() - 1));
+    BOOST_CHECK(!LZDecompress(compressed.data(), compressed.size(), out.data(), data.size() + 1));
+
+    // Truncated input is rejected.
+    for (size_t nSize = 0; nSize < compressed.size(); nSize += 1 + nSize / 8)
+        BOOST_CHECK(!LZDecompress(compressed.data(), nSize, out.data(), data.size()));
+
+    // A match reaching before the start of the output is rejected.
+    const unsigned char farMatch[] = {0x10, 'x', 0x02, 0x00, 0x00};
+    BOOST_CHECK(!LZDecompress(farMatch, sizeof(farMatch), out.data(), 5));
+    const unsigned char zeroDistance[] = {0x10, 'x', 0x00, 0x00, 0x00};
+    BOOST_CHECK(!LZDecompress(zeroDistance, sizeof(zeroDistance), out.data(), 5));
+
+    // Corrupted input never writes out of bounds, whatever it decodes to.
+    for (int i = 0; i < 1000; i++) {
+        std::vector<unsigned char> corrupted = compressed;
+        corrupted[InsecureRandRange(corrupted.size())] = InsecureRandBits(8);
+        LZDecompress(corrupted.data(), corrupted.size(), out.data(), data.size());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
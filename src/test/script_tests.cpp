@@ -12,6 +12,7 @@
 #include "script/sign.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "validation.h"
 #include "test/test_bitcoin.h"
 #include "rpc/server.h"
 
@@ -1079,6 +1080,51 @@ BOOST_AUTO_TEST_CASE(script_CHECKMULTISIG12)
     BOOST_CHECK_MESSAGE(err == SCRIPT_ERR_EVAL_FALSE, ScriptErrorString(err));
 }
 
+BOOST_AUTO_TEST_CASE(script_check_signature_outcomes)
+{
+    // Scripts checked through CScriptCheck whose outcome depends on a
+    // failing signature.
+    CKey key1, key2, key3;
+    key1.MakeNewKey(true);
+    key2.MakeNewKey(true);
+    key3.MakeNewKey(true);
+
+    CScript scriptPubKey12;
+    scriptPubKey12 << OP_1 << ToByteVector(key1.GetPubKey()) << ToByteVector(key2.GetPubKey()) << OP_2 << OP_CHECKMULTISIG;
+    CMutableTransaction txFrom12 = BuildCreditingTransaction(scriptPubKey12);
+    CMutableTransaction txTo12 = BuildSpendingTransaction(CScript(), CScriptWitness(), txFrom12);
+
+    // The signature for key2 is first tried against key1.
+    txTo12.vin[0].scriptSig = sign_multisig(scriptPubKey12, key2, txTo12);
+    CTransaction tx12(txTo12);
+    PrecomputedTransactionData txdata12(tx12);
+    CScriptCheck check12(scriptPubKey12, txFrom12.vout[0].nValue, tx12, 0, gFlags, false, &txdata12);
+    BOOST_CHECK(check12());
+    BOOST_CHECK_MESSAGE(check12.GetScriptError() == SCRIPT_ERR_OK, ScriptErrorString(check12.GetScriptError()));
+
+    txTo12.vin[0].scriptSig = sign_multisig(scriptPubKey12, key3, txTo12);
+    CTransaction tx12bad(txTo12);
+    PrecomputedTransactionData txdata12bad(tx12bad);
+    CScriptCheck check12bad(scriptPubKey12, txFrom12.vout[0].nValue, tx12bad, 0, gFlags, false, &txdata12bad);
+    BOOST_CHECK(!check12bad());
+    BOOST_CHECK_MESSAGE(check12bad.GetScriptError() == SCRIPT_ERR_EVAL_FALSE, ScriptErrorString(check12bad.GetScriptError()));
+
+    // A script that requires a signature to be invalid.
+    CScript scriptPubKeyNot;
+    scriptPubKeyNot << ToByteVector(key1.GetPubKey()) << OP_CHECKSIG << OP_NOT;
+    CMutableTransaction txFromNot = BuildCreditingTransaction(scriptPubKeyNot);
+    CMutableTransaction txToNot = BuildSpendingTransaction(CScript(), CScriptWitness(), txFromNot);
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(key3.Sign(SignatureHash(scriptPubKeyNot, txToNot, 0, SIGHASH_ALL, 0, SIGVERSION_BASE), vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    txToNot.vin[0].scriptSig = CScript() << vchSig;
+    CTransaction txNot(txToNot);
+    PrecomputedTransactionData txdataNot(txNot);
+    CScriptCheck checkNot(scriptPubKeyNot, txFromNot.vout[0].nValue, txNot, 0, gFlags, false, &txdataNot);
+    BOOST_CHECK(checkNot());
+    BOOST_CHECK_MESSAGE(checkNot.GetScriptError() == SCRIPT_ERR_OK, ScriptErrorString(checkNot.GetScriptError()));
+}
+
 BOOST_AUTO_TEST_CASE(script_CHECKMULTISIG23)
 {
     ScriptError err;
@@ -226,6 +226,12 @@ BOOST_AUTO_TEST_CASE(GetTxSigOpCost)
         BuildTxs(spendingTx, coins, creationTx, scriptPubKey, scriptSig, scriptWitness);
         assert(GetTransactionSigOpCost(CTransaction(spendingTx), coins, flags) == 2);
         assert(VerifyWithFlag(creationTx, spendingTx, flags) == SCRIPT_ERR_CHECKMULTISIGVERIFY);
+
+        // The spent coins can also be given directly, as ConnectBlock does.
+        std::vector<Coin> spentCoins(1, coins.AccessCoin(spendingTx.vin[0].prevout));
+        assert(GetTransactionSigOpCost(CTransaction(spendingTx), spentCoins, flags) == 2);
+        assert(GetTransactionSigOpCost(CTransaction(spendingTx), spentCoins, flags & ~SCRIPT_VERIFY_WITNESS) == 0);
+        assert(GetP2SHSigOpCount(CTransaction(spendingTx), spentCoins) == GetP2SHSigOpCount(CTransaction(spendingTx), coins));
     }
 }
 
@@ -71,6 +71,55 @@ BOOST_AUTO_TEST_CASE(streams_vector_writer)
     vch.clear();
 }
 
+BOOST_AUTO_TEST_CASE(bitstream_reader_writer)
+{
+    CDataStream stream(SER_NETWORK, INIT_PROTO_VERSION);
+
+    {
+        BitStreamWriter<CDataStream> bit_writer(stream);
+        bit_writer.Write(0, 1);
+        bit_writer.Write(2, 2);
+        bit_writer.Write(6, 3);
+        bit_writer.Write(11, 4);
+        bit_writer.Write(1, 5);
+        bit_writer.Write(32, 6);
+        bit_writer.Write(7, 7);
+        bit_writer.Write(30497, 16);
+    }
+    // The writer flushed the last partial byte when it went out of scope.
+    BOOST_CHECK_EQUAL(stream.size(), 6);
+
+    CDataStream serialized_int1(SER_NETWORK, INIT_PROTO_VERSION);
+    serialized_int1 << (uint32_t)0x7700C35A; // NOTE: Serialized as LE
+    CDataStream serialized_int2(SER_NETWORK, INIT_PROTO_VERSION);
+    serialized_int2 << (uint16_t)0x1072; // NOTE: Serialized as LE
+    BOOST_CHECK(std::equal(stream.begin(), stream.begin() + 4, serialized_int1.begin()));
+    BOOST_CHECK(std::equal(stream.begin() + 4, stream.begin() + 6, serialized_int2.begin()));
+
+    BitStreamReader<CDataStream> bit_reader(stream);
+    BOOST_CHECK_EQUAL(bit_reader.Read(1), 0);
+    BOOST_CHECK_EQUAL(bit_reader.Read(2), 2);
+    BOOST_CHECK_EQUAL(bit_reader.Read(3), 6);
+    BOOST_CHECK_EQUAL(bit_reader.Read(4), 11);
+    BOOST_CHECK_EQUAL(bit_reader.Read(5), 1);
+    BOOST_CHECK_EQUAL(bit_reader.Read(6), 32);
+    BOOST_CHECK_EQUAL(bit_reader.Read(7), 7);
+    BOOST_CHECK_EQUAL(bit_reader.Read(16), 30497);
+    BOOST_CHECK_THROW(bit_reader.Read(8), std::ios_base::failure);
+
+    // Values that span more than one byte at an offset.
+    stream.clear();
+    {
+        BitStreamWriter<CDataStream> bit_writer(stream);
+        bit_writer.Write(5, 3);
+        bit_writer.Write(0xfedcba9876543210, 64);
+    }
+    BOOST_CHECK_EQUAL(stream.size(), 9);
+    BitStreamReader<CDataStream> bit_reader2(stream);
+    BOOST_CHECK_EQUAL(bit_reader2.Read(3), 5);
+    BOOST_CHECK_EQUAL(bit_reader2.Read(64), 0xfedcba9876543210);
+}
+
 BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
 {
     std::vector<char> in;
@@ -120,4 +169,32 @@ BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
             std::string(ds.begin(), ds.end()));  
 }         
 
+BOOST_AUTO_TEST_CASE(streams_xor_obfuscate)
+{
+    // The word-wise kernel must match XORing byte by byte, for any length,
+    // key size and starting key phase.
+    for (size_t nKeySize : {1, 3, 8}) {
+        std::vector<unsigned char> key = insecure_rand_ctx.randbytes(nKeySize);
+        for (size_t nSize = 0; nSize < 100; nSize++) {
+            for (size_t nOffset = 0; nOffset < nKeySize + 2; nOffset++) {
+                std::vector<unsigned char> data = insecure_rand_ctx.randbytes(nSize);
+                std::vector<unsigned char> expected = data;
+                for (size_t i = 0; i < nSize; i++)
+                    expected[i] ^= key[(nOffset + i) % nKeySize];
+                XorObfuscate(data.data(), data.size(), key.data(), key.size(), nOffset);
+                BOOST_CHECK(data == expected);
+            }
+        }
+    }
+
+    // Misaligned data works too.
+    std::vector<unsigned char> key = insecure_rand_ctx.randbytes(8);
+    std::vector<unsigned char> data = insecure_rand_ctx.randbytes(1000);
+    std::vector<unsigned char> expected = data;
+    for (size_t i = 3; i < data.size(); i++)
+        expected[i] ^= key[(5 + i - 3) % 8];
+    XorObfuscate(data.data() + 3, data.size() - 3, key.data(), key.size(), 5);
+    BOOST_CHECK(data == expected);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
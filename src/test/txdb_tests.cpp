@@ -0,0 +1,116 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "pow.h"
+#include "txdb.h"
+#include "test/test_bitcoin.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txdb_tests, BasicTestingSetup)
+
+struct BlockIndexLoader
+{
+    std::map<uint256, std::unique_ptr<CBlockIndex>> mapIndex;
+
+    CBlockIndex* Insert(const uint256& hash)
+    {
+        if (hash.IsNull())
+            return nullptr;
+        auto it = mapIndex.emplace(hash, nullptr).first;
+        if (!it->second) {
+            it->second.reset(new CBlockIndex());
+            it->second->phashBlock = &it->first;
+        }
+        return it->second.get();
+    }
+
+    bool Load(CBlockTreeDB& db, const Consensus::Params& params, int nTrustedHeight, int nThreads)
+    {
+        mapIndex.clear();
+        return db.LoadBlockIndexGuts(params, [this](const uint256& hash) { return Insert(hash); }, nTrustedHeight, nThreads);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(txdb_load_block_index)
+{
+    Consensus::Params params = Params().GetConsensus();
+    params.powLimit = uint256S("7fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+
+    // A chain of headers with (easy) valid proof of work.
+    std::vector<CBlockHeader> vHeaders;
+    std::vector<uint256> vHashes;
+    for (int i = 0; i < 200; i++) {
+        CBlockHeader header;
+        header.nVersion = 4;
+        header.hashPrevBlock = vHashes.empty() ? uint256() : vHashes.back();
+        header.nTime = 1500000000 + i;
+        header.nBits = 0x207fffff;
+        while (!CheckProofOfWork(header.GetHash(), header.nBits, params))
+            header.nNonce++;
+        vHeaders.push_back(header);
+        vHashes.push_back(header.GetHash());
+    }
+
+    CBlockTreeDB db(1 << 20, true);
+    std::vector<std::unique_ptr<CBlockIndex>> vIndex;
+    std::vector<const CBlockIndex*> vWrite;
+    for (size_t i = 0; i < vHeaders.size(); i++) {
+        vIndex.emplace_back(new CBlockIndex(vHeaders[i]));
+        vIndex.back()->phashBlock = &vHashes[i];
+        vIndex.back()->nHeight = i;
+        vIndex.back()->pprev = i ? vIndex[i - 1].get() : nullptr;
+        vWrite.push_back(vIndex.back().get());
+    }
+    BOOST_REQUIRE(db.WriteBatchSync(std::vector<std::pair<int, const CBlockFileInfo*>>(), 0, vWrite));
+
+    for (int nThreads : {1, 4}) {
+        BlockIndexLoader loader;
+        BOOST_CHECK(loader.Load(db, params, -1, nThreads));
+        BOOST_CHECK_EQUAL(loader.mapIndex.size(), vHeaders.size());
+        for (size_t i = 0; i < vHeaders.size(); i++) {
+            const CBlockIndex* pindex = loader.mapIndex[vHashes[i]].get();
+            BOOST_CHECK_EQUAL(pindex->nHeight, (int)i);
+            BOOST_CHECK(pindex->GetBlockHeader().GetHash() == vHashes[i]);
+            BOOST_CHECK(pindex->pprev == (i ? loader.mapIndex[vHashes[i - 1]].get() : nullptr));
+        }
+    }
+
+    // An entry without valid proof of work is only accepted at or below the trusted height.
+    CBlockHeader weak = vHeaders[150];
+    weak.nBits = 0x1d00ffff;
+    BOOST_REQUIRE(!CheckProofOfWork(weak.GetHash(), weak.nBits, params));
+    const uint256 hashWeak = weak.GetHash();
+    std::unique_ptr<CBlockIndex> pweak(new CBlockIndex(weak));
+    pweak->phashBlock = &hashWeak;
+    pweak->nHeight = 150;
+    pweak->pprev = vIndex[149].get();
+    BOOST_REQUIRE(db.WriteBatchSync(std::vector<std::pair<int, const CBlockFileInfo*>>(), 0, std::vector<const CBlockIndex*>{pweak.get()}));
+    BlockIndexLoader loader;
+    BOOST_CHECK(!loader.Load(db, params, -1, 4));
+    BOOST_CHECK(!loader.Load(db, params, 149, 4));
+    BOOST_CHECK(loader.Load(db, params, 150, 4));
+    BOOST_CHECK_EQUAL(loader.mapIndex.size(), vHeaders.size() + 1);
+
+    // An entry that does not hash to its key is never accepted.
+    std::unique_ptr<CBlockIndex> pbad(new CBlockIndex(vHeaders[150]));
+    const uint256 hashBad = uint256S("0123");
+    pbad->phashBlock = &hashBad;
+    pbad->nHeight = 150;
+    pbad->pprev = vIndex[149].get();
+    BOOST_REQUIRE(db.WriteBatchSync(std::vector<std::pair<int, const CBlockFileInfo*>>(), 0, std::vector<const CBlockIndex*>{pbad.get()}));
+    BOOST_CHECK(!loader.Load(db, params, -1, 4));
+    BOOST_CHECK(!loader.Load(db, params, 150, 4));
+    BOOST_CHECK(!loader.Load(db, params, 1000, 1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
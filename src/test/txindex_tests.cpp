@@ -0,0 +1,250 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "index/txindex.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "test/test_bitcoin.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txindex_tests, TestingSetup)
+
+/** An index that records the heights of the blocks it is given, and can be held inside WriteBlock. */
+class TestIndex final : public BaseIndex
+{
+private:
+    const std::unique_ptr<DB> db;
+    std::mutex cs;
+    std::condition_variable cond;
+    bool fHold;
+    bool fHeld;
+    std::vector<int> vHeights;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, CDBBatch& batch) override
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        vHeights.push_back(pindex->nHeight);
+        fHeld = fHold;
+        cond.notify_all();
+        cond.wait(lock, [this] { return !fHold; });
+        fHeld = false;
+        return true;
+    }
+    DB& GetDB() const override { return *db; }
+    const char* GetName() const override { return "testindex"; }
+
+public:
+    explicit TestIndex(bool fWipe) :
+        db(new DB(GetDataDir() / "indexes" / "testindex", 1 << 20, false, fWipe)), fHold(false), fHeld(false) {}
+
+    using BaseIndex::BlockConnected;
+
+    std::vector<int> GetHeights()
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        return vHeights;
+    }
+
+    uint256 GetBestBlock() const
+    {
+        uint256 hash;
+        db->ReadBestBlock(hash);
+        return hash;
+    }
+
+    //! Make the next WriteBlock wait for Release, and return once the thread is in it.
+    void HoldNextBlock() { std::lock_guard<std::mutex> lock(cs); fHold = true; }
+    void WaitUntilHeld() { std::unique_lock<std::mutex> lock(cs); cond.wait(lock, [this] { return fHeld; }); }
+    void Release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fHold = false;
+        }
+        cond.notify_all();
+    }
+};
+
+/** Wait for an index to catch up with the active chain. */
+static bool WaitForSync(BaseIndex& index)
+{
+    for (int i = 0; i < 1000; i++) {
+        if (index.BlockUntilSyncedToCurrentChain())
+            return true;
+        MilliSleep(10);
+    }
+    return false;
+}
+
+/**
+ * Add a block on top of the active chain. Its data is not on disk, so an
+ * index catching up skips it like a block below a UTXO snapshot, and only
+ * indexes it if it is handed the block by BlockConnected.
+ */
+static CBlockIndex* ConnectFakeBlock()
+{
+    AssertLockHeld(cs_main);
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    CBlockIndex* pindex = new CBlockIndex();
+    BlockMap::iterator it = mapBlockIndex.insert(std::make_pair(InsecureRand256(), pindex)).first;
+    pindex->phashBlock = &it->first;
+    pindex->pprev = pindexPrev;
+    pindex->nHeight = pindexPrev->nHeight + 1;
+    pindex->nStatus = BLOCK_VALID_SCRIPTS;
+    pindex->BuildSkip();
+    chainActive.SetTip(pindex);
+    return pindex;
+}
+
+BOOST_AUTO_TEST_CASE(baseindex_catch_up_and_resume)
+{
+    {
+        LOCK(cs_main);
+        for (int i = 0; i < 10; i++)
+            ConnectFakeBlock();
+    }
+
+    // Catching up, the index reads the genesis block from disk and skips the
+    // blocks it has no data of.
+    {
+        TestIndex index(true);
+        BOOST_CHECK(!index.BlockUntilSyncedToCurrentChain());
+        index.Start();
+        BOOST_REQUIRE(WaitForSync(index));
+        BOOST_CHECK(index.GetHeights() == std::vector<int>{0});
+        BOOST_CHECK(index.GetBestBlock() == chainActive.Tip()->GetBlockHash());
+
+        // Up to date, it follows BlockConnected.
+        {
+            LOCK(cs_main);
+            CBlockIndex* pindex = ConnectFakeBlock();
+            index.BlockConnected(std::make_shared<const CBlock>(), pindex, {});
+        }
+        BOOST_REQUIRE(WaitForSync(index));
+        BOOST_CHECK(index.GetHeights() == std::vector<int>({0, 11}));
+        BOOST_CHECK(index.GetBestBlock() == chainActive.Tip()->GetBlockHash());
+        index.Stop();
+    }
+
+    // After a restart it resumes from its best block, rather than from the
+    // genesis block.
+    {
+        LOCK(cs_main);
+        ConnectFakeBlock();
+    }
+    {
+        TestIndex index(false);
+        index.Start();
+        BOOST_REQUIRE(WaitForSync(index));
+        BOOST_CHECK(index.GetHeights().empty());
+        BOOST_CHECK(index.GetBestBlock() == chainActive.Tip()->GetBlockHash());
+        index.Stop();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(baseindex_queue_overflow)
+{
+    TestIndex index(true);
+    index.Start();
+    BOOST_REQUIRE(WaitForSync(index));
+
+    // Hold the thread in the first block, and connect more blocks than the
+    // queue takes.
+    index.HoldNextBlock();
+    {
+        LOCK(cs_main);
+        index.BlockConnected(std::make_shared<const CBlock>(), ConnectFakeBlock(), {});
+    }
+    index.WaitUntilHeld();
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i <= MAX_INDEX_QUEUE_BLOCKS; i++)
+            index.BlockConnected(std::make_shared<const CBlock>(), ConnectFakeBlock(), {});
+    }
+    BOOST_CHECK(!index.BlockUntilSyncedToCurrentChain());
+
+    // The queued blocks are dropped, and the thread catches up from disk.
+    index.Release();
+    BOOST_REQUIRE(WaitForSync(index));
+    BOOST_CHECK(index.GetHeights() == std::vector<int>({0, 1}));
+    BOOST_CHECK(index.GetBestBlock() == chainActive.Tip()->GetBlockHash());
+    index.Stop();
+}
+
+BOOST_AUTO_TEST_CASE(txindex_initial_sync)
+{
+    const CTransactionRef& txGenesis = Params().GenesisBlock().vtx[0];
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = 42;
+    std::shared_ptr<CBlock> block = std::make_shared<CBlock>();
+    block->vtx.push_back(MakeTransactionRef(mtx));
+
+    CDiskTxPos pos;
+    g_txindex.reset(new TxIndex(1 << 20, true));
+    BOOST_CHECK(!g_txindex->FindTx(txGenesis->GetHash(), pos));
+    g_txindex->Start();
+    BOOST_REQUIRE(WaitForSync(*g_txindex));
+
+    // A transaction the index caught up with is read from where it is on disk.
+    CTransactionRef tx;
+    uint256 hashBlock;
+    BOOST_CHECK(g_txindex->FindTx(txGenesis->GetHash(), pos));
+    BOOST_CHECK(GetTransaction(txGenesis->GetHash(), tx, Params().GetConsensus(), hashBlock, false));
+    BOOST_CHECK(tx && tx->GetHash() == txGenesis->GetHash());
+    BOOST_CHECK(hashBlock == Params().GenesisBlock().GetHash());
+
+    // A block connected once it is up to date is indexed from BlockConnected.
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindex = ConnectFakeBlock();
+        pindex->nStatus |= BLOCK_HAVE_DATA;
+        pindex->nFile = 7;
+        pindex->nDataPos = 1000;
+        GetMainSignals().BlockConnected(block, pindex, {});
+    }
+    BOOST_REQUIRE(WaitForSync(*g_txindex));
+    BOOST_CHECK(g_txindex->FindTx(block->vtx[0]->GetHash(), pos));
+    BOOST_CHECK_EQUAL(pos.nFile, 7);
+    BOOST_CHECK_EQUAL(pos.nPos, 1000U);
+
+    g_txindex->Stop();
+    g_txindex.reset();
+}
+
+BOOST_AUTO_TEST_CASE(txindex_erase_old_entries)
+{
+    // Entries of the transaction index as it used to be kept in the block
+    // index database.
+    std::vector<uint256> txids;
+    for (int i = 0; i < 100; i++) {
+        txids.push_back(InsecureRand256());
+        BOOST_CHECK(pblocktree->Write(std::make_pair('t', txids.back()), CDiskTxPos(CDiskBlockPos(0, 0), i)));
+    }
+    BOOST_CHECK(pblocktree->WriteFlag("txindex", true));
+    BOOST_CHECK(pblocktree->WriteReindexing(true));
+
+    BOOST_CHECK(pblocktree->EraseOldTxIndex());
+    for (const uint256& txid : txids)
+        BOOST_CHECK(!pblocktree->Exists(std::make_pair('t', txid)));
+    bool fValue;
+    BOOST_CHECK(!pblocktree->ReadFlag("txindex", fValue));
+    // Other entries are left alone.
+    bool fReindexing = false;
+    BOOST_CHECK(pblocktree->ReadReindexing(fReindexing) && fReindexing);
+    BOOST_CHECK(pblocktree->WriteReindexing(false));
+
+    // Once they are gone, there is nothing to do.
+    BOOST_CHECK(pblocktree->EraseOldTxIndex());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
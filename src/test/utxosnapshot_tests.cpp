@@ -0,0 +1,143 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "compressor.h"
+#include "streams.h"
+#include "txdb.h"
+#include "utxosnapshot.h"
+#include "version.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(utxosnapshot_tests, BasicTestingSetup)
+
+static Coin MakeCoin(CAmount nValue, int nHeight)
+{
+    return Coin(CTxOut(nValue, CScript() << OP_TRUE), nHeight, nHeight == 1);
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_header)
+{
+    CUTXOSnapshotHeader header;
+    header.hashBlock = uint256S("0123");
+    header.nChainTx = 42;
+    header.vHeaders.resize(3);
+    header.vHeaders[2].nNonce = 7;
+    header.nTransactions = 5;
+    header.nCoins = 9;
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << header;
+    CDataStream ssBad(ss);
+    CUTXOSnapshotHeader header2;
+    ss >> header2;
+    BOOST_CHECK(header2.hashBlock == header.hashBlock);
+    BOOST_CHECK_EQUAL(header2.nChainTx, 42U);
+    BOOST_CHECK_EQUAL(header2.vHeaders.size(), 3U);
+    BOOST_CHECK(header2.vHeaders[2].GetHash() == header.vHeaders[2].GetHash());
+    BOOST_CHECK_EQUAL(header2.nTransactions, 5U);
+    BOOST_CHECK_EQUAL(header2.nCoins, 9U);
+
+    // Anything but the magic and version of a snapshot is refused.
+    ssBad[4] = 0;
+    BOOST_CHECK_THROW(ssBad >> header2, std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_transaction)
+{
+    std::map<uint32_t, Coin> outputs;
+    outputs[0] = MakeCoin(50, 1);
+    outputs[3] = MakeCoin(25, 1);
+    const uint256 hash = uint256S("abcd");
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    WriteSnapshotTransaction(ss, hash, outputs);
+    uint256 hash2;
+    std::map<uint32_t, Coin> outputs2;
+    BOOST_CHECK(ReadSnapshotTransaction(ss, hash2, outputs2));
+    BOOST_CHECK(hash2 == hash);
+    BOOST_CHECK_EQUAL(outputs2.size(), 2U);
+    BOOST_CHECK(outputs2[3].out == outputs[3].out);
+    BOOST_CHECK_EQUAL(outputs2[3].nHeight, 1U);
+    BOOST_CHECK(outputs2[3].fCoinBase);
+    BOOST_CHECK(ss.empty());
+
+    // Empty or oversized transactions and duplicate outputs are refused.
+    const uint32_t code = 2 * 2;
+    ss << hash << VARINT(code) << VARINT(uint64_t(0));
+    BOOST_CHECK(!ReadSnapshotTransaction(ss, hash2, outputs2));
+    ss.clear();
+    ss << hash << VARINT(code) << VARINT(uint64_t(1000001));
+    BOOST_CHECK(!ReadSnapshotTransaction(ss, hash2, outputs2));
+    ss.clear();
+    CTxOut out(1, CScript() << OP_TRUE);
+    ss << hash << VARINT(code) << VARINT(uint64_t(2)) << VARINT(uint32_t(1)) << CTxOutCompressor(out) << VARINT(uint32_t(1)) << CTxOutCompressor(out);
+    BOOST_CHECK(!ReadSnapshotTransaction(ss, hash2, outputs2));
+
+    // All outputs of a transaction have its height and coinbase flag.
+    BOOST_CHECK(IsSingleTransaction(outputs));
+    outputs[5] = MakeCoin(5, 2);
+    BOOST_CHECK(!IsSingleTransaction(outputs));
+    outputs[5] = Coin(CTxOut(5, CScript() << OP_TRUE), 1, false);
+    BOOST_CHECK(!IsSingleTransaction(outputs));
+    BOOST_CHECK(!IsSingleTransaction(std::map<uint32_t, Coin>()));
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_load_coins)
+{
+    CCoinsViewDB db(1 << 20, true);
+    const uint256 hashOld = uint256S("01");
+    const uint256 hashNew = uint256S("02");
+    {
+        CCoinsViewCache cache(&db);
+        cache.AddCoin(COutPoint(uint256S("aa"), 0), MakeCoin(10, 5), false);
+        cache.SetBestBlock(hashOld);
+        BOOST_CHECK(cache.Flush());
+        db.WaitForWrite();
+    }
+
+    BOOST_CHECK(db.BeginLoad(hashNew));
+    // While loading, the database has no best block and no coins, only heads.
+    BOOST_CHECK(db.GetBestBlock().IsNull());
+    BOOST_CHECK(!db.HaveCoin(COutPoint(uint256S("aa"), 0)));
+    std::vector<uint256> vHeads = db.GetHeadBlocks();
+    BOOST_REQUIRE_EQUAL(vHeads.size(), 2U);
+    BOOST_CHECK(vHeads[0] == hashNew);
+    BOOST_CHECK(vHeads[1].IsNull());
+
+    std::vector<std::pair<COutPoint, Coin>> vCoins;
+    CCoinsSetHash setHash;
+    for (int i = 0; i < 1000; i++) {
+        vCoins.emplace_back(COutPoint(ArithToUint256(arith_uint256(i + 1)), i % 3), MakeCoin(i + 1, 2));
+        setHash.AddCoin(vCoins.back().first, vCoins.back().second);
+    }
+    BOOST_CHECK(db.LoadCoins(vCoins));
+    CCoinsSetHash setHashDB;
+    BOOST_CHECK(!db.GetSetHash(setHashDB));
+    BOOST_CHECK(db.FinishLoad(hashNew, setHash));
+
+    BOOST_CHECK(db.GetBestBlock() == hashNew);
+    BOOST_CHECK(db.GetSetHash(setHashDB));
+    BOOST_CHECK(setHashDB.GetHash() == setHash.GetHash());
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    for (const auto& entry : vCoins) {
+        Coin coin;
+        BOOST_CHECK(db.GetCoin(entry.first, coin));
+        BOOST_CHECK(coin.out == entry.second.out);
+    }
+    // A load that is abandoned leaves an empty database.
+    BOOST_CHECK(db.BeginLoad(hashOld));
+    BOOST_CHECK(db.LoadCoins(vCoins));
+    BOOST_CHECK(db.AbortLoad());
+    BOOST_CHECK(db.GetBestBlock().IsNull());
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_CHECK(db.GetSetHash(setHashDB));
+    BOOST_CHECK(setHashDB.GetHash() == CCoinsSetHash().GetHash());
+    std::unique_ptr<CCoinsViewCursor> pcursor(db.Cursor());
+    BOOST_CHECK(!pcursor->Valid());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,7 @@
 
 #include "chainparams.h"
 #include "hash.h"
+#include "memusage.h"
 #include "random.h"
 #include "pow.h"
 #include "uint256.h"
@@ -14,14 +15,18 @@
 #include "ui_interface.h"
 #include "init.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <stdint.h>
+#include <thread>
 
 #include <boost/thread.hpp>
 
 static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
-static const char DB_TXINDEX = 't';
+static const char DB_TXINDEX_OLD = 't';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
@@ -29,6 +34,7 @@ static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_SET_HASH = 'S';
 
 namespace {
 
@@ -54,26 +60,79 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe, const CDBOptions& dbOptions) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, dbOptions), nPendingUsage(0), fWriteOk(true)
 {
+    // The stored rolling hash is only current if it belongs to the best
+    // block; an empty database has the hash of the empty set.
+    uint256 hashBestBlock;
+    std::pair<uint256, CCoinsSetHash> stored;
+    if (!db.Read(DB_BEST_BLOCK, hashBestBlock))
+        fSetHash = !db.Exists(DB_HEAD_BLOCKS);
+    else if (db.Read(DB_SET_HASH, stored) && stored.first == hashBestBlock) {
+        setHash = stored.second;
+        fSetHash = true;
+    } else
+        fSetHash = false;
+}
+
+CCoinsViewDB::~CCoinsViewDB()
+{
+    WaitForWrite();
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    {
+        LOCK(cs_pending);
+        if (pmapPending) {
+            CCoinsMap::const_iterator it = pmapPending->find(outpoint);
+            if (it != pmapPending->end()) {
+                coin = it->second.coin;
+                return !coin.IsSpent();
+            }
+        }
+    }
     return db.Read(CoinEntry(&outpoint), coin);
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    {
+        LOCK(cs_pending);
+        if (pmapPending) {
+            CCoinsMap::const_iterator it = pmapPending->find(outpoint);
+            if (it != pmapPending->end()) {
+                return !it->second.coin.IsSpent();
+            }
+        }
+    }
     return db.Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
+    {
+        LOCK(cs_pending);
+        if (pmapPending)
+            return hashPending;
+    }
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
     return hashBestChain;
 }
 
+bool CCoinsViewDB::GetSetHash(CCoinsSetHash &setHashOut) const {
+    if (!fSetHash)
+        return false;
+    setHashOut = setHash;
+    return true;
+}
+
+void CCoinsViewDB::ApplySetHashDelta(const CCoinsSetHash &delta) {
+    if (fSetHash)
+        setHash += delta;
+}
+
 std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
+    WaitForWrite();
     std::vector<uint256> vhashHeadBlocks;
     if (!db.Read(DB_HEAD_BLOCKS, vhashHeadBlocks)) {
         return std::vector<uint256>();
@@ -82,18 +141,66 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    assert(!hashBlock.IsNull());
+    LOCK(cs_write);
+    if (!WaitForWrite())
+        return false;
+    {
+        // Lookups are answered from the entries being written until they are on disk.
+        LOCK(cs_pending);
+        pmapPending.reset(new CCoinsMap(std::move(mapCoins)));
+        nPendingUsage = memusage::DynamicUsage(*pmapPending);
+        for (const CCoinsMap::value_type& entry : *pmapPending)
+            nPendingUsage += entry.second.coin.DynamicMemoryUsage();
+        hashPending = hashBlock;
+        psetHashPending.reset(fSetHash ? new CCoinsSetHash(setHash) : nullptr);
+        mapCoins.clear();
+    }
+    threadWrite = std::thread([this] {
+        RenameThread("bitcoin-coinsdb");
+        bool ret = false;
+        try {
+            ret = WriteCoins(*pmapPending, hashPending, psetHashPending.get());
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        std::unique_ptr<CCoinsMap> pmapWritten;
+        {
+            LOCK(cs_pending);
+            pmapWritten.swap(pmapPending);
+            nPendingUsage = 0;
+            fWriteOk = ret;
+        }
+    });
+    return true;
+}
+
+size_t CCoinsViewDB::PendingMemoryUsage() const {
+    LOCK(cs_pending);
+    return nPendingUsage;
+}
+
+bool CCoinsViewDB::WaitForWrite() const {
+    LOCK(cs_write);
+    if (threadWrite.joinable())
+        threadWrite.join();
+    LOCK(cs_pending);
+    return fWriteOk;
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock, const CCoinsSetHash *pSetHash) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
     size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
-    assert(!hashBlock.IsNull());
 
-    uint256 old_tip = GetBestBlock();
-    if (old_tip.IsNull()) {
+    uint256 old_tip;
+    if (!db.Read(DB_BEST_BLOCK, old_tip)) {
         // We may be in the middle of replaying.
-        std::vector<uint256> old_heads = GetHeadBlocks();
-        if (old_heads.size() == 2) {
+        std::vector<uint256> old_heads;
+        old_tip.SetNull();
+        if (db.Read(DB_HEAD_BLOCKS, old_heads) && old_heads.size() == 2) {
             assert(old_heads[0] == hashBlock);
             old_tip = old_heads[1];
         }
@@ -106,7 +213,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             CoinEntry entry(&it->first);
             if (it->second.coin.IsSpent())
@@ -116,8 +223,6 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -135,6 +240,10 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     // In the last batch, mark the database as consistent with hashBlock again.
     batch.Erase(DB_HEAD_BLOCKS);
     batch.Write(DB_BEST_BLOCK, hashBlock);
+    if (pSetHash)
+        batch.Write(DB_SET_HASH, std::make_pair(hashBlock, *pSetHash));
+    else
+        batch.Erase(DB_SET_HASH);
 
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = db.WriteBatch(batch);
@@ -142,12 +251,128 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return ret;
 }
 
+bool CCoinsViewDB::EraseCoins() {
+    const size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    CDBBatch batch(db);
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    COutPoint outpoint;
+    CoinEntry entry(&outpoint);
+    for (pcursor->Seek(DB_COIN); pcursor->Valid(); pcursor->Next()) {
+        if (!pcursor->GetKey(entry) || entry.key != DB_COIN)
+            break;
+        batch.Erase(entry);
+        if (batch.SizeEstimate() > batch_size) {
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+        }
+    }
+    return db.WriteBatch(batch);
+}
+
+bool CCoinsViewDB::BeginLoad(const uint256 &hashBlock) {
+    if (!WaitForWrite())
+        return false;
+    CDBBatch batch(db);
+    // Mark the database as in transition from nothing to hashBlock, which
+    // ReplayBlocks refuses to roll forward without block data.
+    batch.Erase(DB_BEST_BLOCK);
+    batch.Erase(DB_SET_HASH);
+    batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, uint256()});
+    fSetHash = false;
+    if (!db.WriteBatch(batch, true))
+        return false;
+
+    // Remove whatever an earlier or interrupted load left behind.
+    return EraseCoins();
+}
+
+bool CCoinsViewDB::LoadCoins(const std::vector<std::pair<COutPoint, Coin>> &vCoins) {
+    const size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    CDBBatch batch(db);
+    for (const auto& coin : vCoins) {
+        batch.Write(CoinEntry(&coin.first), coin.second);
+        if (batch.SizeEstimate() > batch_size) {
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+        }
+    }
+    return db.WriteBatch(batch);
+}
+
+bool CCoinsViewDB::FinishLoad(const uint256 &hashBlock, const CCoinsSetHash &setHashLoaded) {
+    CDBBatch batch(db);
+    batch.Erase(DB_HEAD_BLOCKS);
+    batch.Write(DB_BEST_BLOCK, hashBlock);
+    batch.Write(DB_SET_HASH, std::make_pair(hashBlock, setHashLoaded));
+    if (!db.WriteBatch(batch, true))
+        return false;
+    setHash = setHashLoaded;
+    fSetHash = true;
+    return true;
+}
+
+bool CCoinsViewDB::AbortLoad() {
+    // Back to an empty database, which has the rolling hash of the empty set.
+    if (!EraseCoins())
+        return false;
+    CDBBatch batch(db);
+    batch.Erase(DB_HEAD_BLOCKS);
+    if (!db.WriteBatch(batch, true))
+        return false;
+    setHash = CCoinsSetHash();
+    fSetHash = true;
+    return true;
+}
+
+bool CCoinsViewDB::RebuildSetHash() {
+    if (fSetHash || !GetHeadBlocks().empty())
+        return true;
+
+    LogPrintf("Computing the rolling hash of the UTXO set...\n");
+    std::unique_ptr<CCoinsViewCursor> pcursor(Cursor());
+    CCoinsSetHash setHashNew;
+    int reportDone = 0;
+    uint64_t count = 0;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            return true;
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin))
+            return error("%s: unable to read coin", __func__);
+        setHashNew.AddCoin(key, coin);
+        if (count++ % 1000 == 0) {
+            uint32_t high = 0x100 * *key.hash.begin() + *(key.hash.begin() + 1);
+            int percentageDone = (int)(high * 100.0 / 65536.0 + 0.5);
+            uiInterface.ShowProgress(_("Computing UTXO set hash..."), percentageDone);
+            if (reportDone < percentageDone/10) {
+                LogPrintf("[%d%%]...", percentageDone);
+                reportDone = percentageDone/10;
+            }
+        }
+        pcursor->Next();
+    }
+    uiInterface.ShowProgress("", 100);
+    LogPrintf("[DONE].\n");
+
+    CDBBatch batch(db);
+    batch.Write(DB_SET_HASH, std::make_pair(pcursor->GetBestBlock(), setHashNew));
+    if (!db.WriteBatch(batch, true))
+        return false;
+    setHash = setHashNew;
+    fSetHash = true;
+    return true;
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe, const CDBOptions& dbOptions) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, dbOptions) {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -170,24 +395,77 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
     return Read(DB_LAST_BLOCK, nFile);
 }
 
-CCoinsViewCursor *CCoinsViewDB::Cursor() const
+CCoinsViewCursor *CCoinsViewDB::NewCursor(const uint256 &hashBlock, const uint256 &hashBegin, const uint256 &hashEnd) const
 {
-    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COIN);
+    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), hashBlock, hashEnd);
+    i->pcursor->Seek(std::make_pair(DB_COIN, hashBegin));
     // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
-    } else {
-        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
-    }
+    i->ReadKey();
     return i;
 }
 
+CCoinsViewCursor *CCoinsViewDB::Cursor() const
+{
+    // Iterate over a consistent state rather than one being written.
+    WaitForWrite();
+    return NewCursor(GetBestBlock(), uint256(), uint256());
+}
+
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsViewDB::PartitionedCursors(size_t nParts) const
+{
+    // The ranges are split on the first two bytes of the txid, which are
+    // the first to be compared in the key order.
+    nParts = std::max<size_t>(1, std::min<size_t>(nParts, 0x10000));
+    std::vector<uint256> vBounds;
+    for (size_t i = 0; i <= nParts; i++) {
+        uint256 hash;
+        if (i > 0 && i < nParts) {
+            const uint32_t nPrefix = i * 0x10000 / nParts;
+            *hash.begin() = nPrefix >> 8;
+            *(hash.begin() + 1) = nPrefix & 0xff;
+        }
+        vBounds.push_back(hash);
+    }
+
+    // Create the iterators, which each read the state at the time they are
+    // created, with no write in between.
+    LOCK(cs_write);
+    WaitForWrite();
+    const uint256 hashBlock = GetBestBlock();
+    std::vector<std::unique_ptr<CCoinsViewCursor>> vCursors;
+    for (size_t i = 0; i < nParts; i++)
+        vCursors.emplace_back(NewCursor(hashBlock, vBounds[i], vBounds[i + 1]));
+    return vCursors;
+}
+
+bool ScanCursorsParallel(const std::vector<std::unique_ptr<CCoinsViewCursor>>& vCursors, int nThreads, const std::function<bool(size_t, CCoinsViewCursor&)>& fn)
+{
+    std::atomic<size_t> nNext(0);
+    std::atomic<bool> fOk(true);
+    auto scan = [&]() {
+        size_t i;
+        while (fOk && (i = nNext++) < vCursors.size()) {
+            try {
+                if (!fn(i, *vCursors[i]))
+                    fOk = false;
+            } catch (const std::exception& e) {
+                LogPrintf("%s: %s\n", __func__, e.what());
+                fOk = false;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads && (size_t)i < vCursors.size(); i++)
+        threads.emplace_back(scan);
+    scan();
+    for (std::thread& thread : threads)
+        thread.join();
+    return fOk;
+}
+
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 {
     // Return cached key
@@ -216,8 +494,13 @@ bool CCoinsViewDBCursor::Valid() const
 void CCoinsViewDBCursor::Next()
 {
     pcursor->Next();
+    ReadKey();
+}
+
+void CCoinsViewDBCursor::ReadKey()
+{
     CoinEntry entry(&keyTmp.second);
-    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
+    if (!pcursor->Valid() || !pcursor->GetKey(entry) || (!hashEnd.IsNull() && !(keyTmp.second.hash < hashEnd))) {
         keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
     } else {
         keyTmp.first = entry.key;
@@ -236,17 +519,6 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     return WriteBatch(batch, true);
 }
 
-bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
-    return Read(std::make_pair(DB_TXINDEX, txid), pos);
-}
-
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_TXINDEX, it->first), it->second);
-    return WriteBatch(batch);
-}
-
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -259,44 +531,193 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+bool CBlockTreeDB::EraseOldTxIndex()
+{
+    const std::pair<char, uint256> keyBegin(DB_TXINDEX_OLD, uint256());
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(keyBegin);
+
+    CDBBatch batch(*this);
+    size_t nErased = 0;
+    std::pair<char, uint256> key;
+    while (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_TXINDEX_OLD) {
+        if (ShutdownRequested())
+            break;
+        batch.Erase(key);
+        if (++nErased == 1)
+            LogPrintf("Erasing the old transaction index from the block index database...\n");
+        if (batch.SizeEstimate() > nDefaultDbBatchSize) {
+            if (!WriteBatch(batch))
+                return false;
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+    if (nErased == 0)
+        return true;
+    // The flag that recorded whether the old index was kept.
+    batch.Erase(std::make_pair(DB_FLAG, std::string("txindex")));
+    if (!WriteBatch(batch))
+        return false;
+    // Without compaction, the erased entries would stay on disk until LevelDB
+    // happens to rewrite the files holding them.
+    CompactRange(keyBegin, std::make_pair((char)(DB_TXINDEX_OLD + 1), uint256()));
+    LogPrintf("Erased %u entries of the old transaction index\n", nErased);
+    return true;
+}
+
+namespace {
+
+/** Number of block index entries read and checked at a time */
+const size_t BLOCK_INDEX_LOAD_BATCH = 16384;
+
+//! A block index entry as read from disk, under the hash it is stored with.
+struct CBlockIndexEntry
+{
+    uint256 hash;
+    CDiskBlockIndex diskindex;
+    bool fValid;
+};
+
+/**
+ * Checks batches of block index entries on nThreads threads, which are
+ * started once for the whole load: every entry's header must hash to the
+ * key it is stored under, and entries above nTrustedHeight must have valid
+ * proof of work.
+ */
+class CBlockIndexChecker
+{
+private:
+    const Consensus::Params& consensusParams;
+    const int nTrustedHeight;
+    const int nThreads;
+
+    std::mutex mutex;
+    std::condition_variable condWork;
+    std::condition_variable condDone;
+    std::vector<CBlockIndexEntry>* pEntries;
+    uint64_t nBatch;
+    int nRunning;
+    bool fStop;
+    std::vector<std::thread> threads;
+
+    void CheckPart(std::vector<CBlockIndexEntry>& vEntries, size_t nStart)
+    {
+        for (size_t i = nStart; i < vEntries.size(); i += nThreads) {
+            CBlockIndexEntry& entry = vEntries[i];
+            entry.fValid = entry.diskindex.GetBlockHash() == entry.hash &&
+                (entry.diskindex.nHeight <= nTrustedHeight || CheckProofOfWork(entry.hash, entry.diskindex.nBits, consensusParams));
+        }
+    }
+
+    void Worker(int nIndex)
+    {
+        uint64_t nDone = 0;
+        while (true) {
+            std::vector<CBlockIndexEntry>* pBatch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condWork.wait(lock, [&] { return fStop || nBatch != nDone; });
+                if (fStop)
+                    return;
+                nDone = nBatch;
+                pBatch = pEntries;
+            }
+            CheckPart(*pBatch, nIndex);
+            std::unique_lock<std::mutex> lock(mutex);
+            if (--nRunning == 0)
+                condDone.notify_one();
+        }
+    }
+
+public:
+    CBlockIndexChecker(const Consensus::Params& consensusParamsIn, int nTrustedHeightIn, int nThreadsIn) :
+        consensusParams(consensusParamsIn), nTrustedHeight(nTrustedHeightIn), nThreads(std::max(nThreadsIn, 1)),
+        pEntries(nullptr), nBatch(0), nRunning(0), fStop(false)
+    {
+        for (int i = 1; i < nThreads; i++)
+            threads.emplace_back([this, i] { RenameThread("bitcoin-loadblkidx"); Worker(i); });
+    }
+
+    ~CBlockIndexChecker()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            fStop = true;
+        }
+        condWork.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    //! Check the entries, setting their fValid.
+    void Check(std::vector<CBlockIndexEntry>& vEntries)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            pEntries = &vEntries;
+            nRunning = threads.size();
+            nBatch++;
+        }
+        condWork.notify_all();
+        CheckPart(vEntries, 0);
+        std::unique_lock<std::mutex> lock(mutex);
+        condDone.wait(lock, [&] { return nRunning == 0; });
+    }
+};
+
+} // namespace
+
+bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, int nTrustedHeight, int nThreads)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
 
     // Load mapBlockIndex
-    while (pcursor->Valid()) {
+    CBlockIndexChecker checker(consensusParams, nTrustedHeight, nThreads);
+    std::vector<CBlockIndexEntry> vEntries;
+    bool fDone = false;
+    while (!fDone) {
         boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-				pindexNew->hashMetronome  = diskindex.hashMetronome;
-
-                if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, consensusParams))
-                    return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
-
-                pcursor->Next();
-            } else {
-                return error("%s: failed to read value", __func__);
+        // Read a batch; the cursor can only be used by one thread.
+        vEntries.clear();
+        while (vEntries.size() < BLOCK_INDEX_LOAD_BATCH) {
+            std::pair<char, uint256> key;
+            if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX) {
+                fDone = true;
+                break;
             }
-        } else {
-            break;
+            vEntries.emplace_back();
+            vEntries.back().hash = key.second;
+            if (!pcursor->GetValue(vEntries.back().diskindex))
+                return error("%s: failed to read value", __func__);
+            pcursor->Next();
+        }
+
+        // Hashing the headers is most of the work; do it on all threads.
+        checker.Check(vEntries);
+
+        for (const CBlockIndexEntry& entry : vEntries) {
+            const CDiskBlockIndex& diskindex = entry.diskindex;
+            if (!entry.fValid)
+                return error("%s: header check failed for %s at height %d", __func__, entry.hash.ToString(), diskindex.nHeight);
+
+            // Construct block index object
+            CBlockIndex* pindexNew = insertBlockIndex(entry.hash);
+            pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
+            pindexNew->nHeight        = diskindex.nHeight;
+            pindexNew->nFile          = diskindex.nFile;
+            pindexNew->nDataPos       = diskindex.nDataPos;
+            pindexNew->nUndoPos       = diskindex.nUndoPos;
+            pindexNew->nVersion       = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime          = diskindex.nTime;
+            pindexNew->nBits          = diskindex.nBits;
+            pindexNew->nNonce         = diskindex.nNonce;
+            pindexNew->nStatus        = diskindex.nStatus;
+            pindexNew->nTx            = diskindex.nTx;
+            pindexNew->hashMetronome  = diskindex.hashMetronome;
         }
     }
 
@@ -9,9 +9,13 @@
 #include "coins.h"
 #include "dbwrapper.h"
 #include "chain.h"
+#include "sync.h"
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -29,12 +33,16 @@ static const int64_t nDefaultDbBatchSize = 16 << 20;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
 static const int64_t nMinDbCache = 4;
-//! Max memory allocated to block tree DB specific cache, if no -txindex (MiB)
+//! Max memory allocated to block tree DB specific cache (MiB)
 static const int64_t nMaxBlockDBCache = 2;
-//! Max memory allocated to block tree DB specific cache, if -txindex (MiB)
+//! Max memory allocated to tx index DB specific cache, if -txindex (MiB)
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
-static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
+static const int64_t nMaxTxIndexCache = 1024;
+//! Max memory allocated to block filter index DB specific cache, if -blockfilterindex (MiB)
+static const int64_t nMaxFilterIndexCache = 1024;
+//! Max memory allocated to address index DB specific cache, if -addressindex (MiB)
+static const int64_t nMaxAddressIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
 
@@ -63,20 +71,83 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
-/** CCoinsView backed by the coin database (chainstate/) */
+/**
+ * CCoinsView backed by the coin database (chainstate/)
+ *
+ * BatchWrite returns once the batch has been handed to a background thread,
+ * so a flush does not stall block processing. Until the batch is on disk,
+ * lookups are answered from it; the next BatchWrite, Cursor() and
+ * GetHeadBlocks() wait for it to finish.
+ *
+ * The rolling hash of the coins is written along with the best block. It is
+ * not known after a write was interrupted or for a database written by an
+ * older version, until RebuildSetHash computes it again.
+ */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
+private:
+    //! Serializes starting and joining threadWrite
+    mutable CCriticalSection cs_write;
+    mutable std::thread threadWrite;
+
+    //! Guards the entries being written and the outcome of the last write
+    mutable CCriticalSection cs_pending;
+    std::unique_ptr<CCoinsMap> pmapPending;
+    uint256 hashPending;
+    std::unique_ptr<CCoinsSetHash> psetHashPending;
+    size_t nPendingUsage;
+    bool fWriteOk;
+
+    //! Rolling hash as of the last BatchWrite, if fSetHash
+    CCoinsSetHash setHash;
+    bool fSetHash;
+
+    bool WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock, const CCoinsSetHash *pSetHash);
+    //! Remove all coins, in batches
+    bool EraseCoins();
+    CCoinsViewCursor *NewCursor(const uint256 &hashBlock, const uint256 &hashBegin, const uint256 &hashEnd) const;
 public:
-    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, const CDBOptions& dbOptions = CDBOptions());
+    ~CCoinsViewDB();
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool GetSetHash(CCoinsSetHash &setHash) const override;
+    void ApplySetHashDelta(const CCoinsSetHash &delta) override;
     CCoinsViewCursor *Cursor() const override;
+    size_t PendingMemoryUsage() const override;
+
+    /**
+     * Get nParts cursors that together iterate over all coins, each over a
+     * range of txids of about the same size, in txid order. All of them see
+     * the same state, and they can be used from different threads at once.
+     */
+    std::vector<std::unique_ptr<CCoinsViewCursor>> PartitionedCursors(size_t nParts) const;
+
+    //! Wait for the write in progress, if any. Returns false if a write failed.
+    bool WaitForWrite() const;
+
+    /**
+     * Bulk load a UTXO set that is the state after hashBlock. BeginLoad
+     * removes all coins and marks the database as being loaded, LoadCoins
+     * writes coins, best in key order, and FinishLoad marks the database as
+     * consistent with hashBlock, with setHashLoaded the rolling hash of the
+     * coins. Until then the database has no best block, and a load that is
+     * interrupted has to be done again. AbortLoad instead removes the coins
+     * loaded so far and leaves the database empty.
+     */
+    bool BeginLoad(const uint256 &hashBlock);
+    bool LoadCoins(const std::vector<std::pair<COutPoint, Coin>> &vCoins);
+    bool FinishLoad(const uint256 &hashBlock, const CCoinsSetHash &setHashLoaded);
+    bool AbortLoad();
+
+    //! Compute the rolling hash from all coins if it is not known. Returns false on a read error.
+    bool RebuildSetHash();
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
@@ -97,19 +168,30 @@ public:
     void Next() override;
 
 private:
-    CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
-        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+    CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn, const uint256 &hashEndIn):
+        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn), hashEnd(hashEndIn) {}
+    void ReadKey();
+
     std::unique_ptr<CDBIterator> pcursor;
     std::pair<char, COutPoint> keyTmp;
+    //! Coins from this txid on are left to the next cursor, unless it is null
+    uint256 hashEnd;
 
     friend class CCoinsViewDB;
 };
 
+/**
+ * Call fn(i, cursor) for each of the cursors, from nThreads threads, taking
+ * them in order. Once fn returns false or throws for one of them, no more
+ * are started and false is returned.
+ */
+bool ScanCursorsParallel(const std::vector<std::unique_ptr<CCoinsViewCursor>>& vCursors, int nThreads, const std::function<bool(size_t, CCoinsViewCursor&)>& fn);
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
 public:
-    CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, const CDBOptions& dbOptions = CDBOptions());
 private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
@@ -119,11 +201,19 @@ public:
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool &fReindex);
-    bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
-    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /**
+     * Erase the entries of the transaction index that used to be kept in this
+     * database, and compact the range they took. Does nothing once they are gone.
+     */
+    bool EraseOldTxIndex();
+    /**
+     * Load all block index entries. Their headers are hashed and checked
+     * against the keys they are stored under in parallel on nThreads
+     * threads, and so is the proof of work of entries above nTrustedHeight.
+     */
+    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, int nTrustedHeight = -1, int nThreads = 1);
 };
 
 #endif // BITCOIN_TXDB_H
@@ -0,0 +1,148 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTXOSNAPSHOT_H
+#define BITCOIN_UTXOSNAPSHOT_H
+
+#include "coins.h"
+#include "compressor.h"
+#include "hash.h"
+#include "primitives/block.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <assert.h>
+#include <ios>
+#include <map>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+/** File format version of UTXO set snapshots */
+static const uint16_t UTXO_SNAPSHOT_VERSION = 2;
+
+/**
+ * Start of a UTXO set snapshot file, as written by dumptxoutset. It is
+ * followed by nTransactions entries in txid order, one for each transaction
+ * with unspent outputs, see WriteSnapshotTransaction. The headers let a node
+ * that has none yet use the snapshot.
+ */
+class CUTXOSnapshotHeader
+{
+public:
+    //! The block the UTXO set is the state after
+    uint256 hashBlock;
+    //! Number of transactions in the chain up to and including hashBlock
+    uint64_t nChainTx;
+    //! Headers of every block after the genesis block up to and including hashBlock
+    std::vector<CBlockHeader> vHeaders;
+    uint64_t nTransactions;
+    uint64_t nCoins;
+
+    CUTXOSnapshotHeader() : nChainTx(0), nTransactions(0), nCoins(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        static const unsigned char magic[5] = {'u', 't', 'x', 'o', 0xff};
+        unsigned char fileMagic[5];
+        memcpy(fileMagic, magic, sizeof(magic));
+        READWRITE(FLATDATA(fileMagic));
+        uint16_t nVersion = UTXO_SNAPSHOT_VERSION;
+        READWRITE(nVersion);
+        if (ser_action.ForRead() && (memcmp(fileMagic, magic, sizeof(magic)) != 0 || nVersion != UTXO_SNAPSHOT_VERSION))
+            throw std::ios_base::failure("not a UTXO snapshot of a supported version");
+        READWRITE(hashBlock);
+        READWRITE(nChainTx);
+        READWRITE(vHeaders);
+        READWRITE(nTransactions);
+        READWRITE(nCoins);
+    }
+};
+
+/**
+ * Whether the outputs can be those of one transaction: there is at least one,
+ * and all have the height and coinbase flag of the first.
+ */
+static inline bool IsSingleTransaction(const std::map<uint32_t, Coin>& outputs)
+{
+    if (outputs.empty())
+        return false;
+    const Coin& first = outputs.begin()->second;
+    for (const auto& output : outputs) {
+        if (output.second.nHeight != first.nHeight || output.second.fCoinBase != first.fCoinBase)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Write the unspent outputs of one transaction to a snapshot. The height and
+ * coinbase flag are written once, for all outputs, which must share them.
+ */
+template <typename Stream>
+void WriteSnapshotTransaction(Stream& s, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    assert(IsSingleTransaction(outputs));
+    const Coin& first = outputs.begin()->second;
+    uint32_t code = first.nHeight * 2 + first.fCoinBase;
+    uint64_t nOutputs = outputs.size();
+    s << hash;
+    s << VARINT(code);
+    s << VARINT(nOutputs);
+    for (const auto& output : outputs) {
+        s << VARINT(output.first);
+        s << CTxOutCompressor(REF(output.second.out));
+    }
+}
+
+/**
+ * Read the unspent outputs of one transaction from a snapshot. Returns false
+ * if they are not valid unspent outputs.
+ */
+template <typename Stream>
+bool ReadSnapshotTransaction(Stream& s, uint256& hash, std::map<uint32_t, Coin>& outputs)
+{
+    outputs.clear();
+    uint32_t code;
+    uint64_t nOutputs;
+    s >> hash;
+    s >> VARINT(code);
+    s >> VARINT(nOutputs);
+    if (nOutputs == 0 || nOutputs > 1000000)
+        return false;
+    for (uint64_t i = 0; i < nOutputs; i++) {
+        uint32_t n;
+        CTxOut out;
+        s >> VARINT(n);
+        s >> REF(CTxOutCompressor(out));
+        if (out.IsNull() || !outputs.emplace(n, Coin(std::move(out), code >> 1, code & 1)).second)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Add the unspent outputs of one transaction to the hash of a UTXO set, as
+ * gettxoutsetinfo reports it in hash_serialized_2. Transactions must be
+ * added in txid order, after the best block hash, and the outputs must be
+ * those of one transaction (see IsSingleTransaction). The stream is a
+ * CHashWriter, or a buffer that is written to one later.
+ */
+template <typename Stream>
+void HashTxOutputs(Stream& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    assert(!outputs.empty());
+    ss << hash;
+    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase);
+    for (const auto& output : outputs) {
+        ss << VARINT(output.first + 1);
+        ss << output.second.out.scriptPubKey;
+        ss << VARINT(output.second.out.nValue);
+    }
+    ss << VARINT(0);
+}
+
+#endif // BITCOIN_UTXOSNAPSHOT_H
@@ -6,6 +6,8 @@
 #include "validation.h"
 
 #include "arith_uint256.h"
+#include "blockfilemap.h"
+#include "blockwritequeue.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -14,10 +16,13 @@
 #include "consensus/merkle.h"
 #include "consensus/tx_verify.h"
 #include "consensus/validation.h"
+#include "crypto/common.h"
 #include "cuckoocache.h"
 #include "fs.h"
 #include "hash.h"
+#include "index/txindex.h"
 #include "init.h"
+#include "lzcompress.h"
 #include "policy/fees.h"
 #include "policy/policy.h"
 #include "policy/rbf.h"
@@ -38,6 +43,7 @@
 #include "util.h"
 #include "utilmoneystr.h"
 #include "utilstrencodings.h"
+#include "utxosnapshot.h"
 #include "validationinterface.h"
 #include "versionbits.h"
 #include "warnings.h"
@@ -45,6 +51,7 @@
 
 #include <atomic>
 #include <sstream>
+#include <unordered_set>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -66,10 +73,12 @@ CBlockIndex *pindexBestHeader = nullptr;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
+int nReindexThreads = 0;
 std::atomic_bool fImporting(false);
 bool fReindex = false;
-bool fTxIndex = false;
 bool fHavePruned = false;
+bool fHaveAssumedValid = false;
+bool fBlockCompression = DEFAULT_BLOCK_COMPRESSION;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
@@ -927,6 +936,8 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, fLimitFree, pfMissingInputs, GetTime(), plTxnReplaced, fOverrideMempoolLimit, nAbsurdFee);
 }
 
+static bool ReadTxFromDisk(const CDiskTxPos& postx, CBlockHeader& header, CTransactionRef& txOut);
+
 /** Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus::Params& consensusParams, uint256 &hashBlock, bool fAllowSlow)
 {
@@ -941,20 +952,12 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
         return true;
     }
 
-    if (fTxIndex) {
+    if (g_txindex) {
         CDiskTxPos postx;
-        if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
+        if (g_txindex->FindTx(hash, postx)) {
             CBlockHeader header;
-            try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
-            } catch (const std::exception& e) {
-                return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            }
+            if (!ReadTxFromDisk(postx, header, txOut))
+                return false;
             hashBlock = header.GetHash();
             if (txOut->GetHash() != hash)
                 return error("%s: txid mismatch", __func__);
@@ -993,23 +996,160 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
 // CBlock and CBlockIndex
 //
 
-static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+//! Size of the magic and size written in front of stored block and undo data.
+static const unsigned int STORED_HEADER_SIZE = CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t);
+//! Set in the size in front of stored data that is compressed.
+static const unsigned int STORED_DATA_COMPRESSED = 0x80000000;
+
+/**
+ * Block or undo data as it is written to disk: serialized, and compressed
+ * if -blockcompression is on and that makes it smaller. Compressed data
+ * starts with its uncompressed size. Whether data is compressed is recorded
+ * in the size in front of it, so every record describes itself and old
+ * files, reindexing and mixed files keep working. Room for that header is
+ * left at the start, so the whole record can be written in one go.
+ */
+class CStoredData
 {
-    // Open history file to append
-    CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("WriteBlockToDisk: OpenBlockFile failed");
-
-    // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, block);
-    fileout << FLATDATA(messageStart) << nSize;
-
-    // Write block
-    long fileOutPos = ftell(fileout.Get());
-    if (fileOutPos < 0)
-        return error("WriteBlockToDisk: ftell failed");
-    pos.nPos = (unsigned int)fileOutPos;
-    fileout << block;
+public:
+    //! The header, filled in by WriteHeader, followed by the data.
+    std::vector<unsigned char> data;
+    bool fCompressed;
+
+    template <typename T>
+    explicit CStoredData(const T& obj) : fCompressed(false)
+    {
+        CVectorWriter(SER_DISK, CLIENT_VERSION, data, STORED_HEADER_SIZE, obj);
+        if (!fBlockCompression)
+            return;
+        std::vector<unsigned char> compressed(STORED_HEADER_SIZE + sizeof(uint32_t));
+        WriteLE32(&compressed[STORED_HEADER_SIZE], Size());
+        LZCompress(&data[STORED_HEADER_SIZE], Size(), compressed);
+        if (compressed.size() < data.size()) {
+            data.swap(compressed);
+            fCompressed = true;
+        }
+    }
+
+    //! Size of the data, without the header.
+    unsigned int Size() const { return data.size() - STORED_HEADER_SIZE; }
+
+    //! Fill in the magic and size in front of the data.
+    void WriteHeader(const CMessageHeader::MessageStartChars& messageStart)
+    {
+        memcpy(data.data(), messageStart, CMessageHeader::MESSAGE_START_SIZE);
+        WriteLE32(&data[CMessageHeader::MESSAGE_START_SIZE], Size() | (fCompressed ? STORED_DATA_COMPRESSED : 0));
+    }
+};
+
+//! Decompress stored compressed data into out.
+template <typename Container>
+static bool DecompressStoredData(const unsigned char* data, size_t size, Container& out)
+{
+    if (size < sizeof(uint32_t))
+        return false;
+    const uint32_t nRawSize = ReadLE32(data);
+    if (nRawSize > MAX_SIZE)
+        return false;
+    out.resize(nRawSize);
+    return LZDecompress(data + sizeof(uint32_t), size - sizeof(uint32_t), (unsigned char*)out.data(), nRawSize);
+}
+
+//! Position of the header in front of the data stored at pos.
+static CDiskBlockPos StoredHeaderPos(const CDiskBlockPos& pos)
+{
+    return CDiskBlockPos(pos.nFile, pos.nPos - STORED_HEADER_SIZE);
+}
+
+//! Read the header in front of stored data. Returns the size of the data.
+static unsigned int ReadStoredHeader(CAutoFile& filein, bool& fCompressed)
+{
+    CMessageHeader::MessageStartChars start;
+    unsigned int nSize;
+    filein >> FLATDATA(start) >> nSize;
+    fCompressed = (nSize & STORED_DATA_COMPRESSED) != 0;
+    return nSize & ~STORED_DATA_COMPRESSED;
+}
+
+//! Read nSize bytes of compressed data from filein and decompress them into ssOut.
+static void ReadCompressedData(CAutoFile& filein, unsigned int nSize, CDataStream& ssOut)
+{
+    if (nSize > MAX_SIZE)
+        throw std::ios_base::failure("Compressed data too large");
+    std::vector<unsigned char> compressed(nSize);
+    filein.read((char*)compressed.data(), nSize);
+    if (!DecompressStoredData(compressed.data(), compressed.size(), ssOut))
+        throw std::ios_base::failure("Compressed data corrupted");
+}
+
+static CBlockWriteQueue g_block_writer([](const CDiskBlockPos& pos, bool fUndo) { return fUndo ? OpenUndoFile(pos) : OpenBlockFile(pos); });
+
+void StartBlockWriter()
+{
+    g_block_writer.Start();
+}
+
+void StopBlockWriter()
+{
+    g_block_writer.Stop();
+}
+
+//! Find the size the data stored at pos takes on disk.
+static bool ReadStoredSize(const CDiskBlockPos& pos, unsigned int& nSize)
+{
+    if (pos.nPos < STORED_HEADER_SIZE)
+        return false;
+    g_block_writer.WaitForFile(pos.nFile, false);
+    CAutoFile filein(OpenBlockFile(StoredHeaderPos(pos), true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+    try {
+        bool fCompressed;
+        nSize = ReadStoredHeader(filein, fCompressed);
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+/** Read the transaction stored at postx, and the header of the block it is in. */
+static bool ReadTxFromDisk(const CDiskTxPos& postx, CBlockHeader& header, CTransactionRef& txOut)
+{
+    if (postx.nPos < STORED_HEADER_SIZE)
+        return error("%s: invalid position %s", __func__, postx.ToString());
+    g_block_writer.WaitForFile(postx.nFile, false);
+    CAutoFile file(OpenBlockFile(StoredHeaderPos(postx), true), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return error("%s: OpenBlockFile failed", __func__);
+    try {
+        bool fCompressed;
+        unsigned int nSize = ReadStoredHeader(file, fCompressed);
+        if (fCompressed) {
+            // The whole block has to be decompressed to get to the transaction.
+            CDataStream ssBlock(SER_DISK, CLIENT_VERSION);
+            ReadCompressedData(file, nSize, ssBlock);
+            ssBlock >> header;
+            ssBlock.ignore(postx.nTxOffset);
+            ssBlock >> txOut;
+        } else {
+            file >> header;
+            fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+            file >> txOut;
+        }
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    return true;
+}
+
+static bool WriteBlockToDisk(CStoredData& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    // Queue the index header and block for the writer thread
+    block.WriteHeader(messageStart);
+    const CDiskBlockPos posHeader = pos;
+    pos.nPos += STORED_HEADER_SIZE;
+    if (!g_block_writer.Write(posHeader, false, std::move(block.data)))
+        return error("WriteBlockToDisk: writing block data failed");
 
     return true;
 }
@@ -1017,15 +1157,26 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
 {
     block.SetNull();
+    if (pos.nPos < STORED_HEADER_SIZE)
+        return error("ReadBlockFromDisk: invalid position %s", pos.ToString());
+    g_block_writer.WaitForFile(pos.nFile, false);
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    // Open history file to read, at the header in front of the block
+    CAutoFile filein(OpenBlockFile(StoredHeaderPos(pos), true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
         return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
 
     // Read block
     try {
-        filein >> block;
+        bool fCompressed;
+        unsigned int nSize = ReadStoredHeader(filein, fCompressed);
+        if (fCompressed) {
+            CDataStream ssBlock(SER_DISK, CLIENT_VERSION);
+            ReadCompressedData(filein, nSize, ssBlock);
+            ssBlock >> block;
+        } else {
+            filein >> block;
+        }
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
@@ -1048,6 +1199,87 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+static CBlockFileMap g_block_file_map([](int nFile) { return GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk"); });
+
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
+{
+    // pos points at the block itself, after the magic and size written
+    // in front of it by WriteBlockToDisk.
+    if (pos.IsNull() || pos.nPos < STORED_HEADER_SIZE)
+        return error("%s: invalid position %s", __func__, pos.ToString());
+    g_block_writer.WaitForFile(pos.nFile, false);
+
+    std::shared_ptr<const CBlockFileMap::Mapping> mapping = g_block_file_map.Get(pos.nFile, pos.nPos);
+    if (!mapping) {
+        // No mapping: read it from the file instead.
+        CAutoFile filein(OpenBlockFile(StoredHeaderPos(pos), true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+        try {
+            CMessageHeader::MessageStartChars blk_start;
+            unsigned int nSize;
+            filein >> FLATDATA(blk_start) >> nSize;
+            if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE) != 0)
+                return error("%s: Block magic mismatch for %s", __func__, pos.ToString());
+            const bool fCompressed = (nSize & STORED_DATA_COMPRESSED) != 0;
+            nSize &= ~STORED_DATA_COMPRESSED;
+            if (nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                return error("%s: Block data is larger than maximum deserialization size for %s", __func__, pos.ToString());
+            block.resize(nSize);
+            filein.read((char*)block.data(), nSize);
+            if (fCompressed) {
+                std::vector<uint8_t> compressed;
+                compressed.swap(block);
+                if (!DecompressStoredData(compressed.data(), compressed.size(), block) || block.size() > MAX_BLOCK_SERIALIZED_SIZE)
+                    return error("%s: Corrupted compressed block at %s", __func__, pos.ToString());
+            }
+        } catch (const std::exception& e) {
+            return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
+        }
+        return true;
+    }
+
+    const unsigned char* header = mapping->data() + pos.nPos - STORED_HEADER_SIZE;
+    if (memcmp(header, message_start, CMessageHeader::MESSAGE_START_SIZE) != 0)
+        return error("%s: Block magic mismatch for %s", __func__, pos.ToString());
+    const unsigned int nSizeField = ReadLE32(header + CMessageHeader::MESSAGE_START_SIZE);
+    const unsigned int nSize = nSizeField & ~STORED_DATA_COMPRESSED;
+    if (nSize > MAX_BLOCK_SERIALIZED_SIZE)
+        return error("%s: Block data is larger than maximum deserialization size for %s", __func__, pos.ToString());
+    if ((size_t)pos.nPos + nSize > mapping->size()) {
+        mapping = g_block_file_map.Get(pos.nFile, (size_t)pos.nPos + nSize);
+        if (!mapping)
+            return error("%s: Block data extends beyond the file for %s", __func__, pos.ToString());
+    }
+    if (nSizeField & STORED_DATA_COMPRESSED) {
+        if (!DecompressStoredData(mapping->data() + pos.nPos, nSize, block) || block.size() > MAX_BLOCK_SERIALIZED_SIZE)
+            return error("%s: Corrupted compressed block at %s", __func__, pos.ToString());
+        return true;
+    }
+    block.assign(mapping->data() + pos.nPos, mapping->data() + pos.nPos + nSize);
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
+{
+    if (!ReadRawBlockFromDisk(block, pindex->GetBlockPos(), message_start))
+        return false;
+    // Check the header, which is all that can be checked without
+    // deserializing the whole block.
+    CBlockHeader header;
+    try {
+        const size_t nHeaderSize = std::min(block.size(), (size_t)::GetSerializeSize(header, SER_DISK, CLIENT_VERSION));
+        CDataStream ssHeader((const char*)block.data(), (const char*)block.data() + nHeaderSize, SER_DISK, CLIENT_VERSION);
+        ssHeader >> header;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pindex->GetBlockPos().ToString());
+    }
+    if (header.GetHash() != pindex->GetBlockHash())
+        return error("ReadRawBlockFromDisk(CBlockIndex*): GetHash() doesn't match index for %s at %s",
+                pindex->ToString(), pindex->GetBlockPos().ToString());
+    return true;
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     int halvings = nHeight / consensusParams.nSubsidyHalvingInterval;
@@ -1242,16 +1474,25 @@ int GetSpendHeight(const CCoinsViewCache& inputs)
 
 static CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
 static uint256 scriptExecutionCacheNonce(GetRandHash());
+//! Guarded by cs_main, like the script execution cache itself
+static ValidationCacheStats scriptExecutionCacheStats = {};
 
 void InitScriptExecutionCache() {
     // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
     // setup_bytes creates the minimum possible cache (2 elements).
     size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
     size_t nElems = scriptExecutionCache.setup_bytes(nMaxCacheSize);
+    scriptExecutionCacheStats.nCapacity = nElems;
     LogPrintf("Using %zu MiB out of %zu/2 requested for script execution cache, able to store %zu elements\n",
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
 }
 
+ValidationCacheStats GetScriptExecutionCacheStats()
+{
+    LOCK(cs_main);
+    return scriptExecutionCacheStats;
+}
+
 /**
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set.
@@ -1266,13 +1507,15 @@ void InitScriptExecutionCache() {
  *
  * Non-static (and re-declared) in src/test/txvalidationcache_tests.cpp
  */
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
+/**
+ * The script part of CheckInputs, given the coins spent by tx in the order of
+ * its inputs. The caller must already have checked the input values.
+ */
+template <typename SpentCoins>
+static bool CheckInputScripts(const CTransaction& tx, CValidationState &state, const SpentCoins& coins, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
 {
     if (!tx.IsCoinBase())
     {
-        if (!Consensus::CheckTxInputs(tx, state, inputs, GetSpendHeight(inputs)))
-            return false;
-
         if (pvChecks)
             pvChecks->reserve(tx.vin.size());
 
@@ -1298,12 +1541,13 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
             CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
             AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
             if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
+                scriptExecutionCacheStats.nHits++;
                 return true;
             }
+            scriptExecutionCacheStats.nMisses++;
 
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
-                const COutPoint &prevout = tx.vin[i].prevout;
-                const Coin& coin = inputs.AccessCoin(prevout);
+                const Coin& coin = coins[i];
                 assert(!coin.IsSpent());
 
                 // We very carefully only pass in things to CScriptCheck which
@@ -1346,7 +1590,9 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
             if (cacheFullScriptStore && !pvChecks) {
                 // We executed all of the provided scripts, and were told to
                 // cache the result. Do so now.
-                scriptExecutionCache.insert(hashCacheEntry);
+                if (scriptExecutionCache.insert(hashCacheEntry))
+                    scriptExecutionCacheStats.nEvictions++;
+                scriptExecutionCacheStats.nInserts++;
             }
         }
     }
@@ -1354,57 +1600,31 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
     return true;
 }
 
-namespace {
-
-bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
 {
-    // Open history file to append
-    CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s: OpenUndoFile failed", __func__);
+    if (!tx.IsCoinBase() && !Consensus::CheckTxInputs(tx, state, inputs, GetSpendHeight(inputs)))
+        return false;
 
-    // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, blockundo);
-    fileout << FLATDATA(messageStart) << nSize;
+    return CheckInputScripts(tx, state, CTxSpentCoins(inputs, tx), fScriptChecks, flags, cacheSigStore, cacheFullScriptStore, txdata, pvChecks);
+}
 
-    // Write undo data
-    long fileOutPos = ftell(fileout.Get());
-    if (fileOutPos < 0)
-        return error("%s: ftell failed", __func__);
-    pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+namespace {
 
-    // calculate & write checksum
+bool UndoWriteToDisk(const CBlockUndo& blockundo, CStoredData& storedUndo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
+{
+    // calculate checksum, which always covers the uncompressed data
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
     hasher << hashBlock;
     hasher << blockundo;
-    fileout << hasher.GetHash();
+    const uint256 hashChecksum = hasher.GetHash();
 
-    return true;
-}
-
-bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
-{
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("%s: OpenUndoFile failed", __func__);
-
-    // Read block
-    uint256 hashChecksum;
-    CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
-    try {
-        verifier << hashBlock;
-        verifier >> blockundo;
-        filein >> hashChecksum;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-    }
-
-    // Verify checksum
-    if (hashChecksum != verifier.GetHash())
-        return error("%s: Checksum mismatch", __func__);
+    // Queue the index header, undo data and checksum for the writer thread
+    storedUndo.WriteHeader(messageStart);
+    storedUndo.data.insert(storedUndo.data.end(), hashChecksum.begin(), hashChecksum.end());
+    const CDiskBlockPos posHeader = pos;
+    pos.nPos += STORED_HEADER_SIZE;
+    if (!g_block_writer.Write(posHeader, true, std::move(storedUndo.data)))
+        return error("%s: writing undo data failed", __func__);
 
     return true;
 }
@@ -1429,6 +1649,49 @@ bool AbortNode(CValidationState& state, const std::string& strMessage, const std
 
 } // namespace
 
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
+{
+    if (pos.nPos < STORED_HEADER_SIZE)
+        return error("%s: invalid position %s", __func__, pos.ToString());
+    g_block_writer.WaitForFile(pos.nFile, true);
+
+    // Open history file to read, at the header in front of the undo data
+    CAutoFile filein(OpenUndoFile(StoredHeaderPos(pos), true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenUndoFile failed", __func__);
+
+    // Read block
+    uint256 hashChecksum;
+    uint256 hashData;
+    try {
+        bool fCompressed;
+        unsigned int nSize = ReadStoredHeader(filein, fCompressed);
+        if (fCompressed) {
+            CDataStream ssUndo(SER_DISK, CLIENT_VERSION);
+            ReadCompressedData(filein, nSize, ssUndo);
+            CHashVerifier<CDataStream> verifier(&ssUndo);
+            verifier << hashBlock;
+            verifier >> blockundo;
+            hashData = verifier.GetHash();
+        } else {
+            CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
+            verifier << hashBlock;
+            verifier >> blockundo;
+            hashData = verifier.GetHash();
+        }
+        filein >> hashChecksum;
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    // Verify checksum
+    if (hashChecksum != hashData)
+        return error("%s: Checksum mismatch", __func__);
+
+    return true;
+}
+
 enum DisconnectResult
 {
     DISCONNECT_OK,      // All good.
@@ -1534,27 +1797,17 @@ static DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex*
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
-void static FlushBlockFile(bool fFinalize = false)
+/**
+ * Queue flushing the current block and undo file to disk, behind the data
+ * queued for them. Use g_block_writer.Wait() to wait until that is done.
+ */
+static bool FlushBlockFile(bool fFinalize = false)
 {
     LOCK(cs_LastBlockFile);
 
-    CDiskBlockPos posOld(nLastBlockFile, 0);
-
-    FILE *fileOld = OpenBlockFile(posOld);
-    if (fileOld) {
-        if (fFinalize)
-            TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
-        FileCommit(fileOld);
-        fclose(fileOld);
-    }
-
-    fileOld = OpenUndoFile(posOld);
-    if (fileOld) {
-        if (fFinalize)
-            TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nUndoSize);
-        FileCommit(fileOld);
-        fclose(fileOld);
-    }
+    const CBlockFileInfo& info = vinfoBlockFile[nLastBlockFile];
+    return g_block_writer.Commit(nLastBlockFile, false, fFinalize, info.nSize) &&
+           g_block_writer.Commit(nLastBlockFile, true, fFinalize, info.nUndoSize);
 }
 
 static bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigned int nAddSize);
@@ -1566,6 +1819,163 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Closure representing the lookup of one coin in the coins database, so that
+ * the coins a block spends can be read by several threads at once.
+ */
+class CCoinPrefetch
+{
+private:
+    const CCoinsView *view;
+    COutPoint outpoint;
+    Coin *pcoin;
+
+public:
+    CCoinPrefetch() : view(nullptr), pcoin(nullptr) {}
+    CCoinPrefetch(const CCoinsView *viewIn, const COutPoint &outpointIn, Coin *pcoinIn) : view(viewIn), outpoint(outpointIn), pcoin(pcoinIn) {}
+
+    bool operator()() {
+        try {
+            if (!view->GetCoin(outpoint, *pcoin))
+                pcoin->Clear();
+        } catch (const std::exception&) {
+            // Leave it to the lookup in ConnectBlock, which handles errors.
+            pcoin->Clear();
+        }
+        return true;
+    }
+
+    void swap(CCoinPrefetch &check) {
+        std::swap(view, check.view);
+        std::swap(outpoint, check.outpoint);
+        std::swap(pcoin, check.pcoin);
+    }
+};
+
+static CCheckQueue<CCoinPrefetch> prefetchqueue(16);
+
+void ThreadCoinPrefetch() {
+    RenameThread("bitcoin-prefetch");
+    prefetchqueue.Thread();
+}
+
+/**
+ * Closure representing the checks of one transaction of a block that only
+ * depend on the transaction and the coins it spends: the input values, the
+ * signature operation cost and the precomputed signature hash data. These run
+ * in parallel in ConnectBlock, after the block's inputs have been spent in
+ * order. Failures are recorded in the result rather than returned, so that
+ * every transaction is checked and the first failure in block order can be
+ * reported.
+ */
+class CTxInputCheck
+{
+public:
+    struct Result {
+        bool fValid;
+        CValidationState state;
+        int64_t nSigOpsCost;
+        CAmount nFee;
+
+        Result() : fValid(false), nSigOpsCost(0), nFee(0) {}
+    };
+
+private:
+    const CTransaction *ptx;
+    const std::vector<Coin> *pspentCoins;
+    int nSpendHeight;
+    unsigned int nFlags;
+    PrecomputedTransactionData *ptxdata;
+    Result *presult;
+
+public:
+    CTxInputCheck() : ptx(nullptr), pspentCoins(nullptr), nSpendHeight(0), nFlags(0), ptxdata(nullptr), presult(nullptr) {}
+    CTxInputCheck(const CTransaction& txIn, const std::vector<Coin>& spentCoinsIn, int nSpendHeightIn, unsigned int nFlagsIn, PrecomputedTransactionData* ptxdataIn, Result* presultIn) :
+        ptx(&txIn), pspentCoins(&spentCoinsIn), nSpendHeight(nSpendHeightIn), nFlags(nFlagsIn), ptxdata(ptxdataIn), presult(presultIn) {}
+
+    bool operator()() {
+        const CTransaction& tx = *ptx;
+        // GetTransactionSigOpCost counts 3 types of sigops:
+        // * legacy (always)
+        // * p2sh (when P2SH enabled in flags and excludes coinbase)
+        // * witness (when witness enabled in flags and excludes coinbase)
+        presult->nSigOpsCost = GetTransactionSigOpCost(tx, *pspentCoins, nFlags);
+        if (!tx.IsCoinBase()) {
+            if (!Consensus::CheckTxInputs(tx, presult->state, *pspentCoins, nSpendHeight))
+                return true;
+            CAmount nValueIn = 0;
+            for (const Coin& coin : *pspentCoins) {
+                nValueIn += coin.out.nValue;
+            }
+            presult->nFee = nValueIn - tx.GetValueOut();
+        }
+        *ptxdata = PrecomputedTransactionData(tx);
+        presult->fValid = true;
+        return true;
+    }
+
+    void swap(CTxInputCheck &check) {
+        std::swap(ptx, check.ptx);
+        std::swap(pspentCoins, check.pspentCoins);
+        std::swap(nSpendHeight, check.nSpendHeight);
+        std::swap(nFlags, check.nFlags);
+        std::swap(ptxdata, check.ptxdata);
+        std::swap(presult, check.presult);
+    }
+};
+
+static CCheckQueue<CTxInputCheck> txinputcheckqueue(16);
+
+void ThreadTxInputCheck() {
+    RenameThread("bitcoin-txinput");
+    txinputcheckqueue.Thread();
+}
+
+/**
+ * Read the coins spent by a block that are not in pcoinsTip's cache yet from
+ * the database in parallel, and add them to the cache. Otherwise ConnectBlock
+ * waits for a database read on every cache miss, one after the other.
+ */
+static void PrefetchBlockInputs(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+    // Without worker threads this would only do the reads ConnectBlock does.
+    if (!nScriptCheckThreads)
+        return;
+
+    std::unordered_set<uint256, SaltedTxidHasher> setBlockTxids;
+    for (const auto& tx : block.vtx) {
+        setBlockTxids.insert(tx->GetHash());
+    }
+    std::vector<COutPoint> vOutpoints;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            // Outputs created in the block are not in the database.
+            if (!setBlockTxids.count(txin.prevout.hash) && !pcoinsTip->HaveCoinInCache(txin.prevout))
+                vOutpoints.push_back(txin.prevout);
+        }
+    }
+    if (vOutpoints.empty())
+        return;
+
+    std::vector<Coin> vCoins(vOutpoints.size());
+    std::vector<CCoinPrefetch> vChecks;
+    vChecks.reserve(vOutpoints.size());
+    for (size_t i = 0; i < vOutpoints.size(); i++) {
+        vChecks.emplace_back(pcoinsdbview, vOutpoints[i], &vCoins[i]);
+    }
+    CCheckQueueControl<CCoinPrefetch> control(&prefetchqueue);
+    control.Add(vChecks);
+    control.Wait();
+
+    for (size_t i = 0; i < vOutpoints.size(); i++) {
+        if (!vCoins[i].IsSpent())
+            pcoinsTip->AddPrefetchedCoin(vOutpoints[i], std::move(vCoins[i]));
+    }
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1781,15 +2191,10 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
 
     std::vector<int> prevheights;
-    CAmount nFees = 0;
     int nInputs = 0;
-    int64_t nSigOpsCost = 0;
-    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
-    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
-    vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
-    std::vector<PrecomputedTransactionData> txdata;
-    txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
+    // Spend the inputs of the transactions in block order, which is all that
+    // needs the view. The undo data then holds the coins each one spent.
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
@@ -1816,36 +2221,66 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
             }
         }
 
-        // GetTransactionSigOpCost counts 3 types of sigops:
-        // * legacy (always)
-        // * p2sh (when P2SH enabled in flags and excludes coinbase)
-        // * witness (when witness enabled in flags and excludes coinbase)
-        nSigOpsCost += GetTransactionSigOpCost(tx, view, flags);
+        CTxUndo undoDummy;
+        if (i > 0) {
+            blockundo.vtxundo.push_back(CTxUndo());
+        }
+        UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
+    }
+
+    // Check the input values and count the sigops of all transactions in
+    // parallel, while precomputing their signature hash data.
+    static const std::vector<Coin> vNoSpentCoins;
+    std::vector<PrecomputedTransactionData> txdata(block.vtx.size());
+    std::vector<CTxInputCheck::Result> vInputResults(block.vtx.size());
+    {
+        std::vector<CTxInputCheck> vInputChecks;
+        vInputChecks.reserve(block.vtx.size());
+        for (unsigned int i = 0; i < block.vtx.size(); i++) {
+            const std::vector<Coin>& spentCoins = i == 0 ? vNoSpentCoins : blockundo.vtxundo[i - 1].vprevout;
+            vInputChecks.emplace_back(*block.vtx[i], spentCoins, pindex->nHeight, flags, &txdata[i], &vInputResults[i]);
+        }
+        if (nScriptCheckThreads) {
+            CCheckQueueControl<CTxInputCheck> inputcontrol(&txinputcheckqueue);
+            inputcontrol.Add(vInputChecks);
+            inputcontrol.Wait();
+        } else {
+            for (CTxInputCheck& check : vInputChecks) {
+                check();
+            }
+        }
+    }
+
+    // Tally the results in block order and queue the script checks.
+    CAmount nFees = 0;
+    int64_t nSigOpsCost = 0;
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+    {
+        const CTransaction &tx = *(block.vtx[i]);
+        const CTxInputCheck::Result& result = vInputResults[i];
+
+        nSigOpsCost += result.nSigOpsCost;
         if (nSigOpsCost > MAX_BLOCK_SIGOPS_COST)
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                              REJECT_INVALID, "bad-blk-sigops");
 
-        txdata.emplace_back(tx);
+        if (!result.fValid) {
+            state = result.state;
+            return error("ConnectBlock(): CheckInputs on %s failed with %s",
+                tx.GetHash().ToString(), FormatStateMessage(state));
+        }
+
         if (!tx.IsCoinBase())
         {
-            nFees += view.GetValueIn(tx)-tx.GetValueOut();
+            nFees += result.nFee;
 
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : nullptr))
+            if (!CheckInputScripts(tx, state, blockundo.vtxundo[i - 1].vprevout, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : nullptr))
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
         }
-
-        CTxUndo undoDummy;
-        if (i > 0) {
-            blockundo.vtxundo.push_back(CTxUndo());
-        }
-        UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
-
-        vPos.push_back(std::make_pair(tx.GetHash(), pos));
-        pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]\n", (unsigned)block.vtx.size(), 0.001 * (nTime3 - nTime2), 0.001 * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * 0.000001);
@@ -1870,9 +2305,10 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     {
         if (pindex->GetUndoPos().IsNull()) {
             CDiskBlockPos _pos;
-            if (!FindUndoPos(state, pindex->nFile, _pos, ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION) + 40))
+            CStoredData storedUndo(blockundo);
+            if (!FindUndoPos(state, pindex->nFile, _pos, storedUndo.Size() + 40))
                 return error("ConnectBlock(): FindUndoPos failed");
-            if (!UndoWriteToDisk(blockundo, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
+            if (!UndoWriteToDisk(blockundo, storedUndo, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
                 return AbortNode(state, "Failed to write undo data");
 
             // update nUndoPos in block index
@@ -1884,10 +2320,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         setDirtyBlockIndex.insert(pindex);
     }
 
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
-            return AbortNode(state, "Failed to write transaction index");
-
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -1964,7 +2396,8 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             if (!CheckDiskSpace(0))
                 return state.Error("out of disk space");
             // First make sure all block and undo data is flushed to disk.
-            FlushBlockFile();
+            if (!FlushBlockFile() || !g_block_writer.Wait())
+                return AbortNode(state, "Failed to write block and undo data");
             // Then update all block file information (which may refer to block and undo files).
             {
                 std::vector<std::pair<int, const CBlockFileInfo*> > vFiles;
@@ -1998,7 +2431,14 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
             // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            // Only the modified coins are written, in the background; the
+            // cache keeps what was used recently and drops the rest until
+            // there is room to grow again.
+            if (!pcoinsTip->Sync((3 * nTotalSpace) / 4))
+                return AbortNode(state, "Failed to write to coin database");
+            // Callers asking for a full flush, and pruning, which has
+            // already removed block files, need the chainstate on disk now.
+            if ((mode == FLUSH_STATE_ALWAYS || fFlushForPrune) && !pcoinsdbview->WaitForWrite())
                 return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
         }
@@ -2147,6 +2587,7 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -2242,6 +2683,9 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+    PrefetchBlockInputs(blockConnecting);
+    int64_t nTime2_1 = GetTimeMicros(); nTimePrefetch += nTime2_1 - nTime2;
+    LogPrint(BCLog::BENCH, "  - Prefetch inputs: %.2fms [%.2fs]\n", (nTime2_1 - nTime2) * 0.001, nTimePrefetch * 0.000001);
     {
         CCoinsViewCache view(pcoinsTip);
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
@@ -2251,8 +2695,8 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
                 InvalidBlockFound(pindexNew, state);
             return error("ConnectTip(): ConnectBlock %s failed", pindexNew->GetBlockHash().ToString());
         }
-        nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
-        LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2) * 0.001, nTimeConnectTotal * 0.000001);
+        nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2_1;
+        LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2_1) * 0.001, nTimeConnectTotal * 0.000001);
         bool flushed = view.Flush();
         assert(flushed);
     }
@@ -2761,7 +3205,8 @@ static bool FindBlockPos(CValidationState &state, CDiskBlockPos &pos, unsigned i
         if (!fKnown) {
             LogPrintf("Leaving block file %i: %s\n", nLastBlockFile, vinfoBlockFile[nLastBlockFile].ToString());
         }
-        FlushBlockFile(!fKnown);
+        if (!FlushBlockFile(!fKnown))
+            return AbortNode(state, "Failed to write block data");
         nLastBlockFile = nFile;
     }
 
@@ -3298,15 +3743,22 @@ static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidation
 
     // Write block to history file
     try {
-        unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
         CDiskBlockPos blockPos;
-        if (dbp != nullptr)
+        if (dbp != nullptr) {
+            // The block is already on disk, possibly compressed.
             blockPos = *dbp;
-        if (!FindBlockPos(state, blockPos, nBlockSize+8, nHeight, block.GetBlockTime(), dbp != nullptr))
-            return error("AcceptBlock(): FindBlockPos failed");
-        if (dbp == nullptr)
-            if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart()))
+            unsigned int nStoredSize;
+            if (!ReadStoredSize(blockPos, nStoredSize))
+                return error("AcceptBlock(): ReadStoredSize failed");
+            if (!FindBlockPos(state, blockPos, nStoredSize+8, nHeight, block.GetBlockTime(), true))
+                return error("AcceptBlock(): FindBlockPos failed");
+        } else {
+            CStoredData storedBlock(block);
+            if (!FindBlockPos(state, blockPos, storedBlock.Size()+8, nHeight, block.GetBlockTime()))
+                return error("AcceptBlock(): FindBlockPos failed");
+            if (!WriteBlockToDisk(storedBlock, blockPos, chainparams.MessageStart()))
                 AbortNode(state, "Failed to write block");
+        }
         if (!ReceivedBlockTransactions(block, state, pindex, blockPos, chainparams.GetConsensus()))
             return error("AcceptBlock(): ReceivedBlockTransactions failed");
     } catch (const std::runtime_error& e) {
@@ -3431,6 +3883,9 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        g_block_writer.WaitForFile(*it, false);
+        g_block_writer.WaitForFile(*it, true);
+        g_block_file_map.Unmap(*it);
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -3599,7 +4054,12 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
 
 bool static LoadBlockIndexDB(const CChainParams& chainparams)
 {
-    if (!pblocktree->LoadBlockIndexGuts(chainparams.GetConsensus(), InsertBlockIndex))
+    // Headers at or below the last checkpoint had their proof of work checked
+    // when they were accepted, and the checkpoint pins the chain through
+    // them; only check that they hash to their keys.
+    const MapCheckpoints& checkpoints = chainparams.Checkpoints().mapCheckpoints;
+    const int nTrustedHeight = fCheckpointsEnabled && !checkpoints.empty() ? checkpoints.rbegin()->first : -1;
+    if (!pblocktree->LoadBlockIndexGuts(chainparams.GetConsensus(), InsertBlockIndex, nTrustedHeight, std::max(nScriptCheckThreads, 1)))
         return false;
 
     boost::this_thread::interruption_point();
@@ -3640,6 +4100,8 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
             setBlockIndexCandidates.insert(pindex);
         if (pindex->nStatus & BLOCK_FAILED_MASK && (!pindexBestInvalid || pindex->nChainWork > pindexBestInvalid->nChainWork))
             pindexBestInvalid = pindex;
+        if (pindex->nStatus & BLOCK_ASSUMED_VALID)
+            fHaveAssumedValid = true;
         if (pindex->pprev)
             pindex->BuildSkip();
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == nullptr || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
@@ -3691,10 +4153,6 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadReindexing(fReindexing);
     fReindex |= fReindexing;
 
-    // Check whether we have a transaction index
-    pblocktree->ReadFlag("txindex", fTxIndex);
-    LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
-
     return true;
 }
 
@@ -3772,6 +4230,11 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
         }
+        if (pindex->nStatus & BLOCK_ASSUMED_VALID) {
+            // Blocks below a UTXO snapshot were never seen.
+            LogPrintf("VerifyDB(): block verification stopping at height %d (UTXO snapshot)\n", pindex->nHeight);
+            break;
+        }
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
@@ -3856,6 +4319,8 @@ bool ReplayBlocks(const CChainParams& params, CCoinsView* view)
 {
     LOCK(cs_main);
 
+    // The rolling hash of a database left mid-write is not known, so there
+    // is none to keep up to date; RebuildSetHash computes it afterwards.
     CCoinsViewCache cache(view);
 
     std::vector<uint256> hashHeads = view->GetHeadBlocks();
@@ -3874,6 +4339,10 @@ bool ReplayBlocks(const CChainParams& params, CCoinsView* view)
     }
     pindexNew = mapBlockIndex[hashHeads[0]];
 
+    if (hashHeads[1].IsNull() && (pindexNew->nStatus & BLOCK_ASSUMED_VALID)) {
+        return error("ReplayBlocks(): loading the UTXO snapshot at %s was interrupted, load it again with -loadtxoutset", hashHeads[0].ToString());
+    }
+
     if (!hashHeads[1].IsNull()) { // The old tip is allowed to be 0, indicating it's the first flush.
         if (mapBlockIndex.count(hashHeads[1]) == 0) {
             return error("ReplayBlocks(): reorganization from unknown block requested");
@@ -4038,6 +4507,7 @@ void UnloadBlockIndex()
     }
     mapBlockIndex.clear();
     fHavePruned = false;
+    fHaveAssumedValid = false;
 }
 
 bool LoadBlockIndex(const CChainParams& chainparams)
@@ -4058,9 +4528,6 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         // needs_init.
 
         LogPrintf("Initializing databases...\n");
-        // Use the provided setting for -txindex in the new database
-        fTxIndex = gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX);
-        pblocktree->WriteFlag("txindex", fTxIndex);
     }
     return true;
 }
@@ -4079,12 +4546,12 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     try {
         CBlock &block = const_cast<CBlock&>(chainparams.GenesisBlock());
         // Start new block file
-        unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+        CStoredData storedBlock(block);
         CDiskBlockPos blockPos;
         CValidationState state;
-        if (!FindBlockPos(state, blockPos, nBlockSize+8, 0, block.GetBlockTime()))
+        if (!FindBlockPos(state, blockPos, storedBlock.Size()+8, 0, block.GetBlockTime()))
             return error("%s: FindBlockPos failed", __func__);
-        if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart()))
+        if (!WriteBlockToDisk(storedBlock, blockPos, chainparams.MessageStart()))
             return error("%s: writing genesis block to disk failed", __func__);
         CBlockIndex *pindex = AddToBlockIndex(block);
         if (!ReceivedBlockTransactions(block, state, pindex, blockPos, chainparams.GetConsensus()))
@@ -4096,6 +4563,279 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     return true;
 }
 
+bool LoadUTXOSnapshot(const CChainParams& chainparams, const fs::path& path, const uint256& hashExpected)
+{
+    const uint256 hashGenesis = chainparams.GetConsensus().hashGenesisBlock;
+    const uint256 hashBest = pcoinsdbview->GetBestBlock();
+    const std::vector<uint256> vHeads = pcoinsdbview->GetHeadBlocks();
+    // Connecting the genesis block creates no coins. Heads with no old tip
+    // are left by a first flush or a load that did not finish.
+    if (!(vHeads.empty() && (hashBest.IsNull() || hashBest == hashGenesis)) && !(vHeads.size() == 2 && vHeads[1].IsNull())) {
+        LogPrintf("%s: chainstate is not empty, not loading %s\n", __func__, path.string());
+        return true;
+    }
+
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return error("%s: failed to open %s", __func__, path.string());
+    LogPrintf("Loading UTXO snapshot %s\n", path.string());
+    uiInterface.InitMessage(_("Loading UTXO snapshot..."));
+
+    CUTXOSnapshotHeader header;
+    try {
+        file >> header;
+    } catch (const std::exception& e) {
+        return error("%s: failed to read %s: %s", __func__, path.string(), e.what());
+    }
+    if (header.vHeaders.empty() || header.vHeaders.back().GetHash() != header.hashBlock || header.vHeaders.front().hashPrevBlock != hashGenesis)
+        return error("%s: snapshot headers do not lead from the genesis block to %s", __func__, header.hashBlock.ToString());
+    for (size_t i = 1; i < header.vHeaders.size(); i++) {
+        if (header.vHeaders[i].hashPrevBlock != header.vHeaders[i - 1].GetHash())
+            return error("%s: snapshot headers are not a chain", __func__);
+    }
+
+    // The headers get the same checks as those from the network.
+    for (size_t i = 0; i < header.vHeaders.size(); i += MAX_HEADERS_RESULTS) {
+        const std::vector<CBlockHeader> vHeaders(header.vHeaders.begin() + i, header.vHeaders.begin() + std::min(i + MAX_HEADERS_RESULTS, header.vHeaders.size()));
+        CValidationState state;
+        if (!ProcessNewBlockHeaders(vHeaders, state, chainparams))
+            return error("%s: snapshot headers rejected: %s", __func__, FormatStateMessage(state));
+    }
+
+    // Write the coins while hashing them, in the order they come, which is
+    // key order. Nothing refers to them until the hash matched and the load
+    // is finished, and a snapshot that does not match is removed again.
+    const int nBaseHeight = header.vHeaders.size();
+    CCoinsSetHash setHash;
+    try {
+        if (!pcoinsdbview->BeginLoad(header.hashBlock))
+            return error("%s: failed to start loading", __func__);
+        CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+        ss << header.hashBlock;
+        std::vector<std::pair<COutPoint, Coin> > vCoins;
+        uint256 hash, hashPrev;
+        std::map<uint32_t, Coin> outputs;
+        uint64_t nCoins = 0;
+        std::string strInvalid;
+        for (uint64_t i = 0; i < header.nTransactions; i++) {
+            // Transactions must be in txid order, as the hash and the
+            // database expect them.
+            if (!ReadSnapshotTransaction(file, hash, outputs) || (i > 0 && !(hashPrev < hash)) ||
+                outputs.begin()->second.nHeight > (uint32_t)nBaseHeight) {
+                strInvalid = strprintf("invalid snapshot transaction %s", hash.ToString());
+                break;
+            }
+            HashTxOutputs(ss, hash, outputs);
+            nCoins += outputs.size();
+            hashPrev = hash;
+            for (auto& output : outputs) {
+                const COutPoint outpoint(hash, output.first);
+                setHash.AddCoin(outpoint, output.second);
+                vCoins.emplace_back(outpoint, std::move(output.second));
+            }
+            if (vCoins.size() >= 100000 || i + 1 == header.nTransactions) {
+                if (!pcoinsdbview->LoadCoins(vCoins))
+                    return error("%s: failed to write coins", __func__);
+                vCoins.clear();
+                uiInterface.ShowProgress(_("Loading UTXO snapshot..."), (int)(i * 100 / header.nTransactions));
+                if (ShutdownRequested())
+                    return false;
+            }
+        }
+        uiInterface.ShowProgress("", 100);
+        if (strInvalid.empty() && nCoins != header.nCoins)
+            strInvalid = strprintf("snapshot has %u coins instead of %u", nCoins, header.nCoins);
+        const uint256 hashSnapshot = ss.GetHash();
+        // The expected hash can also be the muhash, which the trusted node
+        // reports without reading its whole UTXO set.
+        if (strInvalid.empty() && hashSnapshot != hashExpected) {
+            const uint256 hashMuHash = setHash.GetHash();
+            if (hashMuHash != hashExpected)
+                strInvalid = strprintf("snapshot hash %s (muhash %s) does not match %s", hashSnapshot.ToString(), hashMuHash.ToString(), hashExpected.ToString());
+        }
+        if (!strInvalid.empty()) {
+            if (!pcoinsdbview->AbortLoad())
+                return error("%s: %s, and failed to remove the coins loaded", __func__, strInvalid);
+            return error("%s: %s", __func__, strInvalid);
+        }
+    } catch (const std::exception& e) {
+        pcoinsdbview->AbortLoad();
+        return error("%s: failed to read %s: %s", __func__, path.string(), e.what());
+    }
+
+    {
+        LOCK(cs_main);
+        // The snapshot stands in for the blocks up to its base: treat those
+        // we never saw as valid, and count transactions so that the base
+        // gets the chain transaction count it had where it was taken.
+        CBlockIndex* pindexBase = mapBlockIndex[header.hashBlock];
+        std::vector<const CBlockIndex*> vBlocks;
+        for (int nHeight = 1; nHeight <= pindexBase->nHeight; nHeight++) {
+            CBlockIndex* pindex = pindexBase->GetAncestor(nHeight);
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA)) {
+                pindex->nTx = pindex == pindexBase ? std::max<int64_t>(1, (int64_t)header.nChainTx - pindex->pprev->nChainTx) : 1;
+                pindex->nStatus |= BLOCK_ASSUMED_VALID | BLOCK_OPT_WITNESS;
+            }
+            pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
+            pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
+            setDirtyBlockIndex.erase(pindex);
+            vBlocks.push_back(pindex);
+        }
+        setBlockIndexCandidates.insert(pindexBase);
+        fHaveAssumedValid = true;
+        if (!pblocktree->WriteBatchSync(std::vector<std::pair<int, const CBlockFileInfo*> >(), nLastBlockFile, vBlocks))
+            return error("%s: failed to write the block index", __func__);
+    }
+
+    if (!pcoinsdbview->FinishLoad(header.hashBlock, setHash))
+        return error("%s: failed to finish loading", __func__);
+    LogPrintf("Loaded UTXO snapshot of %u coins at %s (height %d)\n", header.nCoins, header.hashBlock.ToString(), header.vHeaders.size());
+    return true;
+}
+
+namespace {
+
+/** Bytes of a block file read ahead of the block being inserted. */
+static const uint64_t BLOCK_LOAD_WINDOW_SIZE = 2 * MAX_BLOCK_SERIALIZED_SIZE;
+/** Maximum number of blocks read ahead of the block being inserted. */
+static const size_t BLOCK_LOAD_WINDOW_BLOCKS = 1024;
+
+/** A block read from an external block file, awaiting deserialization. */
+struct CBlockLoadJob
+{
+    CDataStream ssBlock;       //!< serialized block as found in the file
+    unsigned int nSize;        //!< size the file claims for the block
+    bool fCompressed;          //!< whether the block is stored compressed
+    uint64_t nHeaderPos;       //!< file position just past the block's first message start byte
+    uint64_t nBlockPos;        //!< file position of the serialized block
+    std::shared_ptr<CBlock> pblock;
+    uint256 hash;
+    uint64_t nConsumed;        //!< bytes the block actually deserialized from
+    std::string strError;      //!< deserialization error, if any
+    bool fDone;
+
+    CBlockLoadJob() : ssBlock(SER_DISK, CLIENT_VERSION), nSize(0), fCompressed(false), nHeaderPos(0), nBlockPos(0), nConsumed(0), fDone(false) {}
+};
+
+/**
+ * Thread pool deserializing blocks for LoadExternalBlockFile. Besides the
+ * transaction hashes computed while deserializing, each block's hash and
+ * merkle root are checked by CheckBlock, which caches a positive result in
+ * CBlock::fChecked so AcceptBlock does not redo the work under cs_main.
+ * Jobs may complete in any order; the loading thread waits for them in
+ * file order and helps out with queued jobs while it does.
+ */
+class CBlockLoadQueue
+{
+private:
+    boost::mutex mutex;
+    boost::condition_variable condWorker;
+    boost::condition_variable condDone;
+    std::deque<std::shared_ptr<CBlockLoadJob>> queue;
+    boost::thread_group threads;
+    const Consensus::Params& consensusParams;
+    bool fQuit;
+
+    void Process(CBlockLoadJob& job)
+    {
+        try {
+            job.pblock = std::make_shared<CBlock>();
+            if (job.fCompressed) {
+                CDataStream ssRaw(SER_DISK, CLIENT_VERSION);
+                if (!DecompressStoredData((const unsigned char*)job.ssBlock.data(), job.ssBlock.size(), ssRaw))
+                    throw std::ios_base::failure("Compressed block corrupted");
+                ssRaw >> *job.pblock;
+                // The size in the file, not the block, delimits compressed data.
+                job.nConsumed = job.nSize;
+            } else {
+                job.ssBlock >> *job.pblock;
+                job.nConsumed = job.nSize - job.ssBlock.size();
+            }
+            job.hash = job.pblock->GetHash();
+            CValidationState state;
+            CheckBlock(*job.pblock, state, consensusParams);
+        } catch (const std::exception& e) {
+            job.strError = e.what();
+        }
+        job.ssBlock.clear();
+    }
+
+    /** Run the oldest queued job. Called with the lock held. */
+    void RunNext(boost::unique_lock<boost::mutex>& lock)
+    {
+        std::shared_ptr<CBlockLoadJob> job = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        Process(*job);
+        lock.lock();
+        job->fDone = true;
+        condDone.notify_all();
+    }
+
+    void Loop()
+    {
+        RenameThread("bitcoin-blkload");
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (true) {
+            while (queue.empty() && !fQuit) {
+                condWorker.wait(lock);
+            }
+            if (fQuit) {
+                return;
+            }
+            RunNext(lock);
+        }
+    }
+
+public:
+    CBlockLoadQueue(const Consensus::Params& params, int nThreads) : consensusParams(params), fQuit(false)
+    {
+        for (int i = 0; i < nThreads; i++) {
+            threads.create_thread([this] { Loop(); });
+        }
+    }
+
+    ~CBlockLoadQueue()
+    {
+        boost::this_thread::disable_interruption di;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            fQuit = true;
+        }
+        condWorker.notify_all();
+        threads.join_all();
+    }
+
+    void Add(const std::shared_ptr<CBlockLoadJob>& job)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        queue.push_back(job);
+        condWorker.notify_one();
+    }
+
+    //! Drop the jobs no thread has started on yet.
+    void Clear()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        queue.clear();
+    }
+
+    //! Wait until job has been processed, running queued jobs in the meantime.
+    void Wait(const CBlockLoadJob& job)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (!job.fDone) {
+            if (!queue.empty()) {
+                RunNext(lock);
+            } else {
+                condDone.wait(lock);
+            }
+        }
+    }
+};
+
+} // namespace
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
@@ -4104,46 +4844,99 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
 
     int nLoaded = 0;
     try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
+        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor.
+        // Blocks are read up to BLOCK_LOAD_WINDOW_SIZE ahead of the one being inserted,
+        // so keep enough data around to rescan from any of them.
+        CBufferedFile blkdat(fileIn, BLOCK_LOAD_WINDOW_SIZE + 3*(MAX_BLOCK_SERIALIZED_SIZE+8), BLOCK_LOAD_WINDOW_SIZE + 2*(MAX_BLOCK_SERIALIZED_SIZE+8), SER_DISK, CLIENT_VERSION);
+        CBlockLoadQueue loadqueue(chainparams.GetConsensus(), std::max(nReindexThreads - 1, 0));
+        std::deque<std::shared_ptr<CBlockLoadJob>> vPending;
         uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        bool fScanned = false; // whether the rest of the file has been handed to loadqueue
+        while (true) {
             boost::this_thread::interruption_point();
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
+            // Read ahead and hand the blocks found to the worker threads
+            while (!fScanned && vPending.size() < BLOCK_LOAD_WINDOW_BLOCKS &&
+                   (vPending.empty() || blkdat.GetPos() - vPending.front()->nHeaderPos < BLOCK_LOAD_WINDOW_SIZE)) {
+                if (blkdat.eof()) {
+                    fScanned = true;
+                    break;
+                }
+                blkdat.SetPos(nRewind);
+                nRewind++; // start one byte further next time, in case of failure
+                blkdat.SetLimit(); // remove former limit
+                unsigned int nSize = 0;
+                bool fCompressed = false;
+                try {
+                    // locate a header
+                    unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+                    blkdat.FindByte(chainparams.MessageStart()[0]);
+                    nRewind = blkdat.GetPos()+1;
+                    blkdat >> FLATDATA(buf);
+                    if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
+                        continue;
+                    // read size
+                    blkdat >> nSize;
+                    fCompressed = (nSize & STORED_DATA_COMPRESSED) != 0;
+                    nSize &= ~STORED_DATA_COMPRESSED;
+                    if (nSize < (fCompressed ? sizeof(uint32_t) : 80) || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                        continue;
+                } catch (const std::exception&) {
+                    // no valid block header found; don't complain
+                    fScanned = true;
+                    break;
+                }
+                std::shared_ptr<CBlockLoadJob> job = std::make_shared<CBlockLoadJob>();
+                job->nSize = nSize;
+                job->fCompressed = fCompressed;
+                job->nHeaderPos = nRewind;
+                try {
+                    // read block
+                    job->nBlockPos = blkdat.GetPos();
+                    job->ssBlock.resize(nSize);
+                    blkdat.read(job->ssBlock.data(), nSize);
+                    nRewind = blkdat.GetPos();
+                    loadqueue.Add(job);
+                } catch (const std::exception& e) {
+                    // reported once the blocks before it have been inserted
+                    job->strError = e.what();
+                    job->fDone = true;
+                }
+                vPending.push_back(job);
+            }
+            if (vPending.empty())
                 break;
+
+            std::shared_ptr<CBlockLoadJob> job = vPending.front();
+            vPending.pop_front();
+            loadqueue.Wait(*job);
+            if (!job->strError.empty() || job->nConsumed != job->nSize) {
+                // Resume scanning where reading the blocks one at a time would
+                // have: one byte into a block that failed to deserialize, or
+                // right after the bytes a block actually used. Anything read
+                // ahead is read again from there.
+                loadqueue.Clear();
+                vPending.clear();
+                nRewind = job->strError.empty() ? job->nBlockPos + job->nConsumed : job->nHeaderPos;
+                if (!blkdat.SetPos(nRewind)) {
+                    LogPrint(BCLog::REINDEX, "%s: Cannot rewind to position %u, rescanning from %u\n", __func__, nRewind, blkdat.GetPos());
+                    nRewind = blkdat.GetPos();
+                }
+                fScanned = false;
+                if (!job->strError.empty()) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, job->strError);
+                    continue;
+                }
             }
+
             try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
+                std::shared_ptr<CBlock> pblock = job->pblock;
+                const CBlock& block = *pblock;
                 if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
+                    dbp->nPos = job->nBlockPos;
 
                 // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
+                const uint256& hash = job->hash;
                 if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
                     LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
                             block.hashPrevBlock.ToString());
@@ -4272,8 +5065,9 @@ void static CheckBlockIndex(const Consensus::Params& consensusParams)
         }
         if (pindex->nChainTx == 0) assert(pindex->nSequenceId <= 0);  // nSequenceId can't be set positive for blocks that aren't linked (negative is used for preciousblock)
         // VALID_TRANSACTIONS is equivalent to nTx > 0 for all nodes (whether or not pruning has occurred).
-        // HAVE_DATA is only equivalent to nTx > 0 (or VALID_TRANSACTIONS) if no pruning has occurred.
-        if (!fHavePruned) {
+        // HAVE_DATA is only equivalent to nTx > 0 (or VALID_TRANSACTIONS) if no pruning has occurred,
+        // and the chain did not start from a UTXO snapshot.
+        if (!fHavePruned && !fHaveAssumedValid) {
             // If we've never pruned, then HAVE_DATA should be equivalent to nTx > 0
             assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
             assert(pindexFirstMissing == pindexFirstNeverProcessed);
@@ -4332,7 +5126,7 @@ void static CheckBlockIndex(const Consensus::Params& consensusParams)
         if (pindexFirstMissing == nullptr) assert(!foundInUnlinked); // We aren't missing data for any parent -- cannot be in mapBlocksUnlinked.
         if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindexFirstNeverProcessed == nullptr && pindexFirstMissing != nullptr) {
             // We HAVE_DATA for this block, have received data for all parents at some point, but we're currently missing data for some parent.
-            assert(fHavePruned); // We must have pruned.
+            assert(fHavePruned || fHaveAssumedValid); // We must have pruned, or started from a snapshot.
             // This block may have entered mapBlocksUnlinked if:
             //  - it has a descendant that at some point had more work than the
             //    tip, and
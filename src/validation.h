@@ -32,6 +32,7 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CChainParams;
 class CCoinsViewDB;
 class CInv;
@@ -43,6 +44,7 @@ class CValidationState;
 struct ChainTxData;
 
 struct PrecomputedTransactionData;
+struct ValidationCacheStats;
 struct LockPoints;
 
 /** Default for DEFAULT_WHITELISTRELAY. */
@@ -80,6 +82,10 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of threads deserializing and hashing blocks during -reindex and -loadblock */
+static const int MAX_REINDEX_THREADS = 16;
+/** -reindexthreads default (number of block loading threads, 0 = auto) */
+static const int DEFAULT_REINDEX_THREADS = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -137,6 +143,8 @@ static const bool DEFAULT_PERSIST_MEMPOOL = true;
 static const bool DEFAULT_ENABLE_REPLACEMENT = true;
 /** Default for using fee filter */
 static const bool DEFAULT_FEEFILTER = true;
+/** Default for -blockcompression */
+static const bool DEFAULT_BLOCK_COMPRESSION = false;
 
 /** Maximum number of headers to announce when relaying blocks with headers message.*/
 static const unsigned int MAX_BLOCKS_TO_ANNOUNCE = 8;
@@ -168,7 +176,7 @@ extern CConditionVariable cvBlockChange;
 extern std::atomic_bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
-extern bool fTxIndex;
+extern int nReindexThreads;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
@@ -194,6 +202,12 @@ extern CBlockIndex *pindexBestHeader;
 /** Minimum disk space required - used in CheckDiskSpace() */
 static const uint64_t nMinDiskSpace = 52428800;
 
+/** Whether new block and undo data is written compressed. Compressed data is always readable. */
+extern bool fBlockCompression;
+
+/** True if the chain was started from a UTXO snapshot, so blocks below it have no data. */
+extern bool fHaveAssumedValid;
+
 /** Pruning-related variables and constants */
 /** True if any block files have ever been pruned. */
 extern bool fHavePruned;
@@ -261,6 +275,12 @@ fs::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = nullptr);
 /** Ensures we have a genesis block in the block tree, possibly writing one to disk. */
 bool LoadGenesisBlock(const CChainParams& chainparams);
+/**
+ * Load the UTXO snapshot at path into an empty chainstate, after checking it
+ * hashes to hashExpected, and accept its block headers. Returns true without
+ * doing anything if the chainstate is not empty.
+ */
+bool LoadUTXOSnapshot(const CChainParams& chainparams, const fs::path& path, const uint256& hashExpected);
 /** Load the block tree and coins database from disk,
  * initializing state if we're running with -reindex. */
 bool LoadBlockIndex(const CChainParams& chainparams);
@@ -270,6 +290,14 @@ bool LoadChainTip(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the coin prefetch thread */
+void ThreadCoinPrefetch();
+/** Run an instance of the transaction input checking thread */
+void ThreadTxInputCheck();
+/** Start writing block and undo data in the background; until then it is written right away */
+void StartBlockWriter();
+/** Write out all pending block and undo data, and stop the background writer */
+void StopBlockWriter();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -392,10 +420,23 @@ public:
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
 
+/** Returns the usage counters of the script-execution cache */
+ValidationCacheStats GetScriptExecutionCacheStats();
+
 
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/**
+ * Read a block as the bytes stored on disk, which are its serialization with
+ * witness data, without deserializing it. The block files are memory mapped
+ * where possible. Checks the magic and size in front of the block, and for
+ * the CBlockIndex version the block hash.
+ */
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
+/** Read the undo data of a block, the outputs it spends. hashBlock is the hash of its parent, which the checksum covers. */
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
 
 /** Functions for validating blocks and updating the block tree */
 
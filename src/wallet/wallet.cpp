@@ -3334,6 +3334,10 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         }
         bool internal = false;
         CWalletDB walletdb(*dbw);
+        std::vector<CPubKey> vNewKeys;
+        std::vector<int64_t> vNewIndexes;
+        vNewKeys.reserve(missingInternal + missingExternal);
+        vNewIndexes.reserve(missingInternal + missingExternal);
         for (int64_t i = missingInternal + missingExternal; i--;)
         {
             if (i < missingInternal) {
@@ -3353,7 +3357,13 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             } else {
                 setExternalKeyPool.insert(index);
             }
-            m_pool_key_to_index[pubkey.GetID()] = index;
+            vNewKeys.push_back(pubkey);
+            vNewIndexes.push_back(index);
+        }
+        // Hash the new keys together so the RIPEMD-160 step runs multi-lane.
+        std::vector<uint160> vNewIDs = Hash160Batch(vNewKeys);
+        for (size_t i = 0; i < vNewIDs.size(); i++) {
+            m_pool_key_to_index[CKeyID(vNewIDs[i])] = vNewIndexes[i];
         }
         if (missingInternal + missingExternal > 0) {
             LogPrintf("keypool added %d keys (%d internal), size=%u (%u internal)\n", missingInternal + missingExternal, missingInternal, setInternalKeyPool.size() + setExternalKeyPool.size(), setInternalKeyPool.size());
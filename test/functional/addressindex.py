@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the address index, with the getaddresshistory RPC and its REST interface.
+
+Check that the history of an address has its outputs and the inputs that spend
+them, pages through them with count and skip, and leaves out the outputs and
+spends of blocks that were disconnected.
+"""
+
+from decimal import Decimal
+import http.client
+import json
+import urllib.parse
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error
+
+class AddressIndexTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+        self.extra_args = [["-addressindex", "-rest"]]
+
+    def rest_get(self, path):
+        url = urllib.parse.urlparse(self.nodes[0].url)
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.request('GET', '/rest/addresshistory/' + path)
+        response = conn.getresponse()
+        return response.status, response.read().decode('utf-8')
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(101)
+        address = node.getnewaddress()
+        amounts = [Decimal("0.1") * (i + 1) for i in range(5)]
+        txids = [node.sendtoaddress(address, amount) for amount in amounts]
+        block = node.generate(1)[0]
+
+        self.log.info("The history has the outputs to the address")
+        res = node.getaddresshistory(address)
+        assert_equal(res['address'], address)
+        assert_equal(res['more'], False)
+        history = res['history']
+        assert_equal(len(history), 5)
+        assert_equal(sorted(entry['amount'] for entry in history), amounts)
+        assert_equal(sorted(entry['txid'] for entry in history), sorted(txids))
+        for entry in history:
+            assert_equal(entry['height'], 102)
+            assert_equal(entry['blockhash'], block)
+            assert 'spent' not in entry
+
+        self.log.info("Page through the history")
+        pages = []
+        for skip in range(0, 5, 2):
+            res = node.getaddresshistory(address, 0, 1000, 2, skip)
+            assert_equal(res['more'], skip + 2 < 5)
+            pages += res['history']
+        assert_equal(pages, history)
+        assert_equal(node.getaddresshistory(address, 0, 101)['history'], [])
+        assert_equal(node.getaddresshistory(address, 102, 102)['history'], history)
+
+        self.log.info("A spent output has the input that spends it")
+        spent = history[0]
+        raw_tx = node.createrawtransaction([{"txid": spent['txid'], "vout": spent['vout']}], {node.getnewaddress(): spent['amount'] - Decimal("0.001")})
+        spend_txid = node.sendrawtransaction(node.signrawtransaction(raw_tx)['hex'])
+        spend_block = node.generate(1)[0]
+        entry = node.getaddresshistory(address)['history'][0]
+        assert_equal(entry['spent'], {"txid": spend_txid, "vin": 0, "height": 103, "blockhash": spend_block})
+
+        self.log.info("Disconnected blocks are left out")
+        node.invalidateblock(spend_block)
+        assert_equal(node.getaddresshistory(address)['history'], history)
+        node.invalidateblock(block)
+        assert_equal(node.getaddresshistory(address)['history'], [])
+        # The transactions went back to the mempool, and are mined again in
+        # another block.
+        block2 = node.generate(1)[0]
+        history2 = node.getaddresshistory(address)['history']
+        assert_equal(len(history2), 5)
+        assert_equal(sorted(entry['txid'] for entry in history2), sorted(txids))
+        for entry in history2:
+            assert_equal(entry['blockhash'], block2)
+        node.reconsiderblock(block)
+        node.reconsiderblock(spend_block)
+
+        self.log.info("Invalid parameters")
+        assert_raises_rpc_error(-5, "Invalid address", node.getaddresshistory, "notanaddress")
+        assert_raises_rpc_error(-8, "Invalid height range", node.getaddresshistory, address, 10, 9)
+        assert_raises_rpc_error(-8, "Invalid height range", node.getaddresshistory, address, -1)
+        assert_raises_rpc_error(-8, "count must be between", node.getaddresshistory, address, 0, 1000, 0)
+        assert_raises_rpc_error(-8, "count must be between", node.getaddresshistory, address, 0, 1000, 1001)
+        assert_raises_rpc_error(-8, "Negative skip", node.getaddresshistory, address, 0, 1000, 1, -1)
+
+        self.log.info("The REST interface returns the same history")
+        res = node.getaddresshistory(address, 0, 1000, 2, 1)
+        status, body = self.rest_get("0/1000/2/1/" + address + ".json")
+        assert_equal(status, 200)
+        assert_equal(json.loads(body, parse_float=Decimal), res)
+        for path in ["abc/1000/2/1/", "0/99999999999/2/1/", "5/4/2/1/", "0/1000/0/1/", "0/1000/1001/1/", "0/1000/2x/1/", "0/1000/2/-1/", "0/1000/2/1"]:
+            status, _ = self.rest_get(path + address + ".json")
+            assert_equal(status, 400)
+        status, _ = self.rest_get("0/1000/2/1/notanaddress.json")
+        assert_equal(status, 400)
+        status, _ = self.rest_get("0/1000/2/1/" + address + ".bin")
+        assert_equal(status, 404)
+
+if __name__ == '__main__':
+    AddressIndexTest().main()
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test serving BIP 157 compact block filters to peers.
+
+node0 builds its block filter index over blocks it already has, and offers
+NODE_COMPACT_FILTERS once it is built. Check that getcfilters, getcfheaders
+and getcfcheckpt are answered with the filters and headers getblockfilter
+returns, and that peers making requests they should not are disconnected.
+node1 does not serve filters, so it disconnects any peer that asks.
+"""
+
+from test_framework.mininode import *
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+
+FILTER_TYPE_BASIC = 0
+
+class FiltersTestNode(NodeConnCB):
+    def __init__(self):
+        super().__init__()
+        self.cfilters = []
+
+    def on_cfilter(self, conn, message):
+        self.cfilters.append(message)
+
+class P2PBlockFiltersTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [[], ["-blockfilterindex"]]
+
+    def setup_network(self):
+        self.setup_nodes()
+
+    def run_test(self):
+        node0 = self.nodes[0]
+        node0.generate(1010)
+
+        self.log.info("Build the filter index over the blocks on disk")
+        self.stop_node(0)
+        self.start_node(0, ["-blockfilterindex", "-peerblockfilters"])
+        wait_until(lambda: int(node0.getnetworkinfo()['localservices'], 16) & NODE_COMPACT_FILTERS, timeout=60)
+
+        hashes = [node0.getblockhash(height) for height in range(1011)]
+        stop_hash = int(hashes[1010], 16)
+
+        # One connection stays open, and one is made for each request that
+        # gets the peer disconnected.
+        good = FiltersTestNode()
+        good.add_connection(NodeConn('127.0.0.1', p2p_port(0), node0, good))
+        bad_requests = [
+            # Unknown filter type
+            msg_getcfilters(1, 1000, stop_hash),
+            # Unknown stop block
+            msg_getcfilters(FILTER_TYPE_BASIC, 1000, 0x42),
+            # More filters than one request may ask for
+            msg_getcfilters(FILTER_TYPE_BASIC, 0, stop_hash),
+            # Start above the stop block
+            msg_getcfheaders(FILTER_TYPE_BASIC, 1011, stop_hash),
+            # Unknown filter type of a checkpoint
+            msg_getcfcheckpt(1, stop_hash),
+        ]
+        bad = []
+        for _ in bad_requests:
+            conn = NodeConnCB()
+            conn.add_connection(NodeConn('127.0.0.1', p2p_port(0), node0, conn))
+            bad.append(conn)
+        unsupported = NodeConnCB()
+        unsupported.add_connection(NodeConn('127.0.0.1', p2p_port(1), self.nodes[1], unsupported))
+        NetworkThread().start()
+        for conn in [good, unsupported] + bad:
+            conn.wait_for_verack()
+
+        self.log.info("node0 offers filters to its peers")
+        assert good.connection.nServices & NODE_COMPACT_FILTERS
+        assert not unsupported.connection.nServices & NODE_COMPACT_FILTERS
+
+        self.log.info("getcfilters returns the filters of getblockfilter")
+        good.send_message(msg_getcfilters(FILTER_TYPE_BASIC, 1000, stop_hash))
+        wait_until(lambda: len(good.cfilters) == 11, timeout=30, lock=mininode_lock)
+        with mininode_lock:
+            cfilters = good.cfilters
+        for height, cfilter in zip(range(1000, 1011), cfilters):
+            assert_equal(cfilter.filter_type, FILTER_TYPE_BASIC)
+            assert_equal(cfilter.block_hash, int(hashes[height], 16))
+            assert_equal(bytes_to_hex_str(cfilter.filter_data), node0.getblockfilter(hashes[height])['filter'])
+
+        self.log.info("getcfheaders returns the filter hashes and headers of getblockfilter")
+        good.send_message(msg_getcfheaders(FILTER_TYPE_BASIC, 1000, stop_hash))
+        wait_until(lambda: "cfheaders" in good.last_message, timeout=30, lock=mininode_lock)
+        with mininode_lock:
+            cfheaders = good.last_message["cfheaders"]
+        assert_equal(cfheaders.filter_type, FILTER_TYPE_BASIC)
+        assert_equal(cfheaders.stop_hash, stop_hash)
+        assert_equal(cfheaders.prev_header, int(node0.getblockfilter(hashes[999])['header'], 16))
+        assert_equal(len(cfheaders.hashes), 11)
+        header = cfheaders.prev_header
+        for height, filter_hash in zip(range(1000, 1011), cfheaders.hashes):
+            assert_equal(filter_hash, uint256_from_str(hash256(cfilters[height - 1000].filter_data)))
+            header = uint256_from_str(hash256(ser_uint256(filter_hash) + ser_uint256(header)))
+            assert_equal(header, int(node0.getblockfilter(hashes[height])['header'], 16))
+
+        self.log.info("getcfcheckpt returns the headers of every 1000th block")
+        good.send_message(msg_getcfcheckpt(FILTER_TYPE_BASIC, stop_hash))
+        wait_until(lambda: "cfcheckpt" in good.last_message, timeout=30, lock=mininode_lock)
+        with mininode_lock:
+            cfcheckpt = good.last_message["cfcheckpt"]
+        assert_equal(cfcheckpt.stop_hash, stop_hash)
+        assert_equal(cfcheckpt.headers, [int(node0.getblockfilter(hashes[1000])['header'], 16)])
+
+        self.log.info("Requests out of range or of unknown filters disconnect")
+        for conn, request in zip(bad, bad_requests):
+            conn.send_message(request)
+            conn.wait_for_disconnect()
+        unsupported.send_message(msg_getcfilters(FILTER_TYPE_BASIC, 0, int(self.nodes[1].getbestblockhash(), 16)))
+        unsupported.wait_for_disconnect()
+
+        # The connection that made valid requests is still up.
+        good.sync_with_ping()
+
+if __name__ == '__main__':
+    P2PBlockFiltersTest().main()
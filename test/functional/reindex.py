@@ -7,6 +7,7 @@
 - Start a single node and generate 3 blocks.
 - Stop the node and restart it with -reindex. Verify that the node has reindexed up to block 3.
 - Stop the node and restart it with -reindex-chainstate. Verify that the node has reindexed up to block 3.
+- Repeat -reindex with blocks loaded on the import thread alone (-reindexthreads=1).
 """
 
 from test_framework.test_framework import BitcoinTestFramework
@@ -19,12 +20,11 @@ class ReindexTest(BitcoinTestFramework):
         self.setup_clean_chain = True
         self.num_nodes = 1
 
-    def reindex(self, justchainstate=False):
+    def reindex(self, justchainstate=False, extra_args=[]):
         self.nodes[0].generate(3)
         blockcount = self.nodes[0].getblockcount()
         self.stop_nodes()
-        extra_args = [["-reindex-chainstate" if justchainstate else "-reindex", "-checkblockindex=1"]]
-        self.start_nodes(extra_args)
+        self.start_nodes([["-reindex-chainstate" if justchainstate else "-reindex", "-checkblockindex=1"] + extra_args])
         while self.nodes[0].getblockcount() < blockcount:
             time.sleep(0.1)
         assert_equal(self.nodes[0].getblockcount(), blockcount)
@@ -35,6 +35,7 @@ class ReindexTest(BitcoinTestFramework):
         self.reindex(True)
         self.reindex(False)
         self.reindex(True)
+        self.reindex(False, ["-reindexthreads=1"])
 
 if __name__ == '__main__':
     ReindexTest().main()
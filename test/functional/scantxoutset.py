@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the scantxoutset RPC.
+
+Send to addresses, a raw script and a public key, and check that a scan for
+the addr, raw and combo objects finds those outputs and their totals.
+"""
+
+from decimal import Decimal
+
+from test_framework.mininode import COIN, CTransaction, CTxOut, ToHex
+from test_framework.script import CScript, OP_CHECKSIG
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error, hex_str_to_bytes
+
+class ScanTxOutSetTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+
+    def send_to_script(self, script, amount):
+        tx = CTransaction()
+        tx.vout.append(CTxOut(int(amount * COIN), script))
+        node = self.nodes[0]
+        funded = node.fundrawtransaction(ToHex(tx))['hex']
+        return node.sendrawtransaction(node.signrawtransaction(funded)['hex'])
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(110)
+
+        addr_info = node.validateaddress(node.getnewaddress())
+        key_info = node.validateaddress(node.getnewaddress())
+        pubkey = key_info['pubkey']
+        raw_script = CScript([hex_str_to_bytes(pubkey), OP_CHECKSIG])
+
+        node.sendtoaddress(addr_info['address'], Decimal("0.002"))
+        node.sendtoaddress(key_info['address'], Decimal("0.004"))
+        txid_p2pk = self.send_to_script(raw_script, Decimal("0.008"))
+        node.sendtoaddress(addr_info['address'], Decimal("0.016"))
+        node.generate(1)
+
+        self.log.info("Scan for an address")
+        res = node.scantxoutset("start", ["addr(" + addr_info['address'] + ")"])
+        assert_equal(res['success'], True)
+        assert_equal(res['height'], 111)
+        assert_equal(res['bestblock'], node.getbestblockhash())
+        assert_equal(res['searched_items'], node.gettxoutsetinfo()['txouts'])
+        assert_equal(len(res['unspents']), 2)
+        assert_equal(sorted(u['amount'] for u in res['unspents']), [Decimal("0.002"), Decimal("0.016")])
+        for unspent in res['unspents']:
+            assert_equal(unspent['scriptPubKey'], addr_info['scriptPubKey'])
+            assert_equal(unspent['height'], 111)
+        assert_equal(res['total_amount'], Decimal("0.018"))
+
+        self.log.info("Scan for a raw script")
+        res = node.scantxoutset("start", ["raw(" + addr_info['scriptPubKey'] + ")"])
+        assert_equal(res['total_amount'], Decimal("0.018"))
+        res = node.scantxoutset("start", ["raw(" + raw_script.hex() + ")"])
+        assert_equal(len(res['unspents']), 1)
+        assert_equal(res['unspents'][0]['txid'], txid_p2pk)
+        assert_equal(res['total_amount'], Decimal("0.008"))
+
+        self.log.info("Scan for the P2PK and P2PKH outputs of a public key")
+        res = node.scantxoutset("start", ["combo(" + pubkey + ")"])
+        assert_equal(len(res['unspents']), 2)
+        assert_equal(res['total_amount'], Decimal("0.012"))
+
+        self.log.info("Scan for several objects, which count an output once")
+        objects = ["addr(" + addr_info['address'] + ")", "combo(" + pubkey + ")", "raw(" + raw_script.hex() + ")"]
+        res = node.scantxoutset("start", objects)
+        assert_equal(len(res['unspents']), 4)
+        assert_equal(res['total_amount'], Decimal("0.030"))
+
+        self.log.info("Spent outputs are not found")
+        unspent = [u for u in node.listunspent() if u['address'] == addr_info['address'] and u['amount'] == Decimal("0.016")][0]
+        raw_tx = node.createrawtransaction([{"txid": unspent['txid'], "vout": unspent['vout']}], {node.getnewaddress(): Decimal("0.015")})
+        node.sendrawtransaction(node.signrawtransaction(raw_tx)['hex'])
+        node.generate(1)
+        res = node.scantxoutset("start", ["addr(" + addr_info['address'] + ")"])
+        assert_equal(res['height'], 112)
+        assert_equal(len(res['unspents']), 1)
+        assert_equal(res['total_amount'], Decimal("0.002"))
+
+        self.log.info("Status and abort without a running scan")
+        assert_equal(node.scantxoutset("status"), None)
+        assert_equal(node.scantxoutset("abort"), False)
+
+        self.log.info("Invalid actions and scan objects")
+        assert_raises_rpc_error(-8, "Invalid action", node.scantxoutset, "stop")
+        assert_raises_rpc_error(-8, "scanobjects is required", node.scantxoutset, "start")
+        assert_raises_rpc_error(-8, "Invalid scan object type", node.scantxoutset, "start", ["pkh(" + pubkey + ")"])
+        assert_raises_rpc_error(-8, "Invalid scan object", node.scantxoutset, "start", [addr_info['address']])
+        assert_raises_rpc_error(-5, "Invalid address", node.scantxoutset, "start", ["addr(notanaddress)"])
+        assert_raises_rpc_error(-8, "Invalid script", node.scantxoutset, "start", ["raw(zz)"])
+        assert_raises_rpc_error(-5, "Invalid public key", node.scantxoutset, "start", ["combo(" + pubkey[:-2] + ")"])
+
+if __name__ == '__main__':
+    ScanTxOutSetTest().main()
@@ -98,10 +98,14 @@ BASE_SCRIPTS= [
     'disconnect_ban.py',
     'decodescript.py',
     'blockchain.py',
+    'scantxoutset.py',
+    'addressindex.py',
+    'utxosnapshot.py',
     'disablewallet.py',
     'net.py',
     'keypool.py',
     'p2p-mempool.py',
+    'p2p-blockfilters.py',
     'prioritise_transaction.py',
     'invalidblockrequest.py',
     'invalidtxrequest.py',
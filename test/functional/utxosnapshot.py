@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test starting a node from a UTXO snapshot.
+
+Dump the UTXO set of node0 with dumptxoutset, start node1 from it with
+-loadtxoutset, and check that node1 has the same UTXO set, does not offer
+the blocks below the snapshot, and follows the chain from there.
+"""
+
+from decimal import Decimal
+
+from test_framework.mininode import NODE_NETWORK
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, connect_nodes_bi, sync_blocks
+
+def utxo_set_info(node):
+    """gettxoutsetinfo without the size of the database, which differs between nodes."""
+    info = node.gettxoutsetinfo()
+    del info['disk_size']
+    return info
+
+class UTXOSnapshotTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.setup_clean_chain = True
+
+    def setup_network(self):
+        # node1 is started from the snapshot, once there is one.
+        self.add_nodes(self.num_nodes)
+        self.start_node(0)
+
+    def run_test(self):
+        node0 = self.nodes[0]
+        node0.generate(110)
+        node0.sendtoaddress(node0.getnewaddress(), Decimal("1.5"))
+        node0.generate(1)
+
+        self.log.info("Dump the UTXO set of node0")
+        res = node0.dumptxoutset("utxo.dat")
+        utxoinfo = utxo_set_info(node0)
+        assert_equal(res['base_height'], 111)
+        assert_equal(res['base_hash'], node0.getbestblockhash())
+        assert_equal(res['coins_written'], utxoinfo['txouts'])
+        assert_equal(res['hash_serialized_2'], utxoinfo['hash_serialized_2'])
+
+        self.log.info("Start node1 from the snapshot")
+        self.start_node(1, ["-loadtxoutset=" + res['path'], "-loadtxoutsethash=" + res['hash_serialized_2']])
+        node1 = self.nodes[1]
+        assert_equal(node1.getblockcount(), 111)
+        assert_equal(node1.getbestblockhash(), res['base_hash'])
+        assert_equal(utxo_set_info(node1), utxoinfo)
+
+        self.log.info("node1 does not offer the blocks below the snapshot")
+        assert_equal(int(node1.getnetworkinfo()['localservices'], 16) & NODE_NETWORK, 0)
+        assert int(node0.getnetworkinfo()['localservices'], 16) & NODE_NETWORK
+
+        self.log.info("node1 follows the chain from the snapshot")
+        connect_nodes_bi(self.nodes, 0, 1)
+        node0.sendtoaddress(node0.getnewaddress(), Decimal("2.5"))
+        tip = node0.generate(1)[0]
+        sync_blocks(self.nodes)
+        assert_equal(node1.getbestblockhash(), tip)
+        assert_equal(utxo_set_info(node1), utxo_set_info(node0))
+
+if __name__ == '__main__':
+    UTXOSnapshotTest().main()